@@ -0,0 +1,151 @@
+#ifndef CONVOLUTION_H_
+#define CONVOLUTION_H_
+
+#include <vector>
+
+#include "convolution_parameters.hpp"
+#include "im2col_convolution.hpp"
+#include "winograd_convolution.hpp"
+#include "fft_convolution.hpp"
+#include "separable_convolution.hpp"
+#include "direct_convolution.hpp"
+#include "border_convolution.hpp"
+#include "fused_convolution.hpp"
+#include "sliding_max_pooling.hpp"
+#include "patch_matrix.hpp"
+
+namespace ann
+{
+
+// multiply-adds of a direct convolution worth one n log2 n unit of a 2D FFT
+const double fftCostFactor = 3.5;
+
+enum class ConvolutionAlgorithm
+{
+    Automatic,
+    Reference,
+    Im2col,
+    Pointwise,
+    DotProduct,
+    WinogradF2x2,
+    WinogradF4x4,
+    FFT,
+    Separable,
+    Direct
+};
+
+/**
+* Picks the algorithm for the given geometry when algorithm is Automatic.
+* FFT wins once the direct cost, output pixels x kernel taps, exceeds the cost of its transforms: one for the input
+* plus two per filter. That covers large kernels and the kernel gradients with large outputs.
+* Small kernels run on the register tiled direct loop, which reads the input in place: it beats the im2col copy
+* for single filters and ties the GEMM on banks, and beats Winograd, whose transforms are memory bound in double.
+*/
+inline ConvolutionAlgorithm selectAlgorithm(int inputRows, int inputCols, int kernelRows, int kernelCols, const ConvolutionParameters &params, int numberOfFilters = 1)
+{
+    if (kernelRows == 1 && kernelCols == 1)
+        return ConvolutionAlgorithm::Pointwise;
+    const int outputRows = params.outputRows(inputRows, kernelRows);
+    const int outputCols = params.outputCols(inputCols, kernelCols);
+    const double directCost = static_cast<double>(outputRows) * outputCols * kernelRows * kernelCols * numberOfFilters;
+    const double transformCost = fftCostFactor * fftCost(fftSize(inputRows + 2 * params.rowPadding), fftSize(inputCols + 2 * params.colPadding));
+    if (directCost > transformCost * (1 + 2 * numberOfFilters))
+        return ConvolutionAlgorithm::FFT;
+    if (static_cast<long>(outputRows) * outputCols < static_cast<long>(kernelRows) * kernelCols)
+        return ConvolutionAlgorithm::DotProduct;
+    if (kernelRows <= directMaxKernelSize && kernelCols <= directMaxKernelSize)
+        return ConvolutionAlgorithm::Direct;
+    return ConvolutionAlgorithm::Im2col;
+}
+
+/**
+* Same as above, but also looks at the values of the kernels: low rank filters beat the small kernel algorithms.
+*/
+inline ConvolutionAlgorithm selectAlgorithm(const Matrix &input, const std::vector<Matrix> &kernels, const ConvolutionParameters &params)
+{
+    auto result = selectAlgorithm(input.rows(), input.cols(), kernels.front().rows(), kernels.front().cols(), params, kernels.size());
+    if ((result == ConvolutionAlgorithm::Im2col || result == ConvolutionAlgorithm::Direct) && isWorthSeparating(kernels))
+        result = ConvolutionAlgorithm::Separable;
+    return result;
+}
+
+/**
+* Convolves the input with a bank of filters of the same size, one output per filter.
+*/
+inline std::vector<Matrix> convolution(const Matrix &input, const std::vector<Matrix> &kernels, const ConvolutionParameters &params = ConvolutionParameters(), ConvolutionAlgorithm algorithm = ConvolutionAlgorithm::Automatic)
+{
+    if (kernels.empty())
+        throw std::invalid_argument("At least one filter is required.");
+    if (algorithm == ConvolutionAlgorithm::Automatic)
+        algorithm = selectAlgorithm(input, kernels, params);
+
+    switch (algorithm)
+    {
+    case ConvolutionAlgorithm::Reference:
+    {
+        std::vector<Matrix> result;
+        for (const auto &kernel : kernels)
+            result.push_back(referenceConvolution(input, kernel, params));
+        return result;
+    }
+    case ConvolutionAlgorithm::Pointwise:
+        return pointwiseConvolution(input, kernels, params);
+    case ConvolutionAlgorithm::DotProduct:
+    {
+        std::vector<Matrix> result;
+        for (const auto &kernel : kernels)
+            result.push_back(dotProductConvolution(input, kernel, params));
+        return result;
+    }
+    case ConvolutionAlgorithm::WinogradF2x2:
+        return winogradConvolution<WinogradF2x3>(input, kernels, params);
+    case ConvolutionAlgorithm::WinogradF4x4:
+        return winogradConvolution<WinogradF4x3>(input, kernels, params);
+    case ConvolutionAlgorithm::FFT:
+        return fftConvolution(input, kernels, params);
+    case ConvolutionAlgorithm::Separable:
+        return separableConvolution(input, kernels, params);
+    case ConvolutionAlgorithm::Direct:
+        // padded inputs are read in place, the border is computed apart
+        return params.hasPadding() ? borderConvolution(input, kernels, params) : directConvolution(input, kernels, params);
+    default:
+        return im2colConvolution(input, kernels, params);
+    }
+}
+
+inline Matrix convolution(const Matrix &input, const Matrix &kernel, const ConvolutionParameters &params = ConvolutionParameters(), ConvolutionAlgorithm algorithm = ConvolutionAlgorithm::Automatic)
+{
+    return convolution(input, std::vector<Matrix>{kernel}, params, algorithm).front();
+}
+
+inline const char *algorithmName(ConvolutionAlgorithm algorithm)
+{
+    switch (algorithm)
+    {
+    case ConvolutionAlgorithm::Automatic:
+        return "automatic";
+    case ConvolutionAlgorithm::Reference:
+        return "reference";
+    case ConvolutionAlgorithm::Im2col:
+        return "im2col";
+    case ConvolutionAlgorithm::Pointwise:
+        return "pointwise";
+    case ConvolutionAlgorithm::DotProduct:
+        return "dot product";
+    case ConvolutionAlgorithm::WinogradF2x2:
+        return "winograd F(2x2,3x3)";
+    case ConvolutionAlgorithm::WinogradF4x4:
+        return "winograd F(4x4,3x3)";
+    case ConvolutionAlgorithm::FFT:
+        return "fft";
+    case ConvolutionAlgorithm::Separable:
+        return "separable";
+    case ConvolutionAlgorithm::Direct:
+        return "direct";
+    }
+    return "unknown";
+}
+
+} // namespace ann
+
+#endif
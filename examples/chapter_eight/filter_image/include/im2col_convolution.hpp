@@ -0,0 +1,207 @@
+#ifndef IM2COL_CONVOLUTION_H_
+#define IM2COL_CONVOLUTION_H_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "convolution_parameters.hpp"
+#include "parallel.hpp"
+
+namespace ann
+{
+
+// upper bound for the patch matrix of one tile, small enough to stay in L2
+const long im2colTileBytes = 256 * 1024;
+
+/**
+* Lowers the output columns [colBegin, colEnd) into a patch matrix.
+* Each row of patches is one output pixel (column-major inside the tile) and each column is one kernel tap,
+* in the same column-major order as the kernel's own storage. Taps falling into the padding are zeros:
+* the padded input is never materialized.
+*/
+inline void im2col(const Matrix &input, int kernelRows, int kernelCols, const ConvolutionParameters &params, int colBegin, int colEnd, Matrix &patches)
+{
+    const int inputRows = input.rows();
+    const int inputCols = input.cols();
+    const int outputRows = params.outputRows(inputRows, kernelRows);
+    const int tileCols = colEnd - colBegin;
+    const int step = params.dilation + 1;
+    const int rowStride = params.rowStride;
+    patches.resize(static_cast<long>(outputRows) * tileCols, kernelRows * kernelCols);
+
+    for (int b = 0; b < kernelCols; ++b)
+    {
+        for (int a = 0; a < kernelRows; ++a)
+        {
+            double *tap = patches.col(a + b * kernelRows).data();
+            const int firstRow = a * step - params.rowPadding;
+            // output rows i whose source row firstRow + i * rowStride lies inside the input
+            const int rowBegin = firstRow < 0 ? (-firstRow + rowStride - 1) / rowStride : 0;
+            const int rowEnd = firstRow >= inputRows ? 0 : std::min(outputRows, (inputRows - 1 - firstRow) / rowStride + 1);
+
+            for (int jj = 0; jj < tileCols; ++jj)
+            {
+                double *out = tap + static_cast<long>(jj) * outputRows;
+                const int sourceCol = (colBegin + jj) * params.colStride - params.colPadding + b * step;
+                if (sourceCol < 0 || sourceCol >= inputCols || rowBegin >= rowEnd)
+                {
+                    std::fill(out, out + outputRows, 0.0);
+                    continue;
+                }
+                std::fill(out, out + rowBegin, 0.0);
+                const double *src = input.col(sourceCol).data() + firstRow + rowBegin * rowStride;
+                if (rowStride == 1)
+                    std::copy(src, src + (rowEnd - rowBegin), out + rowBegin);
+                else
+                    for (int i = rowBegin; i < rowEnd; ++i, src += rowStride)
+                        out[i] = *src;
+                std::fill(out + rowEnd, out + outputRows, 0.0);
+            }
+        }
+    }
+}
+
+/**
+* im2col + GEMM: the output is computed in tiles of columns so that the patch matrix of a tile fits in cache,
+* and tiles are spread over the hardware threads. Each tile is a single (pixels x taps) * (taps x filters) product,
+* which Eigen runs through its cache-blocked, vectorized GEMM kernel.
+*/
+inline std::vector<Matrix> im2colConvolution(const Matrix &input, const std::vector<Matrix> &kernels, const ConvolutionParameters &params = ConvolutionParameters())
+{
+    const int kernelRows = kernels.front().rows();
+    const int kernelCols = kernels.front().cols();
+    params.validate(input.rows(), input.cols(), kernelRows, kernelCols);
+
+    const int taps = kernelRows * kernelCols;
+    const int numberOfFilters = kernels.size();
+    Matrix weights(taps, numberOfFilters);
+    for (int f = 0; f < numberOfFilters; ++f)
+    {
+        if (kernels[f].rows() != kernelRows || kernels[f].cols() != kernelCols)
+            throw std::invalid_argument("All the filters of a convolution must have the same size.");
+        weights.col(f) = Eigen::Map<const Vector>(kernels[f].data(), taps);
+    }
+
+    const int outputRows = params.outputRows(input.rows(), kernelRows);
+    const int outputCols = params.outputCols(input.cols(), kernelCols);
+    std::vector<Matrix> result(numberOfFilters, Matrix(outputRows, outputCols));
+
+    const long bytesPerColumn = static_cast<long>(outputRows) * taps * sizeof(double);
+    const int tileCols = std::max<long>(1, std::min<long>(outputCols, im2colTileBytes / bytesPerColumn));
+    const int numberOfTiles = (outputCols + tileCols - 1) / tileCols;
+
+    parallelFor(0, numberOfTiles, [&](long tileBegin, long tileEnd) {
+        Matrix patches, products;
+        for (long tile = tileBegin; tile < tileEnd; ++tile)
+        {
+            const int colBegin = tile * tileCols;
+            const int colEnd = std::min(outputCols, colBegin + tileCols);
+            im2col(input, kernelRows, kernelCols, params, colBegin, colEnd, patches);
+            products.noalias() = patches * weights;
+            for (int f = 0; f < numberOfFilters; ++f)
+                result[f].middleCols(colBegin, colEnd - colBegin) = Eigen::Map<const Matrix>(products.col(f).data(), outputRows, colEnd - colBegin);
+        }
+    });
+    return result;
+}
+
+/**
+* 1x1 kernels: every output pixel is a single input pixel, so each filter is a scaled (strided, padded) copy of the input.
+*/
+inline std::vector<Matrix> pointwiseConvolution(const Matrix &input, const std::vector<Matrix> &kernels, const ConvolutionParameters &params = ConvolutionParameters())
+{
+    params.validate(input.rows(), input.cols(), 1, 1);
+    const int outputRows = params.outputRows(input.rows(), 1);
+    const int outputCols = params.outputCols(input.cols(), 1);
+
+    Matrix sampled;
+    if (!params.hasPadding() && params.isUnitStride())
+        sampled = input;
+    else
+    {
+        sampled = Matrix::Zero(outputRows, outputCols);
+        for (int j = 0; j < outputCols; ++j)
+        {
+            const int sourceCol = j * params.colStride - params.colPadding;
+            if (sourceCol < 0 || sourceCol >= input.cols())
+                continue;
+            for (int i = 0; i < outputRows; ++i)
+            {
+                const int sourceRow = i * params.rowStride - params.rowPadding;
+                if (sourceRow >= 0 && sourceRow < input.rows())
+                    sampled(i, j) = input(sourceRow, sourceCol);
+            }
+        }
+    }
+
+    std::vector<Matrix> result;
+    result.reserve(kernels.size());
+    for (const auto &kernel : kernels)
+    {
+        if (kernel.rows() != 1 || kernel.cols() != 1)
+            throw std::invalid_argument("pointwiseConvolution requires 1x1 filters.");
+        result.push_back(kernel(0, 0) * sampled);
+    }
+    return result;
+}
+
+/**
+* One dot product between the kernel and a (strided) input window per output pixel.
+* Used when the kernel is larger than the output, e.g. the kernel gradients dK = convolution(X, dC) of the training examples,
+* where lowering to im2col would copy the whole input once per output pixel.
+*/
+inline Matrix dotProductConvolution(const Matrix &input, const Matrix &kernel, const ConvolutionParameters &params = ConvolutionParameters())
+{
+    params.validate(input.rows(), input.cols(), kernel.rows(), kernel.cols());
+    const int inputRows = input.rows();
+    const int inputCols = input.cols();
+    const int outputRows = params.outputRows(inputRows, kernel.rows());
+    const int outputCols = params.outputCols(inputCols, kernel.cols());
+    const int step = params.dilation + 1;
+
+    // taps [begin, end) of a kernel dimension that fall inside the input for a window starting at first
+    auto validTaps = [step](int first, int size, int kernelSize) {
+        int begin = first < 0 ? (-first + step - 1) / step : 0;
+        int end = first >= size ? 0 : std::min(kernelSize, (size - 1 - first) / step + 1);
+        return std::make_pair(begin, std::max(begin, end));
+    };
+
+    Matrix result(outputRows, outputCols);
+    parallelFor(0, outputCols, [&](long colBegin, long colEnd) {
+        using StridedMap = Eigen::Map<const Matrix, 0, Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>>;
+        for (long j = colBegin; j < colEnd; ++j)
+        {
+            const int firstCol = j * params.colStride - params.colPadding;
+            const auto cols = validTaps(firstCol, inputCols, kernel.cols());
+            for (int i = 0; i < outputRows; ++i)
+            {
+                const int firstRow = i * params.rowStride - params.rowPadding;
+                const auto rows = validTaps(firstRow, inputRows, kernel.rows());
+                const int tapRows = rows.second - rows.first;
+                const int tapCols = cols.second - cols.first;
+                if (tapRows == 0 || tapCols == 0)
+                {
+                    result(i, j) = 0.0;
+                    continue;
+                }
+                const int row = firstRow + rows.first * step;
+                const int col = firstCol + cols.first * step;
+                auto taps = kernel.block(rows.first, cols.first, tapRows, tapCols);
+                if (step == 1)
+                    result(i, j) = input.block(row, col, tapRows, tapCols).cwiseProduct(taps).sum();
+                else
+                {
+                    StridedMap window(input.data() + row + static_cast<long>(col) * inputRows, tapRows, tapCols,
+                                      Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(static_cast<long>(inputRows) * step, step));
+                    result(i, j) = window.cwiseProduct(taps).sum();
+                }
+            }
+        }
+    });
+    return result;
+}
+
+} // namespace ann
+
+#endif
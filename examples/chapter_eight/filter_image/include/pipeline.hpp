@@ -0,0 +1,312 @@
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "parallel.hpp"
+
+namespace ann
+{
+
+using PipelineClock = std::chrono::steady_clock;
+
+/**
+* FIFO of at most capacity items between the threads of two stages: push blocks while it is full, which holds the
+* producers back and bounds the memory, pop blocks while it is empty. Once closed, pop drains the items left and then
+* returns nothing, and push refuses new items.
+*/
+template <typename T>
+class BoundedQueue
+{
+
+private:
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity)
+    {
+        if (capacity == 0)
+            throw std::invalid_argument("A queue must hold at least one item.");
+    }
+
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this]() { return items.size() < capacity || closed; });
+        if (closed)
+            return false;
+        items.push_back(std::move(item));
+        lock.unlock();
+        notEmpty.notify_one();
+        return true;
+    }
+
+    std::optional<T> pop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this]() { return !items.empty() || closed; });
+        if (items.empty())
+            return std::nullopt;
+        T item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        notFull.notify_one();
+        return item;
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+};
+
+/**
+* What a stage did during a run, its times summed over its workers: busy in the stage function, starved waiting for
+* input, blocked waiting for room in the next queue (back pressure from a slower stage).
+*/
+struct StageStatistics
+{
+    std::string name;
+    int workers = 0;
+    long items = 0;
+    double busySeconds = 0.0;
+    double maxSeconds = 0.0;
+    double starvedSeconds = 0.0;
+    double blockedSeconds = 0.0;
+};
+
+/**
+* Statistics of a run; the latency of an item runs from the source to the end of the last stage.
+*/
+struct PipelineStatistics
+{
+    double wallSeconds = 0.0;
+    long items = 0;
+    double meanLatency = 0.0;
+    double maxLatency = 0.0;
+    std::vector<StageStatistics> stages;
+};
+
+inline std::ostream &operator<<(std::ostream &out, const PipelineStatistics &statistics)
+{
+    const std::ios_base::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::setw(10) << "stage" << std::setw(9) << "workers" << std::setw(8) << "items" << std::setw(12) << "items/s";
+    out << std::setw(12) << "mean ms" << std::setw(11) << "max ms" << std::setw(11) << "busy %" << std::setw(11) << "starved %" << std::setw(11) << "blocked %" << "\n";
+    for (const auto &stage : statistics.stages)
+    {
+        const double available = std::max(1e-12, stage.workers * statistics.wallSeconds);
+        out << std::setw(10) << stage.name << std::setw(9) << stage.workers << std::setw(8) << stage.items;
+        out << std::fixed << std::setprecision(1) << std::setw(12) << stage.items / std::max(1e-12, statistics.wallSeconds);
+        out << std::setprecision(2) << std::setw(12) << 1000.0 * stage.busySeconds / std::max<long>(1, stage.items) << std::setw(11) << 1000.0 * stage.maxSeconds;
+        out << std::setprecision(1) << std::setw(11) << 100.0 * stage.busySeconds / available << std::setw(11) << 100.0 * stage.starvedSeconds / available;
+        out << std::setw(11) << 100.0 * stage.blockedSeconds / available << "\n";
+    }
+    out << statistics.items << " items in " << std::setprecision(3) << statistics.wallSeconds << " s, latency mean ";
+    out << std::setprecision(1) << 1000.0 * statistics.meanLatency << " ms, max " << 1000.0 * statistics.maxLatency << " ms\n";
+    out.flags(flags);
+    out.precision(precision);
+    return out;
+}
+
+/**
+* Runs items through a chain of stages, each one with its own pool of worker threads reading a bounded queue.
+* The source runs on the calling thread and is only asked for the next item when the first queue has room, so no more
+* than (queue capacity + workers) items per stage are alive whatever the size of the input. Items may leave a stage
+* out of order when it has several workers. The stage workers run parallelFor inline: the cores are kept busy by one
+* item per thread. An exception thrown by the source or a stage stops the run and is rethrown by run.
+*/
+template <typename Item>
+class Pipeline
+{
+
+public:
+    // fills the next item and returns true, or returns false at the end of the input
+    using Source = std::function<bool(Item &)>;
+    using Work = std::function<void(Item &)>;
+
+private:
+    struct Envelope
+    {
+        Item item;
+        PipelineClock::time_point created;
+    };
+
+    struct Stage
+    {
+        std::string name;
+        int workers;
+        Work work;
+    };
+
+    std::vector<Stage> stages;
+    size_t queueCapacity;
+
+    static double seconds(PipelineClock::time_point begin, PipelineClock::time_point end)
+    {
+        return std::chrono::duration<double>(end - begin).count();
+    }
+
+public:
+    explicit Pipeline(size_t queueCapacity = 4) : queueCapacity(queueCapacity) {}
+
+    Pipeline &addStage(std::string name, int workers, Work work)
+    {
+        if (workers < 1)
+            throw std::invalid_argument("The stage " + name + " needs at least one worker.");
+        stages.push_back({std::move(name), workers, std::move(work)});
+        return *this;
+    }
+
+    PipelineStatistics run(const std::string &sourceName, Source source)
+    {
+        if (stages.empty())
+            throw std::invalid_argument("The pipeline has no stage.");
+        const size_t numberOfStages = stages.size();
+        std::vector<std::unique_ptr<BoundedQueue<Envelope>>> queues;
+        for (size_t k = 0; k < numberOfStages; ++k)
+            queues.emplace_back(new BoundedQueue<Envelope>(queueCapacity));
+
+        PipelineStatistics result;
+        result.stages.resize(numberOfStages + 1);
+        result.stages[0].name = sourceName;
+        result.stages[0].workers = 1;
+        std::mutex statisticsMutex;
+        std::exception_ptr failure;
+        auto fail = [&](std::exception_ptr error) {
+            {
+                std::lock_guard<std::mutex> lock(statisticsMutex);
+                if (!failure)
+                    failure = error;
+            }
+            for (auto &queue : queues)
+                queue->close();
+        };
+
+        const auto start = PipelineClock::now();
+        std::vector<std::thread> threads;
+        std::unique_ptr<std::atomic<int>[]> running(new std::atomic<int>[numberOfStages]);
+        for (size_t k = 0; k < numberOfStages; ++k)
+        {
+            StageStatistics &total = result.stages[k + 1];
+            total.name = stages[k].name;
+            total.workers = stages[k].workers;
+            running[k] = stages[k].workers;
+            for (int worker = 0; worker < stages[k].workers; ++worker)
+            {
+                threads.emplace_back([&, k]() {
+                    serialThread() = true;
+                    StageStatistics local;
+                    double latencySum = 0.0, latencyMax = 0.0;
+                    try
+                    {
+                        while (true)
+                        {
+                            auto waitBegin = PipelineClock::now();
+                            std::optional<Envelope> envelope = queues[k]->pop();
+                            auto workBegin = PipelineClock::now();
+                            local.starvedSeconds += seconds(waitBegin, workBegin);
+                            if (!envelope)
+                                break;
+                            stages[k].work(envelope->item);
+                            auto workEnd = PipelineClock::now();
+                            local.busySeconds += seconds(workBegin, workEnd);
+                            local.maxSeconds = std::max(local.maxSeconds, seconds(workBegin, workEnd));
+                            ++local.items;
+                            if (k + 1 < numberOfStages)
+                            {
+                                if (!queues[k + 1]->push(std::move(*envelope)))
+                                    break;
+                                local.blockedSeconds += seconds(workEnd, PipelineClock::now());
+                            }
+                            else
+                            {
+                                latencySum += seconds(envelope->created, workEnd);
+                                latencyMax = std::max(latencyMax, seconds(envelope->created, workEnd));
+                            }
+                        }
+                    }
+                    catch (...)
+                    {
+                        fail(std::current_exception());
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(statisticsMutex);
+                        total.items += local.items;
+                        total.busySeconds += local.busySeconds;
+                        total.maxSeconds = std::max(total.maxSeconds, local.maxSeconds);
+                        total.starvedSeconds += local.starvedSeconds;
+                        total.blockedSeconds += local.blockedSeconds;
+                        result.meanLatency += latencySum;
+                        result.maxLatency = std::max(result.maxLatency, latencyMax);
+                    }
+                    // the last worker out tells the next stage that no more items are coming
+                    if (--running[k] == 0 && k + 1 < numberOfStages)
+                        queues[k + 1]->close();
+                });
+            }
+        }
+
+        StageStatistics &sourceStatistics = result.stages[0];
+        try
+        {
+            while (true)
+            {
+                Envelope envelope;
+                auto workBegin = PipelineClock::now();
+                if (!source(envelope.item))
+                    break;
+                envelope.created = PipelineClock::now();
+                sourceStatistics.busySeconds += seconds(workBegin, envelope.created);
+                sourceStatistics.maxSeconds = std::max(sourceStatistics.maxSeconds, seconds(workBegin, envelope.created));
+                ++sourceStatistics.items;
+                if (!queues[0]->push(std::move(envelope)))
+                    break;
+                sourceStatistics.blockedSeconds += seconds(envelope.created, PipelineClock::now());
+            }
+        }
+        catch (...)
+        {
+            fail(std::current_exception());
+        }
+        queues[0]->close();
+        for (auto &thread : threads)
+            thread.join();
+        if (failure)
+            std::rethrow_exception(failure);
+
+        result.wallSeconds = seconds(start, PipelineClock::now());
+        result.items = result.stages.back().items;
+        result.meanLatency /= std::max<long>(1, result.items);
+        return result;
+    }
+};
+
+} // namespace ann
+
+#endif
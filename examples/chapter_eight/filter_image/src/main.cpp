@@ -3,12 +3,19 @@
 #include <exception>
 #include <string>
 #include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <atomic>
+#include <filesystem>
 
 #include "matrix_definitions.hpp"
+#include "convolution.hpp"
+#include "pipeline.hpp"
 
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/highgui/highgui.hpp>
+#include <opencv2/videoio.hpp>
 #include <opencv2/core/eigen.hpp>
 
 void show(const char *title, const cv::Mat &image)
@@ -20,22 +27,7 @@ void show(const char *title, const cv::Mat &image)
 
 Matrix convolution(const Matrix & input, const Matrix & filter)
 {
-    int filterRows = filter.rows();
-    int filterCols = filter.cols();
-    int rows = input.rows() - filterRows + 1;
-    int cols = input.cols() - filterCols + 1;
-    Matrix result = Matrix::Zero(rows, cols);
-
-    for(int i = 0; i < rows; ++i)
-    {
-        for(int j = 0; j < cols; ++j)
-        {
-            double sum = input.block(i, j, filterRows, filterCols).cwiseProduct(filter).sum();
-            result(i, j) = sum;
-        }
-    }
-
-    return result;
+    return ann::convolution(input, filter);
 }
 
 void imageConvolution(const cv::Mat source, cv::Mat &dest, const Matrix & filter)
@@ -50,18 +42,214 @@ void imageConvolution(const cv::Mat source, cv::Mat &dest, const Matrix & filter
     temp.convertTo(dest, CV_8UC1);
 }
  
-int main(int, char **)
+/**
+* An image going through the batch pipeline. The stages release what they no longer need, so a job only holds the
+* data of the stage it is in. A job that fails in a stage keeps the error and is skipped by the stages after it.
+*/
+struct FilterJob
+{
+    long index = 0;
+    std::string path;
+    std::string name;
+    std::string error;
+    cv::Mat image;
+    Matrix pixels;
+    cv::Mat result;
+};
+
+struct BatchOptions
+{
+    std::string input;
+    std::string outputDirectory;
+    int workers = 0;
+    int queueCapacity = 4;
+    int pooling = 1;
+
+    /**
+    * Reads INPUT OUTPUT_DIR [--workers N] [--queue N] [--pooling P] from the command line.
+    */
+    static BatchOptions parse(int argc, char **argv)
+    {
+        const std::string usage = "Usage: filter_image [INPUT_DIR|VIDEO OUTPUT_DIR [--workers N] [--queue N] [--pooling P]]";
+        if (argc < 3)
+            throw std::invalid_argument(usage);
+        BatchOptions result;
+        result.input = argv[1];
+        result.outputDirectory = argv[2];
+        for (int i = 3; i < argc; ++i)
+        {
+            const std::string option = argv[i];
+            if (option != "--workers" && option != "--queue" && option != "--pooling")
+                throw std::invalid_argument("Unknown option " + option + ". " + usage);
+            if (i + 1 >= argc)
+                throw std::invalid_argument("Missing value for " + option + ". " + usage);
+            const std::string value = argv[++i];
+            int number = 0;
+            try
+            {
+                number = std::stoi(value);
+            }
+            catch (std::logic_error const &)
+            {
+                throw std::invalid_argument("Invalid value " + value + " for " + option + ". " + usage);
+            }
+            if (number < 1)
+                throw std::invalid_argument("The value of " + option + " must be positive. " + usage);
+            if (option == "--workers")
+                result.workers = number;
+            else if (option == "--queue")
+                result.queueCapacity = number;
+            else
+                result.pooling = number;
+        }
+        return result;
+    }
+};
+
+/**
+* Filters every image of a directory, or every frame of a video, into OUTPUT_DIR as PNG files, streaming them through
+* decode -> convert -> convolve -> encode stages linked by bounded queues: the images are never all in memory, the
+* slow stages (decoding and convolving) get the workers and the statistics of every stage are printed at the end.
+* A video is decoded by the source, as VideoCapture reads its frames in order. An image that cannot be read, filtered
+* or written is reported and counted as a failure without stopping the batch.
+*/
+int batchFilter(const BatchOptions &options, const Matrix &filter)
+{
+    const int workers = options.workers > 0 ? options.workers : static_cast<int>(ann::numberOfWorkers());
+    std::vector<cv::String> paths;
+    cv::VideoCapture video;
+    const bool isVideo = !std::filesystem::is_directory(options.input);
+    if (isVideo)
+    {
+        if (!video.open(options.input))
+        {
+            std::cerr << "Can't open " << options.input << " as a directory or a video.\n";
+            return -1;
+        }
+    }
+    else
+        cv::glob(options.input + "/*", paths, false);
+
+    std::error_code error;
+    std::filesystem::create_directories(options.outputDirectory, error);
+    if (error || !std::filesystem::is_directory(options.outputDirectory))
+    {
+        std::cerr << "Can't create the output directory " << options.outputDirectory << ".\n";
+        return -1;
+    }
+
+    // the errors of an item are kept in the job, so a bad file does not stop the other ones
+    auto guarded = [](std::function<void(FilterJob &)> work) {
+        return [work](FilterJob &job) {
+            if (!job.error.empty())
+                return;
+            try
+            {
+                work(job);
+            }
+            catch (std::exception const &e)
+            {
+                job.error = e.what();
+            }
+        };
+    };
+
+    std::atomic<long> failures{0};
+    ann::Pipeline<FilterJob> pipeline(options.queueCapacity);
+    if (!isVideo)
+        pipeline.addStage("decode", std::max(1, workers / 2), guarded([&](FilterJob &job) {
+            job.image = cv::imread(job.path, cv::IMREAD_GRAYSCALE);
+            if (job.image.empty())
+                job.error = "can't read the image";
+        }));
+    pipeline.addStage("convert", 1, guarded([&](FilterJob &job) {
+        // video frames are BGR
+        if (job.image.channels() > 1)
+            cv::cvtColor(job.image, job.image, cv::COLOR_BGR2GRAY);
+        cv::cv2eigen(job.image, job.pixels);
+        job.image.release();
+    }));
+    pipeline.addStage("convolve", workers, guarded([&](FilterJob &job) {
+        Matrix convoluted = convolution(job.pixels, filter);
+        job.pixels.resize(0, 0);
+        if (options.pooling > 1)
+            convoluted = ann::slidingMaxPooling(convoluted, options.pooling, options.pooling).output;
+        cv::Mat temp;
+        cv::eigen2cv(convoluted, temp);
+        temp.convertTo(job.result, CV_8UC1);
+    }));
+    pipeline.addStage("encode", 1, [&](FilterJob &job) {
+        const std::string path = options.outputDirectory + "/" + job.name + ".png";
+        // cv::imwrite throws on images it cannot encode, which must not stop the other ones
+        guarded([&path](FilterJob &written) {
+            if (!cv::imwrite(path, written.result))
+                written.error = "can't write " + path;
+        })(job);
+        if (!job.error.empty())
+        {
+            std::cerr << "Skipping " << (isVideo ? job.name : job.path) << ": " << job.error << "\n";
+            ++failures;
+        }
+        job.image.release();
+        job.pixels.resize(0, 0);
+        job.result.release();
+    });
+
+    long next = 0;
+    auto source = [&](FilterJob &job) {
+        job.index = next;
+        if (isVideo)
+        {
+            if (!video.read(job.image))
+                return false;
+            std::stringstream name;
+            name << "frame_" << std::setw(6) << std::setfill('0') << next;
+            job.name = name.str();
+        }
+        else
+        {
+            if (next >= static_cast<long>(paths.size()))
+                return false;
+            job.path = paths[next];
+            const size_t slash = job.path.find_last_of("/\\");
+            const std::string base = slash == std::string::npos ? job.path : job.path.substr(slash + 1);
+            job.name = base.substr(0, base.find_last_of('.'));
+        }
+        ++next;
+        return true;
+    };
+    ann::PipelineStatistics statistics = pipeline.run(isVideo ? "read" : "list", source);
+    std::cout << statistics;
+    if (failures > 0)
+        std::cerr << failures << " of " << statistics.items << " images could not be read, filtered or written.\n";
+    return failures > 0 ? -1 : 0;
+}
+
+int main(int argc, char **argv)
 {
-    const char * imagepath = "../data/convolution_example.png";
-    cv::Mat image = cv::imread(imagepath, cv::IMREAD_GRAYSCALE);
-    cv::Mat dest;
     Matrix filter(3, 3);
     //filter << -1, 0, 1, -1, 0, 1, -1, 0, 1;
     //filter << -1, -1, -1, 0, 0, 0, 1, 1, 1;
     filter << 0, -1, 0, -1, 5, -1, 0, -1, 0;
+    if (argc > 1)
+    {
+        try
+        {
+            return batchFilter(BatchOptions::parse(argc, argv), filter);
+        }
+        catch (std::exception const &e)
+        {
+            std::cerr << e.what() << "\n";
+            return -1;
+        }
+    }
+
+    const char * imagepath = "../data/convolution_example.png";
+    cv::Mat image = cv::imread(imagepath, cv::IMREAD_GRAYSCALE);
+    cv::Mat dest;
     imageConvolution(image, dest, filter);
     show("origin", image);
     show("dest", dest);
     cv::waitKey(0);
     return 0;
-}
\ No newline at end of file
+}
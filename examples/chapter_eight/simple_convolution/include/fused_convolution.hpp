@@ -0,0 +1,155 @@
+#ifndef FUSED_CONVOLUTION_H_
+#define FUSED_CONVOLUTION_H_
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include "direct_convolution.hpp"
+
+namespace ann
+{
+
+using SwitchMatrix = Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic>;
+
+// pooled columns per parallel task, the convolution columns under them are kept in a small buffer
+const int fusedTileCols = 8;
+
+/**
+* Result of the fused convolution -> (ReLU) -> max pooling. switches holds, for every pooled output, the position
+* of the maximum in its window as the offset a + b * pooling, one byte per output instead of a whole convolution sized
+* matrix; the sizes of the convolution and the pooling are kept for the backward pass.
+*/
+struct PooledConvolution
+{
+    Matrix output;
+    SwitchMatrix switches;
+    int convolutionRows;
+    int convolutionCols;
+    int pooling;
+    int stride;
+    bool relu;
+};
+
+/**
+* Max of the pooling x pooling windows of one pooled column, whose first window starts at window; the values of one
+* window position are stride rows apart (Stride is InnerStride<1> for contiguous loads when stride is 1). The window is visited in the column-major order of maxCoeff so that
+* ties keep the same (first) maximum; the offsets are selected as doubles to vectorize with the values.
+*/
+template <typename Stride>
+inline void poolColumn(const double *window, long leadingDimension, int pooling, int stride, Eigen::ArrayXd &maximum, Eigen::ArrayXd &offset)
+{
+    using Column = Eigen::Map<const Eigen::ArrayXd, 0, Stride>;
+    const long rows = maximum.size();
+    maximum = Column(window, rows, Stride(stride));
+    offset.setZero();
+    for (int b = 0; b < pooling; ++b)
+    {
+        for (int a = (b == 0 ? 1 : 0); a < pooling; ++a)
+        {
+            const Column candidate(window + b * leadingDimension + a, rows, Stride(stride));
+            offset = (candidate > maximum).select(static_cast<double>(a + b * pooling), offset);
+            maximum = maximum.max(candidate);
+        }
+    }
+}
+
+template <int KernelRows, int KernelCols>
+inline void fusedKernel(const Matrix &source, const Matrix &kernel, const std::vector<int> &rowOffsets, const ConvolutionParameters &params, PooledConvolution &result)
+{
+    const int step = params.dilation + 1;
+    const int pooling = result.pooling;
+    const int stride = result.stride;
+    const int outputRows = result.output.rows();
+    const int outputCols = result.output.cols();
+    const int numberOfBlocks = (outputCols + fusedTileCols - 1) / fusedTileCols;
+
+    parallelFor(0, numberOfBlocks, [&](long blockBegin, long blockEnd) {
+        Matrix buffer(result.convolutionRows, (fusedTileCols - 1) * stride + pooling);
+        Eigen::ArrayXd maximum(outputRows), offset(outputRows);
+        for (long block = blockBegin; block < blockEnd; ++block)
+        {
+            const long colBegin = block * fusedTileCols;
+            const long colEnd = std::min<long>(outputCols, colBegin + fusedTileCols);
+            const long firstCol = colBegin * stride;
+            for (long j = firstCol; j < (colEnd - 1) * stride + pooling; ++j)
+                directColumn<KernelRows, KernelCols>(source, kernel, rowOffsets.data(), step, j * params.colStride, result.convolutionRows, buffer.col(j - firstCol).data());
+
+            for (long q = colBegin; q < colEnd; ++q)
+            {
+                const double *window = buffer.col(q * stride - firstCol).data();
+                if (stride == 1)
+                    poolColumn<Eigen::InnerStride<1>>(window, buffer.rows(), pooling, stride, maximum, offset);
+                else
+                    poolColumn<Eigen::InnerStride<>>(window, buffer.rows(), pooling, stride, maximum, offset);
+                if (result.relu)
+                    result.output.col(q) = maximum.max(0.0).matrix();
+                else
+                    result.output.col(q) = maximum.matrix();
+                result.switches.col(q) = offset.cast<unsigned char>().matrix();
+            }
+        }
+    });
+}
+
+/**
+* Convolution followed by an optional ReLU and a max pooling of pooling x pooling windows moved by stride, in one pass:
+* the convolution is computed a few columns at a time by the direct kernels and pooled while still in cache, so the
+* convolution and ReLU images are never written out. Max pooling commutes with ReLU, which is only applied to the
+* pooled values. A pooling of 1 gives a plain convolution (+ ReLU).
+*/
+inline PooledConvolution maxPoolingConvolution(const Matrix &input, const Matrix &kernel, int pooling, int stride, bool relu = false, const ConvolutionParameters &params = ConvolutionParameters())
+{
+    params.validate(input.rows(), input.cols(), kernel.rows(), kernel.cols());
+    PooledConvolution result;
+    result.convolutionRows = params.outputRows(input.rows(), kernel.rows());
+    result.convolutionCols = params.outputCols(input.cols(), kernel.cols());
+    result.pooling = pooling;
+    result.stride = stride;
+    result.relu = relu;
+    if (pooling < 1 || stride < 1 || pooling * pooling > 256 || pooling > result.convolutionRows || pooling > result.convolutionCols)
+    {
+        std::stringstream ss;
+        ss << "Invalid " << pooling << "x" << pooling << " pooling with stride " << stride;
+        ss << " for a " << result.convolutionRows << "x" << result.convolutionCols << " convolution.";
+        throw std::invalid_argument(ss.str());
+    }
+    result.output.resize((result.convolutionRows - pooling) / stride + 1, (result.convolutionCols - pooling) / stride + 1);
+    result.switches.resize(result.output.rows(), result.output.cols());
+
+    Matrix storage;
+    std::vector<int> rowOffsets;
+    const Matrix &source = directSource(input, kernel.rows(), params, storage, rowOffsets);
+    if (kernel.rows() == 3 && kernel.cols() == 3)
+        fusedKernel<3, 3>(source, kernel, rowOffsets, params, result);
+    else if (kernel.rows() == 5 && kernel.cols() == 5)
+        fusedKernel<5, 5>(source, kernel, rowOffsets, params, result);
+    else
+        fusedKernel<Eigen::Dynamic, Eigen::Dynamic>(source, kernel, rowOffsets, params, result);
+    return result;
+}
+
+/**
+* Gradient with respect to the convolution output given dC, the gradient with respect to the pooled output:
+* every dC goes straight to the maximum of its window read from the switches (accumulated when windows overlap),
+* and is dropped where the ReLU output is zero.
+*/
+inline Matrix maxPoolingGradient(const Matrix &dC, const PooledConvolution &forward)
+{
+    Matrix result = Matrix::Zero(forward.convolutionRows, forward.convolutionCols);
+    for (int q = 0; q < dC.cols(); ++q)
+    {
+        for (int p = 0; p < dC.rows(); ++p)
+        {
+            if (forward.relu && forward.output(p, q) <= 0.0)
+                continue;
+            const int offset = forward.switches(p, q);
+            result(p * forward.stride + offset % forward.pooling, q * forward.stride + offset / forward.pooling) += dC(p, q);
+        }
+    }
+    return result;
+}
+
+} // namespace ann
+
+#endif
@@ -5,25 +5,11 @@
 #include <algorithm>
 
 #include "matrix_definitions.hpp"
+#include "convolution.hpp"
 
 Matrix convolution(const Matrix & input, const Matrix & filter)
 {
-    int filterRows = filter.rows();
-    int filterCols = filter.cols();
-    int rows = (input.rows() - filterRows) + 1;
-    int cols = (input.cols() - filterCols) + 1;
-    Matrix result = Matrix::Zero(rows, cols);
-
-    for(int i = 0; i < rows; ++i)
-    {
-        for(int j = 0; j < cols; ++j)
-        {
-            double sum = input.block(i, j, filterRows, filterCols).cwiseProduct(filter).sum();
-            result(i, j) = sum;
-        }
-    }
-
-    return result;
+    return ann::convolution(input, filter);
 }
 
 int main(int, char **)
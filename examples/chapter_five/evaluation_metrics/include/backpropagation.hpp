@@ -60,10 +60,20 @@ class Backpropagation
 
     std::tuple<std::vector<Matrix>, std::vector<Matrix>> 
     backward(const std::vector<Matrix> &xPerLayer, const std::vector<Matrix> &zPerLayer, const Matrix &y, const Matrix &expected) {
+        return backpropagate(xPerLayer, zPerLayer, costFunction.derivative(expected, y));
+    }
+
+    std::tuple<std::vector<Matrix>, std::vector<Matrix>> 
+    backward(const std::vector<Matrix> &xPerLayer, const std::vector<Matrix> &zPerLayer, const Matrix &y, const LabelVector &labels) {
+        return backpropagate(xPerLayer, zPerLayer, costFunction.derivative(labels, y));
+    }
+
+    std::tuple<std::vector<Matrix>, std::vector<Matrix>> 
+    backpropagate(const std::vector<Matrix> &xPerLayer, const std::vector<Matrix> &zPerLayer, Matrix dC) {
         auto &layers = net.getLayers();
         std::vector<Matrix> dWperLayer(layers.size()), dBperLayer(layers.size());
         int layerIndex = layers.size() - 1;
-        Matrix dZ, dC = costFunction.derivative(expected, y);
+        Matrix dZ;
 
         std::for_each(layers.rbegin(), layers.rend(), [&](const Layer &layer) {
             
@@ -106,7 +116,8 @@ class Backpropagation
         while (epoch < maxEpochs)
         {
             auto [x, z, y] = forward(trainingDataset.X);
-            auto [dW, dB] = backward(x, z, y, trainingDataset.T);
+            auto [dW, dB] = trainingDataset.hasLabels() ? 
+                backward(x, z, y, trainingDataset.labels) : backward(x, z, y, trainingDataset.T);
             update(dW, dB);
             epoch++;
         }
@@ -39,6 +39,33 @@ public:
 
         return result;
     }
+
+    /**
+    * Same as above for integer labels: every entry is evaluated for a 0 target 
+    * and only the label row of each column is replaced by the 1 target value.
+    */
+    virtual double operator()(const LabelVector &labels, const Matrix &output) const
+    {
+        Matrix lossVector = output.unaryExpr([this](const double output) {
+            return this->loss(0.0, output);
+        });
+        for(long i = 0; i < labels.size(); ++i)
+            lossVector(labels(i), i) = loss(1.0, output(labels(i), i));
+
+        double result = lossVector.sum() / output.cols();
+        return result;
+    }
+
+    Matrix derivative(const LabelVector &labels, const Matrix &y) const
+    {
+        Matrix result = y.unaryExpr([this](const double output) {
+            return this->derivate(0.0, output);
+        });
+        for(long i = 0; i < labels.size(); ++i)
+            result(labels(i), i) = derivate(1.0, y(labels(i), i));
+
+        return result;
+    }
 };
 
 class QuadraticCostFunction : public CostFunction
@@ -10,11 +10,27 @@ struct Dataset
 {
     Matrix X;
     Matrix T;
+    // integer class labels, used instead of a one-hot T to save memory and argmax scans
+    LabelVector labels;
+    int numberOfClasses = 0;
 
     long size() const {
         return X.cols();
     }
 
+    bool hasLabels() const {
+        return labels.size() > 0;
+    }
+
+    Matrix targets() const {
+        if(!hasLabels())
+            return T;
+        Matrix result = Matrix::Zero(numberOfClasses, labels.size());
+        for(long i = 0; i < labels.size(); ++i)
+            result(labels(i), i) = 1.0;
+        return result;
+    }
+
 };
 
 } // namespace ann
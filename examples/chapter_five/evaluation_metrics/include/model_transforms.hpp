@@ -0,0 +1,21 @@
+#ifndef MODEL_TRANSFORMS_H_
+#define MODEL_TRANSFORMS_H_
+
+#include "mlp_core.hpp"
+#include "normalizer.hpp"
+
+namespace ann
+{
+
+    /**
+    * Folds the affine input normalization x' = scale * x + offset into the first layer:
+    * W' = W * diag(scale) and b' = b + W * offset.
+    * The returned network produces the same output for raw features as net does for normalized ones.
+    */
+    MultilayerPerceptron foldInputNormalization(const MultilayerPerceptron &net, const Vector &scale, const Vector &offset);
+
+    MultilayerPerceptron foldInputNormalization(const MultilayerPerceptron &net, const Normalizer &normalizer, NormalizationType type);
+
+}// namespace ann
+
+#endif
@@ -8,6 +8,7 @@
 #include "cost_functions.hpp"
 #include "performance_measurement.hpp"
 #include "backpropagation.hpp"
+#include "model_transforms.hpp"
 
 ann::MultilayerPerceptron initializeNetwork(double initializationRange)
 {
@@ -21,7 +22,7 @@ ann::MultilayerPerceptron initializeNetwork(double initializationRange)
 ann::Dataset loadIrisDataset(const std::string &filepath)
 {
     Matrix X = Matrix::Zero(4, 150);
-    Matrix T = Matrix::Zero(3, 150);
+    LabelVector labels(150);
     io::CSVReader<5> csvReader(filepath);
     csvReader.set_header("sepal_length", "sepal_width", "petal_length", "petal_width", "species");
     double sepal_length, sepal_width, petal_length, petal_width;
@@ -29,15 +30,16 @@ ann::Dataset loadIrisDataset(const std::string &filepath)
     int colIndex = 0;
     while (csvReader.read_row(sepal_length, sepal_width, petal_length, petal_width, species)){
         X.col(colIndex) << sepal_length, sepal_width, petal_length, petal_width;
-        if (species == "Iris-setosa") T(0, colIndex) = 1.0;
-        else if (species == "Iris-versicolor") T(1, colIndex) = 1.0;
-        else if (species == "Iris-virginica") T(2, colIndex) = 1.0;
+        if (species == "Iris-setosa") labels(colIndex) = 0;
+        else if (species == "Iris-versicolor") labels(colIndex) = 1;
+        else if (species == "Iris-virginica") labels(colIndex) = 2;
         else throw "unknow species";
         colIndex++;
     }
     ann::Dataset result;
     result.X = X;
-    result.T = T;
+    result.labels = labels;
+    result.numberOfClasses = 3;
     return result;
 }
 
@@ -47,10 +49,17 @@ int main(int, char **)
     int epochs = 100;
     double learningRate = 0.5;
     auto irisDS = loadIrisDataset("../data/iris.csv");
+    ann::Normalizer normalizer;
+    normalizer.fit(irisDS.X);
+    auto normalizedDS = irisDS;
+    normalizer.transform(normalizedDS, ann::NormalizationType::ZScore);
     auto net = initializeNetwork(0.5);
-    ann::Backpropagation<ann::QuadraticCostFunction> backpropagation(net, irisDS, learningRate, epochs);
+    ann::Backpropagation<ann::QuadraticCostFunction> backpropagation(net, normalizedDS, learningRate, epochs);
     backpropagation.train();
-    auto metrics = ann::evaluate(net, irisDS);
+
+    // the deployed model takes raw features: the normalization pass is folded into the first layer
+    auto deployedNet = ann::foldInputNormalization(net, normalizer, ann::NormalizationType::ZScore);
+    auto metrics = ann::evaluate(deployedNet, irisDS);
 
     std::cout << std::setprecision(3);
 
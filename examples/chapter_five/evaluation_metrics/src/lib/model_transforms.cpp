@@ -0,0 +1,42 @@
+#include "model_transforms.hpp"
+
+#include <sstream>
+
+namespace ann
+{
+
+MultilayerPerceptron foldInputNormalization(const MultilayerPerceptron &net, const Vector &scale, const Vector &offset)
+{
+    const auto &layers = net.getLayers();
+    if (layers.empty())
+        throw std::invalid_argument("The network has no layers to fold the normalization into.");
+
+    const Layer &first = layers.front();
+    if (first.getNumberOfInputNeurons() != scale.size() || scale.size() != offset.size())
+    {
+        std::stringstream msg;
+        msg << "The normalization has " << scale.size() << " features ";
+        msg << "but the first layer expects " << first.getNumberOfInputNeurons() << " inputs.";
+        throw std::invalid_argument(msg.str());
+    }
+
+    const Matrix &weights = first.getWeightMatrix();
+    Matrix foldedWeights = weights * scale.asDiagonal();
+    Vector foldedBiases = first.getBiases() + weights * offset;
+
+    MultilayerPerceptron result;
+    result.add(Layer(first.getActivationFunction()->clone(), foldedWeights, foldedBiases));
+    std::for_each(layers.begin() + 1, layers.end(), [&result](const Layer &layer) {
+        result.add(layer);
+    });
+    return result;
+}
+
+MultilayerPerceptron foldInputNormalization(const MultilayerPerceptron &net, const Normalizer &normalizer, NormalizationType type)
+{
+    Vector scale, offset;
+    std::tie(scale, offset) = normalizer.affine(type);
+    return foldInputNormalization(net, scale, offset);
+}
+
+} // namespace ann
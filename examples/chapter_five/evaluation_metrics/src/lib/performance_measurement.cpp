@@ -9,6 +9,14 @@ namespace ann
     {
         auto output = net.output(dataset.X);
 
+        if(dataset.hasLabels()) {
+            // (y - t)^2 summed over a column is |y|^2 - 2*y[label] + 1 for a one-hot t
+            double sum = output.squaredNorm() + output.cols();
+            for(long i = 0; i < output.cols(); ++i)
+                sum -= 2.0 * output(dataset.labels(i), i);
+            return sum / (2*output.cols());
+        }
+
         auto cost = output.binaryExpr(dataset.T, [](double y, double t){
             return pow(y - t, 2);
         });
@@ -18,12 +26,16 @@ namespace ann
 EvaluationMetrics evaluate(const MultilayerPerceptron &net, const Dataset &dataset)
 {
     EvaluationMetrics result;
-    Matrix confusionMatrix = Matrix::Zero(dataset.T.rows(), dataset.T.rows());
+    const long numberOfClasses = dataset.hasLabels() ? dataset.numberOfClasses : dataset.T.rows();
+    Matrix confusionMatrix = Matrix::Zero(numberOfClasses, numberOfClasses);
     auto output = net.output(dataset.X);
     for(int i = 0; i < output.cols(); ++i) {
         Matrix::Index predicted, expected;
         output.col(i).maxCoeff(&predicted);
-        dataset.T.col(i).maxCoeff(&expected);
+        if(dataset.hasLabels())
+            expected = dataset.labels(i);
+        else
+            dataset.T.col(i).maxCoeff(&expected);
         confusionMatrix(expected, predicted) = confusionMatrix(expected, predicted) + 1;
 
     }
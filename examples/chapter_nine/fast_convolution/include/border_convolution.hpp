@@ -0,0 +1,208 @@
+#ifndef BORDER_CONVOLUTION_H_
+#define BORDER_CONVOLUTION_H_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "direct_convolution.hpp"
+
+namespace ann
+{
+
+/**
+* Values read outside the input by a padded convolution: zeros, the nearest edge pixel (aa|abcd|dd) or the mirror
+* image around the edge pixel (cb|abcd|cb, BORDER_REFLECT_101 in OpenCV).
+*/
+enum class BorderMode
+{
+    Zero,
+    Replicate,
+    Reflect
+};
+
+/**
+* Input index read at index of a dimension of size pixels, -1 for a zero.
+*/
+inline int borderIndex(int index, int size, BorderMode mode)
+{
+    if (index >= 0 && index < size)
+        return index;
+    switch (mode)
+    {
+    case BorderMode::Replicate:
+        return index < 0 ? 0 : size - 1;
+    case BorderMode::Reflect:
+    {
+        if (size == 1)
+            return 0;
+        // the reflection repeats every 2 * (size - 1) pixels, which also covers paddings larger than the input
+        const int period = 2 * (size - 1);
+        index %= period;
+        if (index < 0)
+            index += period;
+        return index < size ? index : period - index;
+    }
+    default:
+        return -1;
+    }
+}
+
+/**
+* Outputs [begin, end) of a dimension whose whole window lies inside the input; the outputs before and after read the border.
+*/
+inline std::pair<int, int> interiorRange(int inputSize, int outputSize, int dilatedSize, int padding, int stride)
+{
+    const int begin = std::min(outputSize, (padding + stride - 1) / stride);
+    const int lastStart = inputSize + padding - dilatedSize;
+    const int end = lastStart < 0 ? 0 : std::min(outputSize, lastStart / stride + 1);
+    return std::make_pair(begin, std::max(begin, end));
+}
+
+/**
+* Input index read by every tap of every output of a dimension, outputSize x kernelSize with the taps contiguous.
+*/
+inline std::vector<int> borderTaps(int inputSize, int outputSize, int kernelSize, int padding, int stride, int step, BorderMode mode)
+{
+    std::vector<int> result(static_cast<long>(outputSize) * kernelSize);
+    for (int i = 0; i < outputSize; ++i)
+        for (int a = 0; a < kernelSize; ++a)
+            result[static_cast<long>(i) * kernelSize + a] = borderIndex(i * stride - padding + a * step, inputSize, mode);
+    return result;
+}
+
+/**
+* Interior of the output, rows [firstRow, firstRow + interiorRows) of the columns in interiorCols, on the direct
+* kernels reading the input in place.
+*/
+template <int KernelRows, int KernelCols>
+inline void interiorKernel(const Matrix &source, const Matrix &kernel, const std::vector<int> &rowOffsets, const ConvolutionParameters &params,
+                           int firstRow, int interiorRows, std::pair<int, int> interiorCols, Matrix &result)
+{
+    const int step = params.dilation + 1;
+    const int numberOfBlocks = (interiorCols.second - interiorCols.first + directTileCols - 1) / directTileCols;
+
+    parallelFor(0, numberOfBlocks, [&](long blockBegin, long blockEnd) {
+        for (long block = blockBegin; block < blockEnd; ++block)
+        {
+            const long colBegin = interiorCols.first + block * directTileCols;
+            const long colEnd = std::min<long>(interiorCols.second, colBegin + directTileCols);
+            for (long j = colBegin; j < colEnd; ++j)
+                directColumn<KernelRows, KernelCols>(source, kernel, rowOffsets.data(), step, j * params.colStride - params.colPadding,
+                                                     interiorRows, result.col(j).data() + firstRow);
+        }
+    });
+}
+
+/**
+* The outputs of the border, every tap looked up in the tap tables; the taps reading a zero are skipped.
+*/
+inline void borderPixels(const Matrix &input, const Matrix &kernel, const std::vector<int> &rowTaps, const std::vector<int> &colTaps,
+                         std::pair<int, int> interiorRows, std::pair<int, int> interiorCols, Matrix &result)
+{
+    const int kernelRows = kernel.rows();
+    const int kernelCols = kernel.cols();
+    auto pixel = [&](int i, int j) {
+        double sum = 0.0;
+        for (int b = 0; b < kernelCols; ++b)
+        {
+            const int col = colTaps[static_cast<long>(j) * kernelCols + b];
+            if (col < 0)
+                continue;
+            for (int a = 0; a < kernelRows; ++a)
+            {
+                const int row = rowTaps[static_cast<long>(i) * kernelRows + a];
+                if (row >= 0)
+                    sum += kernel(a, b) * input(row, col);
+            }
+        }
+        result(i, j) = sum;
+    };
+
+    parallelFor(0, result.cols(), [&](long colBegin, long colEnd) {
+        for (long j = colBegin; j < colEnd; ++j)
+        {
+            if (j >= interiorCols.first && j < interiorCols.second)
+            {
+                for (int i = 0; i < interiorRows.first; ++i)
+                    pixel(i, j);
+                for (int i = interiorRows.second; i < result.rows(); ++i)
+                    pixel(i, j);
+            }
+            else
+            {
+                for (int i = 0; i < result.rows(); ++i)
+                    pixel(i, j);
+            }
+        }
+    });
+}
+
+/**
+* Padded convolution without a padded copy of the input. The output is split into the interior, whose windows lie
+* inside the input and run on the direct kernels reading the input in place, and the border around it (padding / stride
+* outputs on each side), computed pixel by pixel through tables of the input rows and columns read by every tap,
+* so any BorderMode costs the same. Row strides still read a copy split by phase, like directConvolution.
+*/
+inline std::vector<Matrix> borderConvolution(const Matrix &input, const std::vector<Matrix> &kernels, const ConvolutionParameters &params = ConvolutionParameters(),
+                                             BorderMode mode = BorderMode::Zero)
+{
+    if (kernels.empty())
+        throw std::invalid_argument("At least one filter is required.");
+    const int kernelRows = kernels.front().rows();
+    const int kernelCols = kernels.front().cols();
+    params.validate(input.rows(), input.cols(), kernelRows, kernelCols);
+    const int step = params.dilation + 1;
+    const int outputRows = params.outputRows(input.rows(), kernelRows);
+    const int outputCols = params.outputCols(input.cols(), kernelCols);
+    const auto interiorRows = interiorRange(input.rows(), outputRows, params.dilatedSize(kernelRows), params.rowPadding, params.rowStride);
+    const auto interiorCols = interiorRange(input.cols(), outputCols, params.dilatedSize(kernelCols), params.colPadding, params.colStride);
+    const std::vector<int> rowTaps = borderTaps(input.rows(), outputRows, kernelRows, params.rowPadding, params.rowStride, step, mode);
+    const std::vector<int> colTaps = borderTaps(input.cols(), outputCols, kernelCols, params.colPadding, params.colStride, step, mode);
+
+    const bool hasInterior = interiorRows.first < interiorRows.second && interiorCols.first < interiorCols.second;
+    Matrix storage;
+    std::vector<int> rowOffsets;
+    const Matrix *source = &input;
+    if (hasInterior)
+    {
+        if (params.rowStride > 1)
+        {
+            storage = splitRowPhases(input, params.rowStride);
+            source = &storage;
+        }
+        rowOffsets = directRowOffsets(kernelRows, step, params.rowStride, source->rows() / params.rowStride,
+                                      interiorRows.first * params.rowStride - params.rowPadding);
+    }
+
+    std::vector<Matrix> result;
+    result.reserve(kernels.size());
+    for (const auto &kernel : kernels)
+    {
+        if (kernel.rows() != kernelRows || kernel.cols() != kernelCols)
+            throw std::invalid_argument("All the filters of a convolution must have the same size.");
+        Matrix output(outputRows, outputCols);
+        if (hasInterior)
+        {
+            const int rows = interiorRows.second - interiorRows.first;
+            if (kernelRows == 3 && kernelCols == 3)
+                interiorKernel<3, 3>(*source, kernel, rowOffsets, params, interiorRows.first, rows, interiorCols, output);
+            else if (kernelRows == 5 && kernelCols == 5)
+                interiorKernel<5, 5>(*source, kernel, rowOffsets, params, interiorRows.first, rows, interiorCols, output);
+            else
+                interiorKernel<Eigen::Dynamic, Eigen::Dynamic>(*source, kernel, rowOffsets, params, interiorRows.first, rows, interiorCols, output);
+        }
+        borderPixels(input, kernel, rowTaps, colTaps, interiorRows, interiorCols, output);
+        result.push_back(std::move(output));
+    }
+    return result;
+}
+
+inline Matrix borderConvolution(const Matrix &input, const Matrix &kernel, const ConvolutionParameters &params = ConvolutionParameters(), BorderMode mode = BorderMode::Zero)
+{
+    return borderConvolution(input, std::vector<Matrix>{kernel}, params, mode).front();
+}
+
+} // namespace ann
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef FFT_CONVOLUTION_H_
+#define FFT_CONVOLUTION_H_
+
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#include <unsupported/Eigen/FFT>
+
+#include "convolution_parameters.hpp"
+#include "parallel.hpp"
+
+namespace ann
+{
+
+using ComplexMatrix = Eigen::MatrixXcd;
+
+/**
+* Smallest size >= n that is a multiple of 4 (the fast real transform of kissfft) with no prime factor above 5.
+*/
+inline int fftSize(int n)
+{
+    for (int size = std::max(4, (n + 3) / 4 * 4);; size += 4)
+    {
+        int rest = size;
+        for (int factor : {2, 3, 5})
+            while (rest % factor == 0)
+                rest /= factor;
+        if (rest == 1)
+            return size;
+    }
+}
+
+/**
+* Estimated multiply-adds of a 2D real FFT of rows x cols.
+*/
+inline double fftCost(int rows, int cols)
+{
+    const double size = static_cast<double>(rows) * cols;
+    return size * std::log2(size);
+}
+
+/**
+* 2D FFT of a real rows x cols signal stored in the top left corner of source (zeros elsewhere).
+* Columns are transformed first with the half spectrum real FFT, then the rows of the result.
+* The spectrum is returned transposed, (cols x rows / 2 + 1), so that the second pass also runs on contiguous columns.
+*/
+inline ComplexMatrix forwardFFT2(const Matrix &source, int rows, int cols)
+{
+    const int half = rows / 2 + 1;
+    ComplexMatrix columns(half, cols);
+    parallelFor(0, cols, [&](long begin, long end) {
+        Eigen::FFT<double> fft;
+        fft.SetFlag(Eigen::FFT<double>::HalfSpectrum);
+        Vector column = Vector::Zero(rows);
+        for (long j = begin; j < end; ++j)
+        {
+            column.setZero();
+            if (j < source.cols())
+                column.head(source.rows()) = source.col(j);
+            fft.fwd(columns.col(j).data(), column.data(), rows);
+        }
+    });
+
+    ComplexMatrix result = columns.transpose();
+    parallelFor(0, half, [&](long begin, long end) {
+        Eigen::FFT<double> fft;
+        Eigen::VectorXcd row(cols);
+        for (long i = begin; i < end; ++i)
+        {
+            row = result.col(i);
+            fft.fwd(result.col(i).data(), row.data(), cols);
+        }
+    });
+    return result;
+}
+
+/**
+* Inverse of forwardFFT2: takes the transposed half spectrum and returns the rows x cols real signal.
+*/
+inline Matrix inverseFFT2(ComplexMatrix spectrum, int rows, int cols)
+{
+    const int half = rows / 2 + 1;
+    parallelFor(0, half, [&](long begin, long end) {
+        Eigen::FFT<double> fft;
+        Eigen::VectorXcd row(cols);
+        for (long i = begin; i < end; ++i)
+        {
+            row = spectrum.col(i);
+            fft.inv(spectrum.col(i).data(), row.data(), cols);
+        }
+    });
+
+    ComplexMatrix columns = spectrum.transpose();
+    Matrix result(rows, cols);
+    parallelFor(0, cols, [&](long begin, long end) {
+        Eigen::FFT<double> fft;
+        fft.SetFlag(Eigen::FFT<double>::HalfSpectrum);
+        for (long j = begin; j < end; ++j)
+            fft.inv(result.col(j).data(), columns.col(j).data(), rows);
+    });
+    return result;
+}
+
+/**
+* Convolution through the frequency domain: correlation(P, K) = IFFT(FFT(P) .* conj(FFT(K))).
+* The transforms are sized to hold the whole padded input, so the circular correlation has no wrap-around
+* in the valid region. The cost does not depend on the kernel size, which makes it the algorithm of choice for
+* large kernels; dilation is free (the dilated kernel is just a sparser signal) and strides subsample the dense result.
+* The input spectrum is shared by all the filters.
+*/
+inline std::vector<Matrix> fftConvolution(const Matrix &input, const std::vector<Matrix> &kernels, const ConvolutionParameters &params = ConvolutionParameters())
+{
+    const int kernelRows = kernels.front().rows();
+    const int kernelCols = kernels.front().cols();
+    params.validate(input.rows(), input.cols(), kernelRows, kernelCols);
+
+    const int paddedRows = input.rows() + 2 * params.rowPadding;
+    const int paddedCols = input.cols() + 2 * params.colPadding;
+    const int rows = fftSize(paddedRows);
+    const int cols = fftSize(paddedCols);
+
+    Matrix padded = Matrix::Zero(paddedRows, paddedCols);
+    padded.block(params.rowPadding, params.colPadding, input.rows(), input.cols()) = input;
+    const ComplexMatrix inputSpectrum = forwardFFT2(padded, rows, cols);
+
+    const int step = params.dilation + 1;
+    const int outputRows = params.outputRows(input.rows(), kernelRows);
+    const int outputCols = params.outputCols(input.cols(), kernelCols);
+    std::vector<Matrix> result;
+    result.reserve(kernels.size());
+    for (const auto &kernel : kernels)
+    {
+        if (kernel.rows() != kernelRows || kernel.cols() != kernelCols)
+            throw std::invalid_argument("All the filters of a convolution must have the same size.");
+        Matrix filter = Matrix::Zero(params.dilatedSize(kernelRows), params.dilatedSize(kernelCols));
+        for (int b = 0; b < kernelCols; ++b)
+            for (int a = 0; a < kernelRows; ++a)
+                filter(a * step, b * step) = kernel(a, b);
+
+        const Matrix dense = inverseFFT2(inputSpectrum.cwiseProduct(forwardFFT2(filter, rows, cols).conjugate()), rows, cols);
+        Matrix output(outputRows, outputCols);
+        for (int j = 0; j < outputCols; ++j)
+            for (int i = 0; i < outputRows; ++i)
+                output(i, j) = dense(i * params.rowStride, j * params.colStride);
+        result.push_back(output);
+    }
+    return result;
+}
+
+} // namespace ann
+
+#endif
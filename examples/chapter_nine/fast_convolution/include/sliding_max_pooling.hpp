@@ -0,0 +1,199 @@
+#ifndef SLIDING_MAX_POOLING_H_
+#define SLIDING_MAX_POOLING_H_
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include "matrix_definitions.hpp"
+#include "parallel.hpp"
+
+namespace ann
+{
+
+using IndexMatrix = Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic>;
+
+/**
+* Result of slidingMaxPooling: argmax holds, for every output, the (column-major) index in the input of the maximum of
+* its window, the first one in column-major order on ties like maxCoeff.
+*/
+struct PooledMatrix
+{
+    Matrix output;
+    IndexMatrix argmax;
+    int inputRows;
+    int inputCols;
+};
+
+/**
+* Element-wise max of the columns (a, aIndex) and (b, bIndex) into (result, resultIndex). Ties go to the smaller index,
+* that is the first maximum in column-major order like maxCoeff.
+*/
+inline void selectColumn(const double *a, const int *aIndex, const double *b, const int *bIndex, long rows, double *result, int *resultIndex)
+{
+    for (long i = 0; i < rows; ++i)
+    {
+        const bool first = a[i] > b[i] || (a[i] == b[i] && aIndex[i] < bIndex[i]);
+        result[i] = first ? a[i] : b[i];
+        resultIndex[i] = first ? aIndex[i] : bIndex[i];
+    }
+}
+
+/**
+* Maxima of the windows of pooling values of the column x moved by stride, and their indices in the input (shift is the
+* index of x[0]), in O(1) per value whatever the window size (van Herk / Gil-Werman): the column is cut into blocks of
+* pooling values, every window starting in a block ends in the next one, and its maximum is the max of the running
+* maximum from its start to the end of the block (suffix) and of the running maximum from the start of the next block
+* to its end (prefix). The running maxima are kept in registers, ties going to the earlier value.
+*/
+inline void slidingColumn(const double *x, int rows, int pooling, int stride, int shift, std::vector<double> &prefix, std::vector<double> &suffix,
+                          std::vector<int> &prefixIndex, std::vector<int> &suffixIndex, double *output, int *outputIndex)
+{
+    for (int start = 0; start < rows; start += pooling)
+    {
+        const int end = std::min(rows, start + pooling);
+        double maximum = x[start];
+        int index = start;
+        for (int i = start; i < end; ++i)
+        {
+            const bool greater = x[i] > maximum;
+            maximum = greater ? x[i] : maximum;
+            index = greater ? i : index;
+            prefix[i] = maximum;
+            prefixIndex[i] = index;
+        }
+        maximum = x[end - 1];
+        index = end - 1;
+        for (int i = end - 1; i >= start; --i)
+        {
+            const bool notLess = x[i] >= maximum;
+            maximum = notLess ? x[i] : maximum;
+            index = notLess ? i : index;
+            suffix[i] = maximum;
+            suffixIndex[i] = index;
+        }
+    }
+    const int outputRows = (rows - pooling) / stride + 1;
+    for (int p = 0; p < outputRows; ++p)
+    {
+        const int first = p * stride;
+        const int last = first + pooling - 1;
+        const bool left = suffix[first] >= prefix[last];
+        output[p] = left ? suffix[first] : prefix[last];
+        outputIndex[p] = (left ? suffixIndex[first] : prefixIndex[last]) + shift;
+    }
+}
+
+/**
+* Max pooling of pooling x pooling windows moved by stride with a cost per pixel that doesn't depend on the window
+* size, as two separable passes. The first one, slidingColumn, takes the maxima of the windows down every column.
+* The second one applies the same blocks along the rows of these column maxima, a whole column at a time which
+* vectorizes: the suffixes of a block are kept and the prefix of the next block is carried along as the windows move
+* right. The column maxima are computed a block ahead, so they are never written out as a whole image.
+* argmax is the first maximum of every window in column-major order, the one found by maxCoeff. This pays off when the
+* windows overlap: with a stride close to the window size, every value is in about one window and scanning them is cheaper.
+*/
+inline PooledMatrix slidingMaxPooling(const Matrix &input, int pooling, int stride)
+{
+    const int rows = input.rows();
+    const int cols = input.cols();
+    if (pooling < 1 || stride < 1 || pooling > rows || pooling > cols)
+    {
+        std::stringstream msg;
+        msg << "Invalid " << pooling << "x" << pooling << " pooling with stride " << stride;
+        msg << " for a " << rows << "x" << cols << " input.";
+        throw std::invalid_argument(msg.str());
+    }
+    const int outputRows = (rows - pooling) / stride + 1;
+    const int outputCols = (cols - pooling) / stride + 1;
+    PooledMatrix result{Matrix(outputRows, outputCols), IndexMatrix(outputRows, outputCols), rows, cols};
+    const int lastFirst = (outputCols - 1) * stride;
+
+    parallelFor(0, lastFirst / pooling + 1, [&](long blockBegin, long blockEnd) {
+        std::vector<double> prefix(rows), suffix(rows);
+        std::vector<int> prefixIndex(rows), suffixIndex(rows);
+        // column maxima of the block and of the next one, the suffixes of the block and the running prefix
+        Matrix current(outputRows, pooling), next(outputRows, pooling), blockSuffix(outputRows, pooling);
+        IndexMatrix currentIndex(outputRows, pooling), nextIndex(outputRows, pooling), blockSuffixIndex(outputRows, pooling);
+        Vector runningPrefix(outputRows);
+        Eigen::VectorXi runningPrefixIndex(outputRows);
+        auto columnMaximum = [&](int c, double *output, int *outputIndex) {
+            slidingColumn(input.col(c).data(), rows, pooling, stride, c * rows, prefix, suffix, prefixIndex, suffixIndex, output, outputIndex);
+        };
+        long ready = -1;
+        for (long block = blockBegin; block < blockEnd; ++block)
+        {
+            const int start = block * pooling;
+            const int firstOutput = (start + stride - 1) / stride;
+            const int lastOutput = std::min(start + pooling - 1, lastFirst) / stride;
+            if (firstOutput > lastOutput)
+                continue;
+            // a block holding the start of a window is complete
+            if (ready != block)
+            {
+                for (int r = 0; r < pooling; ++r)
+                    columnMaximum(start + r, current.col(r).data(), currentIndex.col(r).data());
+            }
+            blockSuffix.col(pooling - 1) = current.col(pooling - 1);
+            blockSuffixIndex.col(pooling - 1) = currentIndex.col(pooling - 1);
+            for (int r = pooling - 2; r >= 0; --r)
+                selectColumn(current.col(r).data(), currentIndex.col(r).data(), blockSuffix.col(r + 1).data(), blockSuffixIndex.col(r + 1).data(),
+                             outputRows, blockSuffix.col(r).data(), blockSuffixIndex.col(r).data());
+
+            const int windows = lastOutput * stride - start + 1;
+            for (int r = 0; r < windows; ++r)
+            {
+                if (r > 0)
+                {
+                    columnMaximum(start + pooling + r - 1, next.col(r - 1).data(), nextIndex.col(r - 1).data());
+                    if (r == 1)
+                    {
+                        runningPrefix = next.col(0);
+                        runningPrefixIndex = nextIndex.col(0);
+                    }
+                    else
+                        selectColumn(next.col(r - 1).data(), nextIndex.col(r - 1).data(), runningPrefix.data(), runningPrefixIndex.data(),
+                                     outputRows, runningPrefix.data(), runningPrefixIndex.data());
+                }
+                if ((start + r) % stride != 0)
+                    continue;
+                const long q = (start + r) / stride;
+                if (r == 0)
+                {
+                    result.output.col(q) = blockSuffix.col(0);
+                    result.argmax.col(q) = blockSuffixIndex.col(0);
+                }
+                else
+                    selectColumn(blockSuffix.col(r).data(), blockSuffixIndex.col(r).data(), runningPrefix.data(), runningPrefixIndex.data(),
+                                 outputRows, result.output.col(q).data(), result.argmax.col(q).data());
+            }
+            // the windows went through all the next block but its last column
+            if (windows == pooling && start + 2 * pooling <= cols)
+            {
+                columnMaximum(start + 2 * pooling - 1, next.col(pooling - 1).data(), nextIndex.col(pooling - 1).data());
+                std::swap(current, next);
+                std::swap(currentIndex, nextIndex);
+                ready = block + 1;
+            }
+        }
+    });
+    return result;
+}
+
+/**
+* Gradient with respect to the input given dC, the gradient with respect to the pooled output: every dC goes to the
+* argmax of its window, accumulated where overlapping windows share their maximum.
+*/
+inline Matrix slidingMaxPoolingGradient(const Matrix &dC, const PooledMatrix &forward)
+{
+    if (dC.rows() != forward.output.rows() || dC.cols() != forward.output.cols())
+        throw std::invalid_argument("The gradient doesn't match the pooled output.");
+    Matrix result = Matrix::Zero(forward.inputRows, forward.inputCols);
+    for (long k = 0; k < dC.size(); ++k)
+        result.data()[forward.argmax.data()[k]] += dC.data()[k];
+    return result;
+}
+
+} // namespace ann
+
+#endif
@@ -0,0 +1,287 @@
+#ifndef TILED_EXECUTOR_H_
+#define TILED_EXECUTOR_H_
+
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "convolution.hpp"
+
+namespace ann
+{
+
+/**
+* Rectangle of an image, in the coordinates of the input or the output of a stage; it may stick out of the image
+* where a stage reads its padding.
+*/
+struct TileRegion
+{
+    long row;
+    long col;
+    long rows;
+    long cols;
+};
+
+/**
+* What a tiled run did: inputPixels counts the pixels read, halo included, so inputPixels / (rows x cols of the input)
+* is the cost of the overlap. bufferBytes is the largest memory a worker holds at a time, whatever the image size.
+*/
+struct TilingStatistics
+{
+    long tiles = 0;
+    long inputPixels = 0;
+    long bufferBytes = 0;
+    int workers = 0;
+};
+
+/**
+* Runs a chain of convolution, ReLU and max pooling stages over an image too large to be held in memory, a tile of
+* the output at a time. Every output tile is traced back through the stages to the region of the input it depends
+* on, its receptive field: the tile plus a halo of (window - stride) pixels per stage, scaled by the strides of the
+* stages after it. The tiles overlap on the input only, each output pixel is computed once from the same values as in
+* a whole image pass, so the stitching is seamless: the results are those of the passes over the whole image, padding
+* included. The tiles are shared between the worker threads, each one running the engine kernels inline on its tile
+* (a convolution followed by a pooling goes through the fused kernel), so the memory is a few tile buffers per worker.
+* The input is read through a TileReader and the output handed to a TileWriter, both called concurrently on
+* disjoint tiles.
+*/
+class TiledExecutor
+{
+
+public:
+    // fills block with the pixels of the input whose top left corner is (row, col), always inside the image
+    using TileReader = std::function<void(long row, long col, Eigen::Ref<Matrix> block)>;
+    // receives the output pixels whose top left corner is (row, col)
+    using TileWriter = std::function<void(long row, long col, const Matrix &tile)>;
+
+private:
+    enum class StageType
+    {
+        Convolution,
+        ReLU,
+        MaxPooling
+    };
+
+    struct Stage
+    {
+        StageType type;
+        Matrix kernel;
+        ConvolutionParameters params;
+        ConvolutionAlgorithm algorithm;
+        int windowRows;
+        int windowCols;
+
+        TileRegion inputRegion(const TileRegion &output) const
+        {
+            return {output.row * params.rowStride - params.rowPadding, output.col * params.colStride - params.colPadding,
+                    (output.rows - 1) * params.rowStride + windowRows, (output.cols - 1) * params.colStride + windowCols};
+        }
+
+        long outputRows(long inputRows) const
+        {
+            return (inputRows + 2 * params.rowPadding - windowRows) / params.rowStride + 1;
+        }
+
+        long outputCols(long inputCols) const
+        {
+            return (inputCols + 2 * params.colPadding - windowCols) / params.colStride + 1;
+        }
+    };
+
+    std::vector<Stage> stages;
+    int tileRows;
+    int tileCols;
+
+    std::vector<TileRegion> regions(const TileRegion &output) const
+    {
+        std::vector<TileRegion> result(stages.size() + 1);
+        result.back() = output;
+        for (long k = stages.size() - 1; k >= 0; --k)
+            result[k] = stages[k].inputRegion(result[k + 1]);
+        return result;
+    }
+
+    // sizes of the input of every stage, and of the output last
+    std::vector<std::pair<long, long>> shapes(long inputRows, long inputCols) const
+    {
+        std::vector<std::pair<long, long>> result{{inputRows, inputCols}};
+        for (const auto &stage : stages)
+        {
+            const long rows = result.back().first + 2 * stage.params.rowPadding;
+            const long cols = result.back().second + 2 * stage.params.colPadding;
+            if (rows < stage.windowRows || cols < stage.windowCols)
+            {
+                std::stringstream msg;
+                msg << "The window " << stage.windowRows << "x" << stage.windowCols << " of a stage is larger than its padded input " << rows << "x" << cols << ".";
+                throw std::invalid_argument(msg.str());
+            }
+            result.emplace_back(stage.outputRows(result.back().first), stage.outputCols(result.back().second));
+        }
+        return result;
+    }
+
+    /**
+    * Zeroes the part of tile, covering region, outside the rows x cols image: padding for the next stage.
+    */
+    static void clip(Matrix &tile, const TileRegion &region, long rows, long cols)
+    {
+        const long top = std::clamp(-region.row, 0L, region.rows);
+        const long bottom = std::clamp(region.row + region.rows - rows, 0L, region.rows - top);
+        const long left = std::clamp(-region.col, 0L, region.cols);
+        const long right = std::clamp(region.col + region.cols - cols, 0L, region.cols - left);
+        tile.topRows(top).setZero();
+        tile.bottomRows(bottom).setZero();
+        tile.leftCols(left).setZero();
+        tile.rightCols(right).setZero();
+    }
+
+    Matrix processTile(const TileRegion &output, const std::vector<std::pair<long, long>> &sizes, const TileReader &read, long &inputPixels) const
+    {
+        const std::vector<TileRegion> region = regions(output);
+        Matrix tile = Matrix::Zero(region[0].rows, region[0].cols);
+        const long top = std::max(0L, region[0].row);
+        const long left = std::max(0L, region[0].col);
+        const long bottom = std::min(sizes[0].first, region[0].row + region[0].rows);
+        const long right = std::min(sizes[0].second, region[0].col + region[0].cols);
+        if (bottom > top && right > left)
+        {
+            read(top, left, tile.block(top - region[0].row, left - region[0].col, bottom - top, right - left));
+            inputPixels += (bottom - top) * (right - left);
+        }
+
+        for (size_t k = 0; k < stages.size(); ++k)
+        {
+            const Stage &stage = stages[k];
+            // the padding is in the tile already
+            const ConvolutionParameters params(0, 0, stage.params.rowStride, stage.params.colStride, stage.params.dilation);
+            if (stage.type == StageType::Convolution)
+            {
+                const bool relu = k + 1 < stages.size() && stages[k + 1].type == StageType::ReLU;
+                const size_t next = relu ? k + 2 : k + 1;
+                if (next < stages.size() && stages[next].type == StageType::MaxPooling && stages[next].windowRows * stages[next].windowRows <= 256)
+                {
+                    // the pooling windows of the tile only cover convolution outputs inside the image
+                    tile = maxPoolingConvolution(tile, stage.kernel, stages[next].windowRows, stages[next].params.rowStride, relu, params).output;
+                    k = next;
+                }
+                else
+                    tile = ann::convolution(tile, stage.kernel, params, stage.algorithm);
+            }
+            else if (stage.type == StageType::ReLU)
+                tile = tile.cwiseMax(0.0);
+            else
+                tile = slidingMaxPooling(tile, stage.windowRows, stage.params.rowStride).output;
+            clip(tile, region[k + 1], sizes[k + 1].first, sizes[k + 1].second);
+        }
+        return tile;
+    }
+
+public:
+    explicit TiledExecutor(int tileRows = 256, int tileCols = 256) : tileRows(tileRows), tileCols(tileCols)
+    {
+        if (tileRows < 1 || tileCols < 1)
+            throw std::invalid_argument("The tiles must not be empty.");
+    }
+
+    TiledExecutor &convolution(const Matrix &kernel, const ConvolutionParameters &params = ConvolutionParameters(), ConvolutionAlgorithm algorithm = ConvolutionAlgorithm::Automatic)
+    {
+        params.validate(params.dilatedSize(kernel.rows()), params.dilatedSize(kernel.cols()), kernel.rows(), kernel.cols());
+        stages.push_back({StageType::Convolution, kernel, params, algorithm, params.dilatedSize(kernel.rows()), params.dilatedSize(kernel.cols())});
+        return *this;
+    }
+
+    TiledExecutor &relu()
+    {
+        stages.push_back({StageType::ReLU, Matrix(), ConvolutionParameters(), ConvolutionAlgorithm::Automatic, 1, 1});
+        return *this;
+    }
+
+    TiledExecutor &maxPooling(int pooling, int stride)
+    {
+        if (pooling < 1 || stride < 1)
+            throw std::invalid_argument("The pooling window and its stride must be positive.");
+        stages.push_back({StageType::MaxPooling, Matrix(), ConvolutionParameters(0, stride), ConvolutionAlgorithm::Automatic, pooling, pooling});
+        return *this;
+    }
+
+    std::pair<long, long> outputSize(long inputRows, long inputCols) const
+    {
+        return shapes(inputRows, inputCols).back();
+    }
+
+    /**
+    * Receptive field of an output tile: the region of the input that its tileRows x tileCols pixels depend on.
+    */
+    TileRegion receptiveField(const TileRegion &output) const
+    {
+        return regions(output).front();
+    }
+
+    /**
+    * Bytes of the two largest consecutive stage buffers of a rows x cols output tile, what a worker holds at a time.
+    */
+    long tileBufferBytes(long rows, long cols) const
+    {
+        const std::vector<TileRegion> region = regions({0, 0, rows, cols});
+        long result = 0;
+        for (size_t k = 0; k + 1 < region.size(); ++k)
+            result = std::max(result, region[k].rows * region[k].cols + region[k + 1].rows * region[k + 1].cols);
+        return result * static_cast<long>(sizeof(double));
+    }
+
+    TilingStatistics run(long inputRows, long inputCols, const TileReader &read, const TileWriter &write) const
+    {
+        if (stages.empty())
+            throw std::invalid_argument("The executor has no stage.");
+        const std::vector<std::pair<long, long>> sizes = shapes(inputRows, inputCols);
+        const long tilesDown = (sizes.back().first + tileRows - 1) / tileRows;
+        const long tilesAcross = (sizes.back().second + tileCols - 1) / tileCols;
+        TilingStatistics result;
+        result.tiles = tilesDown * tilesAcross;
+        result.bufferBytes = tileBufferBytes(std::min<long>(tileRows, sizes.back().first), std::min<long>(tileCols, sizes.back().second));
+        result.workers = std::min<long>(numberOfWorkers(), result.tiles);
+
+        std::vector<long> inputPixels(result.workers, 0);
+        const long tilesPerWorker = (result.tiles + result.workers - 1) / result.workers;
+        parallelFor(0, result.workers, [&](long begin, long end) {
+            const bool serial = serialThread();
+            serialThread() = true;
+            for (long worker = begin; worker < end; ++worker)
+            {
+                // column-major tile order, down the columns of the output like Eigen
+                for (long t = worker * tilesPerWorker; t < std::min(result.tiles, (worker + 1) * tilesPerWorker); ++t)
+                {
+                    const long row = (t % tilesDown) * tileRows;
+                    const long col = (t / tilesDown) * tileCols;
+                    const TileRegion output{row, col, std::min<long>(tileRows, sizes.back().first - row), std::min<long>(tileCols, sizes.back().second - col)};
+                    write(row, col, processTile(output, sizes, read, inputPixels[worker]));
+                }
+            }
+            serialThread() = serial;
+        });
+        for (long pixels : inputPixels)
+            result.inputPixels += pixels;
+        return result;
+    }
+
+    /**
+    * Tiled run over an image in memory into a matrix, mostly to check the tiling against the whole image passes.
+    */
+    Matrix run(const Matrix &input, TilingStatistics *statistics = nullptr) const
+    {
+        const std::pair<long, long> size = outputSize(input.rows(), input.cols());
+        Matrix result(size.first, size.second);
+        TilingStatistics stats = run(
+            input.rows(), input.cols(), [&](long row, long col, Eigen::Ref<Matrix> block) { block = input.block(row, col, block.rows(), block.cols()); },
+            [&](long row, long col, const Matrix &tile) { result.block(row, col, tile.rows(), tile.cols()) = tile; });
+        if (statistics)
+            *statistics = stats;
+        return result;
+    }
+};
+
+} // namespace ann
+
+#endif
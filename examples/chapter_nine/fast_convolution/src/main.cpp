@@ -0,0 +1,811 @@
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include "matrix_definitions.hpp"
+#include "convolution.hpp"
+#include "patch_trainer.hpp"
+#include "tiled_executor.hpp"
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/core/eigen.hpp>
+
+using namespace ann;
+
+/**
+* Best wall time in milliseconds of repetitions calls of fnc.
+*/
+template <typename Function>
+double benchmark(Function fnc, int repetitions)
+{
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < repetitions; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fnc();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+double maxError(const std::vector<Matrix> &expected, const std::vector<Matrix> &actual)
+{
+    double result = 0.0;
+    for (size_t f = 0; f < expected.size(); ++f)
+    {
+        if (expected[f].rows() != actual[f].rows() || expected[f].cols() != actual[f].cols())
+            return std::numeric_limits<double>::infinity();
+        result = std::max(result, (expected[f] - actual[f]).cwiseAbs().maxCoeff());
+    }
+    return result;
+}
+
+std::string describe(const ConvolutionParameters &params)
+{
+    std::stringstream result;
+    result << "pad " << params.rowPadding << "x" << params.colPadding << " stride " << params.rowStride << "x" << params.colStride << " dil " << params.dilation;
+    return result.str();
+}
+
+/**
+* The separate passes of the max_pooling and relu_convolution examples: each one writes a full image and the
+* backward pass searches every window again for its maximum.
+*/
+Matrix maxPooling(const Matrix &input, int pooling, int stride)
+{
+    Matrix result((input.rows() - pooling) / stride + 1, (input.cols() - pooling) / stride + 1);
+    for (int j = 0; j < result.cols(); ++j)
+        for (int i = 0; i < result.rows(); ++i)
+            result(i, j) = input.block(stride * i, stride * j, pooling, pooling).maxCoeff();
+    return result;
+}
+
+Matrix gradientPooling(const Matrix &dC, const Matrix &convoluted, int pooling, int stride)
+{
+    Matrix result = Matrix::Zero(convoluted.rows(), convoluted.cols());
+    for (int j = 0; j < dC.cols(); ++j)
+    {
+        for (int i = 0; i < dC.rows(); ++i)
+        {
+            Matrix::Index maxRow, maxCol;
+            convoluted.block(stride * i, stride * j, pooling, pooling).maxCoeff(&maxRow, &maxCol);
+            result(stride * i + maxRow, stride * j + maxCol) += dC(i, j);
+        }
+    }
+    return result;
+}
+
+/**
+* Compares every geometry combination against the schoolbook implementation.
+*/
+/**
+* Explicitly padded copy of the input for the given BorderMode, the reference of the border modes.
+*/
+Matrix padImage(const Matrix &image, int padding, BorderMode mode)
+{
+    Matrix result(image.rows() + 2 * padding, image.cols() + 2 * padding);
+    for (int j = 0; j < result.cols(); ++j)
+    {
+        const int col = borderIndex(j - padding, image.cols(), mode);
+        for (int i = 0; i < result.rows(); ++i)
+        {
+            const int row = borderIndex(i - padding, image.rows(), mode);
+            result(i, j) = row < 0 || col < 0 ? 0.0 : image(row, col);
+        }
+    }
+    return result;
+}
+
+bool checkCorrectness()
+{
+    std::vector<ConvolutionParameters> geometries = {
+        ConvolutionParameters(), ConvolutionParameters(1), ConvolutionParameters(2, 2), ConvolutionParameters(0, 3),
+        ConvolutionParameters(0, 1, 1), ConvolutionParameters(3, 2, 2), ConvolutionParameters(1, 2, 1, 3, 1)};
+    std::vector<int> kernelSizes = {1, 2, 3, 5};
+    bool result = true;
+    Matrix input = Matrix::Random(37, 29);
+    for (const auto &params : geometries)
+    {
+        for (int kernelSize : kernelSizes)
+        {
+            std::vector<Matrix> kernels = {Matrix::Random(kernelSize, kernelSize), Matrix::Random(kernelSize, kernelSize)};
+            auto expected = convolution(input, kernels, params, ConvolutionAlgorithm::Reference);
+            std::vector<ConvolutionAlgorithm> algorithms = {ConvolutionAlgorithm::Automatic, ConvolutionAlgorithm::Direct, ConvolutionAlgorithm::FFT, ConvolutionAlgorithm::Separable};
+            if (kernelSize == 3 && params.isUnitStride() && params.dilation == 0)
+                algorithms.insert(algorithms.end(), {ConvolutionAlgorithm::WinogradF2x2, ConvolutionAlgorithm::WinogradF4x4});
+            for (auto algorithm : algorithms)
+            {
+                double error = maxError(expected, convolution(input, kernels, params, algorithm));
+                if (error > 1e-10)
+                {
+                    std::cout << "MISMATCH " << algorithmName(algorithm) << " " << kernelSize << "x" << kernelSize << " " << describe(params) << " error " << error << "\n";
+                    result = false;
+                }
+            }
+        }
+    }
+    // kernel gradient shapes: the kernel is almost as large as the input
+    std::vector<ConvolutionParameters> gradients = {ConvolutionParameters(), ConvolutionParameters(0, 1, 1), ConvolutionParameters(1)};
+    for (const auto &params : gradients)
+    {
+        Matrix dC = Matrix::Random(params.rowPadding ? 35 : 17, params.rowPadding ? 27 : 14);
+        Matrix expected = convolution(input, dC, params, ConvolutionAlgorithm::Reference);
+        double error = std::max(maxError({expected}, {convolution(input, dC, params)}), maxError({expected}, {convolution(input, dC, params, ConvolutionAlgorithm::FFT)}));
+        if (error > 1e-10)
+        {
+            std::cout << "MISMATCH gradient " << dC.rows() << "x" << dC.cols() << " " << describe(params) << " error " << error << "\n";
+            result = false;
+        }
+    }
+    // the border modes against the explicitly padded input, paddings up to larger than the input
+    for (const auto &params : {ConvolutionParameters(1), ConvolutionParameters(2, 2), ConvolutionParameters(3, 1, 1), ConvolutionParameters(30, 3, 2)})
+    {
+        Matrix kernel = Matrix::Random(5, 5);
+        for (auto mode : {BorderMode::Zero, BorderMode::Replicate, BorderMode::Reflect})
+        {
+            Matrix expected = referenceConvolution(padImage(input, params.rowPadding, mode), kernel, ConvolutionParameters(0, params.rowStride, params.dilation));
+            double error = maxError({expected}, {borderConvolution(input, kernel, params, mode)});
+            if (error > 1e-10)
+            {
+                std::cout << "MISMATCH border " << static_cast<int>(mode) << " " << describe(params) << " error " << error << "\n";
+                result = false;
+            }
+        }
+    }
+    // fused convolution -> (ReLU) -> max pooling
+    for (const auto &params : geometries)
+    {
+        Matrix kernel = Matrix::Random(3, 3);
+        Matrix convoluted = convolution(input, kernel, params, ConvolutionAlgorithm::Reference);
+        for (bool relu : {false, true})
+        {
+            Matrix expected = maxPooling(relu ? Matrix(convoluted.cwiseMax(0.0)) : convoluted, 2, 1);
+            double error = maxError({expected}, {maxPoolingConvolution(input, kernel, 2, 1, relu, params).output});
+            if (error > 1e-10)
+            {
+                std::cout << "MISMATCH fused " << (relu ? "relu " : "") << describe(params) << " error " << error << "\n";
+                result = false;
+            }
+        }
+    }
+    // sliding max pooling, on small integers so that the windows have ties
+    const Matrix levels = (5.0 * Matrix::Random(23, 19)).array().round().matrix();
+    for (auto [pooling, stride] : {std::make_pair(1, 1), std::make_pair(2, 1), std::make_pair(3, 1), std::make_pair(3, 2), std::make_pair(4, 3), std::make_pair(7, 1), std::make_pair(5, 7)})
+    {
+        const PooledMatrix pooled = slidingMaxPooling(levels, pooling, stride);
+        const Matrix dC = Matrix::Random(pooled.output.rows(), pooled.output.cols());
+        double error = std::max(maxError({maxPooling(levels, pooling, stride)}, {pooled.output}),
+                                maxError({gradientPooling(dC, levels, pooling, stride)}, {slidingMaxPoolingGradient(dC, pooled)}));
+        if (error > 1e-10)
+        {
+            std::cout << "MISMATCH sliding max pooling " << pooling << "/" << stride << " error " << error << "\n";
+            result = false;
+        }
+    }
+    // tiled conv -> ReLU -> pooling -> conv chains, tiles not dividing the output
+    for (const auto &params : geometries)
+    {
+        Matrix kernel = Matrix::Random(3, 3), second = Matrix::Random(2, 2);
+        Matrix convoluted = convolution(input, kernel, params, ConvolutionAlgorithm::Reference);
+        Matrix expected = convolution(maxPooling(convoluted.cwiseMax(0.0), 2, 1), second, ConvolutionParameters(1), ConvolutionAlgorithm::Reference);
+        for (int tileSize : {1, 4, 7})
+        {
+            TiledExecutor executor(tileSize, tileSize + 2);
+            executor.convolution(kernel, params).relu().maxPooling(2, 1).convolution(second, ConvolutionParameters(1));
+            double error = maxError({expected}, {executor.run(input)});
+            if (error > 1e-10)
+            {
+                std::cout << "MISMATCH tiled " << tileSize << " " << describe(params) << " error " << error << "\n";
+                result = false;
+            }
+        }
+    }
+    std::cout << (result ? "All geometries match the reference implementation\n" : "Some geometries do not match\n");
+    return result;
+}
+
+void benchmarkSizes()
+{
+    std::vector<int> imageSizes = {64, 256, 1024};
+    std::vector<int> kernelSizes = {1, 3, 5, 7, 11};
+    std::vector<int> filterCounts = {1, 8};
+
+    std::cout << "\n" << std::setw(8) << "image" << std::setw(8) << "kernel" << std::setw(9) << "filters";
+    std::cout << std::setw(14) << "reference ms" << std::setw(12) << "engine ms" << std::setw(10) << "speedup" << std::setw(12) << "max error" << "\n";
+    for (int imageSize : imageSizes)
+    {
+        Matrix input = Matrix::Random(imageSize, imageSize);
+        for (int kernelSize : kernelSizes)
+        {
+            for (int filters : filterCounts)
+            {
+                std::vector<Matrix> kernels;
+                for (int f = 0; f < filters; ++f)
+                    kernels.push_back(Matrix::Random(kernelSize, kernelSize));
+                ConvolutionParameters params(kernelSize / 2);
+
+                std::vector<Matrix> expected, actual;
+                const int repetitions = imageSize > 256 ? 1 : 5;
+                double referenceTime = benchmark([&]() { expected = convolution(input, kernels, params, ConvolutionAlgorithm::Reference); }, repetitions);
+                double engineTime = benchmark([&]() { actual = convolution(input, kernels, params); }, 3 * repetitions);
+
+                std::cout << std::setw(8) << imageSize << std::setw(8) << kernelSize << std::setw(9) << filters;
+                std::cout << std::fixed << std::setprecision(3) << std::setw(14) << referenceTime << std::setw(12) << engineTime;
+                std::cout << std::setprecision(1) << std::setw(9) << referenceTime / engineTime << "x";
+                std::cout << std::scientific << std::setprecision(2) << std::setw(12) << maxError(expected, actual) << std::defaultfloat << "\n";
+            }
+        }
+    }
+}
+
+/**
+* Winograd error against the direct convolution for image-like inputs (0..255) and kernels in [-1, 1].
+* The error is reported both absolute and relative to sum(|d| * |g|), the natural scale of the rounding error.
+*/
+void winogradErrorBounds()
+{
+    std::cout << "\n" << std::setw(22) << "algorithm" << std::setw(16) << "max abs error" << std::setw(16) << "relative" << "\n";
+    Matrix input = 127.5 * (Matrix::Random(512, 512).array() + 1.0).matrix();
+    std::vector<Matrix> kernels;
+    for (int f = 0; f < 16; ++f)
+        kernels.push_back(Matrix::Random(3, 3));
+    ConvolutionParameters params(1);
+    auto expected = convolution(input, kernels, params, ConvolutionAlgorithm::Reference);
+    std::vector<Matrix> scale;
+    for (const auto &kernel : kernels)
+        scale.push_back(convolution(input.cwiseAbs(), kernel.cwiseAbs(), params, ConvolutionAlgorithm::Reference));
+
+    for (auto algorithm : {ConvolutionAlgorithm::Im2col, ConvolutionAlgorithm::WinogradF2x2, ConvolutionAlgorithm::WinogradF4x4})
+    {
+        auto actual = convolution(input, kernels, params, algorithm);
+        double relative = 0.0;
+        for (size_t f = 0; f < kernels.size(); ++f)
+            relative = std::max(relative, ((expected[f] - actual[f]).array().abs() / scale[f].array()).maxCoeff());
+        std::cout << std::setw(22) << algorithmName(algorithm) << std::scientific << std::setprecision(2);
+        std::cout << std::setw(16) << maxError(expected, actual) << std::setw(16) << relative << std::defaultfloat << "\n";
+    }
+}
+
+/**
+* Throughput of the 3x3 algorithms on the example image, for a single filter and for a bank of 8 filters.
+*/
+void benchmarkImage(const Matrix &image)
+{
+    Matrix sharpen(3, 3), edges(3, 3);
+    sharpen << 0, -1, 0, -1, 5, -1, 0, -1, 0;
+    edges << -1, 0, 1, -1, 0, 1, -1, 0, 1;
+
+    std::cout << "\nconvolution_example.png " << image.rows() << "x" << image.cols() << "\n";
+    std::cout << std::setw(22) << "algorithm" << std::setw(9) << "filters" << std::setw(10) << "mult/px";
+    std::cout << std::setw(12) << "ms" << std::setw(14) << "Mpixel/s" << std::setw(12) << "max error" << "\n";
+    for (int filters : {1, 8})
+    {
+        std::vector<Matrix> kernels = {sharpen, edges};
+        while (static_cast<int>(kernels.size()) < filters)
+            kernels.push_back(Matrix::Random(3, 3));
+        kernels.resize(filters);
+        ConvolutionParameters params(1);
+        auto expected = convolution(image, kernels, params, ConvolutionAlgorithm::Reference);
+        const double pixels = static_cast<double>(image.size()) * filters;
+
+        std::vector<std::pair<ConvolutionAlgorithm, double>> algorithms = {
+            {ConvolutionAlgorithm::Reference, 9.0}, {ConvolutionAlgorithm::Im2col, 9.0}, {ConvolutionAlgorithm::Direct, 9.0},
+            {ConvolutionAlgorithm::WinogradF2x2, 16.0 / 4.0}, {ConvolutionAlgorithm::WinogradF4x4, 36.0 / 16.0}};
+        for (const auto &algorithm : algorithms)
+        {
+            std::vector<Matrix> actual;
+            double time = benchmark([&]() { actual = convolution(image, kernels, params, algorithm.first); }, 10);
+            std::cout << std::setw(22) << algorithmName(algorithm.first) << std::setw(9) << filters << std::setw(10) << std::fixed << std::setprecision(2) << algorithm.second;
+            std::cout << std::setw(12) << std::setprecision(3) << time << std::setw(14) << std::setprecision(1) << pixels / (time * 1e3);
+            std::cout << std::scientific << std::setprecision(2) << std::setw(12) << maxError(expected, actual) << std::defaultfloat << "\n";
+        }
+    }
+}
+
+/**
+* Direct and FFT convolution on the example image for growing kernels, and for kernel gradient shapes
+* where the "kernel" is an error map almost as large as the image and the output is small.
+*/
+void benchmarkLargeKernels(const Matrix &image)
+{
+    std::cout << "\n" << std::setw(12) << "case" << std::setw(12) << "kernel" << std::setw(12) << "direct ms" << std::setw(10) << "fft ms";
+    std::cout << std::setw(22) << "automatic" << std::setw(14) << "max error" << "\n";
+    auto run = [&image](const std::string &name, const Matrix &kernel, const ConvolutionParameters &params, ConvolutionAlgorithm direct) {
+        Matrix expected, actual;
+        double directTime = benchmark([&]() { expected = convolution(image, kernel, params, direct); }, 2);
+        double fftTime = benchmark([&]() { actual = convolution(image, kernel, params, ConvolutionAlgorithm::FFT); }, 2);
+        auto automatic = selectAlgorithm(image, {kernel}, params);
+        std::cout << std::setw(12) << name << std::setw(12) << (std::to_string(kernel.rows()) + "x" + std::to_string(kernel.cols()));
+        std::cout << std::fixed << std::setprecision(2) << std::setw(12) << directTime << std::setw(10) << fftTime << std::setw(22) << algorithmName(automatic);
+        std::cout << std::scientific << std::setprecision(2) << std::setw(14) << maxError({expected}, {actual}) << std::defaultfloat << "\n";
+    };
+    for (int kernelSize : {5, 9, 15, 21, 31})
+        run("forward", Matrix::Random(kernelSize, kernelSize), ConvolutionParameters(kernelSize / 2), ConvolutionAlgorithm::Im2col);
+    for (int outputSize : {5, 11, 21, 41})
+        run("gradient", Matrix::Random(image.rows() - outputSize + 1, image.cols() - outputSize + 1), ConvolutionParameters(), ConvolutionAlgorithm::DotProduct);
+}
+
+/**
+* Multiply-add throughput of all the workers on independent register accumulators, in GFLOP/s.
+* It is the practical peak of this build: the same vector width and the same contraction to FMA as the kernels.
+*/
+double peakGflops()
+{
+    using Packet = Eigen::Array<double, 8, 1>;
+    const int accumulators = 8;
+    const long iterations = 1 << 22;
+    std::vector<double> sinks(numberOfWorkers());
+    double time = benchmark([&]() {
+        parallelFor(0, numberOfWorkers(), [&](long begin, long end) {
+            for (long worker = begin; worker < end; ++worker)
+            {
+                Packet accumulator[accumulators];
+                for (int k = 0; k < accumulators; ++k)
+                    accumulator[k] = Packet::Constant(k);
+                const Packet x = Packet::Constant(0.999999), y = Packet::Constant(1e-6);
+                for (long i = 0; i < iterations; ++i)
+                    for (int k = 0; k < accumulators; ++k)
+                        accumulator[k] = accumulator[k] * x + y;
+                for (int k = 0; k < accumulators; ++k)
+                    sinks[worker] += accumulator[k].sum();
+            }
+        });
+    }, 3);
+    std::cout << "\nMultiply-add peak: " << std::fixed << std::setprecision(1) << 2.0 * Packet::SizeAtCompileTime * accumulators * iterations * numberOfWorkers() / (time * 1e6);
+    std::cout << " GFLOP/s (" << Eigen::internal::packet_traits<double>::size << " doubles per SIMD register, checksum " << std::defaultfloat << sinks.front() << ")\n";
+    return 2.0 * Packet::SizeAtCompileTime * accumulators * iterations * numberOfWorkers() / (time * 1e6);
+}
+
+/**
+* Direct convolution throughput on the example image for the geometries of the chapter nine examples
+* (valid, same padding, strided, dilated), as GFLOP/s (2 flops per tap and output) and fraction of the peak.
+*/
+void benchmarkDirect(const Matrix &image, double peak)
+{
+    std::cout << std::setw(8) << "kernel" << std::setw(34) << "geometry" << std::setw(12) << "im2col ms" << std::setw(12) << "direct ms";
+    std::cout << std::setw(10) << "GFLOP/s" << std::setw(8) << "peak" << std::setw(12) << "max error" << "\n";
+    for (int kernelSize : {3, 5, 7})
+    {
+        Matrix kernel = Matrix::Random(kernelSize, kernelSize);
+        for (const auto &params : {ConvolutionParameters(), ConvolutionParameters(kernelSize / 2), ConvolutionParameters(0, 2), ConvolutionParameters(0, 1, 1)})
+        {
+            Matrix expected, actual;
+            double im2colTime = benchmark([&]() { expected = convolution(image, kernel, params, ConvolutionAlgorithm::Im2col); }, 10);
+            double directTime = benchmark([&]() { actual = convolution(image, kernel, params, ConvolutionAlgorithm::Direct); }, 10);
+            const double gflops = 2.0 * actual.size() * kernel.size() / (directTime * 1e6);
+            std::cout << std::setw(8) << (std::to_string(kernelSize) + "x" + std::to_string(kernelSize)) << std::setw(34) << describe(params);
+            std::cout << std::fixed << std::setprecision(3) << std::setw(12) << im2colTime << std::setw(12) << directTime;
+            std::cout << std::setprecision(2) << std::setw(10) << gflops << std::setprecision(0) << std::setw(7) << 100.0 * gflops / peak << "%";
+            std::cout << std::scientific << std::setprecision(2) << std::setw(12) << maxError({expected}, {actual}) << std::defaultfloat << "\n";
+        }
+    }
+}
+
+/**
+* Fused convolution -> ReLU -> max pooling against the three passes, forward and backward.
+*/
+void benchmarkFused(const Matrix &image)
+{
+    std::cout << "\n" << std::setw(8) << "kernel" << std::setw(10) << "pooling" << std::setw(6) << "relu" << std::setw(14) << "passes ms";
+    std::cout << std::setw(12) << "fused ms" << std::setw(16) << "passes bwd ms" << std::setw(14) << "fused bwd ms" << std::setw(12) << "max error" << "\n";
+    for (int kernelSize : {3, 5})
+    {
+        Matrix kernel = Matrix::Random(kernelSize, kernelSize);
+        for (auto [pooling, stride] : {std::make_pair(2, 2), std::make_pair(2, 1), std::make_pair(3, 2)})
+        {
+            for (bool relu : {false, true})
+            {
+                Matrix convoluted, expected, expectedGradient, actualGradient;
+                double passesTime = benchmark([&]() {
+                    convoluted = convolution(image, kernel);
+                    if (relu)
+                        convoluted = convoluted.cwiseMax(0.0);
+                    expected = maxPooling(convoluted, pooling, stride);
+                }, 10);
+                PooledConvolution fused;
+                double fusedTime = benchmark([&]() { fused = maxPoolingConvolution(image, kernel, pooling, stride, relu); }, 10);
+
+                Matrix dC = Matrix::Random(expected.rows(), expected.cols());
+                double passesBackward = benchmark([&]() {
+                    expectedGradient = gradientPooling(dC, convoluted, pooling, stride);
+                    if (relu)
+                        expectedGradient = expectedGradient.cwiseProduct(convoluted.unaryExpr([](double value) { return value > 0.0 ? 1.0 : 0.0; }));
+                }, 10);
+                double fusedBackward = benchmark([&]() { actualGradient = maxPoolingGradient(dC, fused); }, 10);
+
+                std::cout << std::setw(8) << (std::to_string(kernelSize) + "x" + std::to_string(kernelSize));
+                std::cout << std::setw(10) << (std::to_string(pooling) + "/" + std::to_string(stride)) << std::setw(6) << (relu ? "yes" : "no");
+                std::cout << std::fixed << std::setprecision(3) << std::setw(14) << passesTime << std::setw(12) << fusedTime;
+                std::cout << std::setw(16) << passesBackward << std::setw(14) << fusedBackward;
+                std::cout << std::scientific << std::setprecision(2) << std::setw(12);
+                std::cout << std::max(maxError({expected}, {fused.output}), maxError({expectedGradient}, {actualGradient})) << std::defaultfloat << "\n";
+            }
+        }
+    }
+}
+
+/**
+* Max pooling of the image by window size: the window search of the reference and of the fused pass (same windows, no
+* convolution) grows with pooling^2, the sliding maxima stay at a few comparisons per pixel; backward by argmax.
+*/
+void benchmarkSlidingPooling(const Matrix &image)
+{
+    std::cout << "\n" << std::setw(10) << "pooling" << std::setw(14) << "windows ms" << std::setw(12) << "fused ms" << std::setw(12) << "sliding ms";
+    std::cout << std::setw(16) << "windows bwd ms" << std::setw(16) << "sliding bwd ms" << std::setw(12) << "max error" << "\n";
+    const Matrix identity = Matrix::Ones(1, 1);
+    for (auto [pooling, stride] : {std::make_pair(2, 1), std::make_pair(3, 1), std::make_pair(5, 1), std::make_pair(9, 1), std::make_pair(16, 1), std::make_pair(31, 1), std::make_pair(9, 4)})
+    {
+        Matrix expected, expectedGradient, actualGradient;
+        PooledMatrix pooled;
+        double windowsTime = benchmark([&]() { expected = maxPooling(image, pooling, stride); }, 3);
+        double fusedTime = std::nan("");
+        if (pooling * pooling <= 256)
+            fusedTime = benchmark([&]() { maxPoolingConvolution(image, identity, pooling, stride); }, 3);
+        double slidingTime = benchmark([&]() { pooled = slidingMaxPooling(image, pooling, stride); }, 10);
+
+        Matrix dC = Matrix::Random(expected.rows(), expected.cols());
+        double windowsBackward = benchmark([&]() { expectedGradient = gradientPooling(dC, image, pooling, stride); }, 3);
+        double slidingBackward = benchmark([&]() { actualGradient = slidingMaxPoolingGradient(dC, pooled); }, 10);
+
+        std::cout << std::setw(10) << (std::to_string(pooling) + "/" + std::to_string(stride));
+        std::cout << std::fixed << std::setprecision(3) << std::setw(14) << windowsTime << std::setw(12) << fusedTime << std::setw(12) << slidingTime;
+        std::cout << std::setw(16) << windowsBackward << std::setw(16) << slidingBackward;
+        std::cout << std::scientific << std::setprecision(2) << std::setw(12);
+        std::cout << std::max(maxError({expected}, {pooled.output}), maxError({expectedGradient}, {actualGradient})) << std::defaultfloat << "\n";
+    }
+}
+
+/**
+* The zero filled kernel the strided_convolution example used to build for a dilation.
+*/
+Matrix dilate(const Matrix &kernel, int dilation)
+{
+    const int step = dilation + 1;
+    Matrix result = Matrix::Zero((kernel.rows() - 1) * step + 1, (kernel.cols() - 1) * step + 1);
+    for (int b = 0; b < kernel.cols(); ++b)
+        for (int a = 0; a < kernel.rows(); ++a)
+            result(a * step, b * step) = kernel(a, b);
+    return result;
+}
+
+/**
+* Dilation 0 to 4 with the dilation read as a step in the input against the convolution with the zero filled kernel,
+* whose cost grows with (dilation + 1)^2. Reports the time per output so that the shrinking output doesn't hide the trend.
+*/
+void benchmarkDilation(const Matrix &image)
+{
+    std::cout << "\n" << std::setw(14) << "kernel/stride" << std::setw(10) << "dilation" << std::setw(16) << "zero filled ms";
+    std::cout << std::setw(12) << "stepped ms" << std::setw(16) << "ns per output" << std::setw(22) << "automatic" << std::setw(12) << "max error" << "\n";
+    for (int kernelSize : {3, 5})
+    {
+        Matrix kernel = Matrix::Random(kernelSize, kernelSize);
+        for (int stride : {1, 2})
+        {
+            for (int dilation = 0; dilation <= 4; ++dilation)
+            {
+                const ConvolutionParameters params(0, stride, dilation);
+                const Matrix dilated = dilate(kernel, dilation);
+                Matrix expected, actual;
+                double zeroFilledTime = benchmark([&]() { expected = convolution(image, dilated, ConvolutionParameters(0, stride)); }, 10);
+                double steppedTime = benchmark([&]() { actual = convolution(image, kernel, params); }, 10);
+                std::cout << std::setw(14) << (std::to_string(kernelSize) + "x" + std::to_string(kernelSize) + "/" + std::to_string(stride));
+                std::cout << std::setw(10) << dilation << std::fixed << std::setprecision(3) << std::setw(16) << zeroFilledTime << std::setw(12) << steppedTime;
+                std::cout << std::setprecision(2) << std::setw(16) << 1e6 * steppedTime / actual.size();
+                std::cout << std::setw(22) << algorithmName(selectAlgorithm(image, {kernel}, params));
+                std::cout << std::scientific << std::setprecision(2) << std::setw(12) << maxError({expected}, {actual}) << std::defaultfloat << "\n";
+            }
+        }
+    }
+}
+
+/**
+* Same padding convolution for the three border modes: padded copy + direct convolution against the interior/border split
+* reading the input in place.
+*/
+void benchmarkBorders(const Matrix &image)
+{
+    const std::vector<std::pair<BorderMode, std::string>> modes = {{BorderMode::Zero, "zero"}, {BorderMode::Replicate, "replicate"}, {BorderMode::Reflect, "reflect"}};
+    std::cout << "\n" << std::setw(8) << "kernel" << std::setw(8) << "stride" << std::setw(12) << "border" << std::setw(14) << "padded ms";
+    std::cout << std::setw(14) << "in place ms" << std::setw(12) << "max error" << "\n";
+    for (int kernelSize : {3, 5, 7})
+    {
+        Matrix kernel = Matrix::Random(kernelSize, kernelSize);
+        for (int stride : {1, 2})
+        {
+            for (const auto &mode : modes)
+            {
+                const int padding = kernelSize / 2;
+                Matrix expected, actual;
+                double paddedTime = benchmark([&]() {
+                    expected = directConvolution(padImage(image, padding, mode.first), {kernel}, ConvolutionParameters(0, stride)).front();
+                }, 10);
+                double inPlaceTime = benchmark([&]() { actual = borderConvolution(image, kernel, ConvolutionParameters(padding, stride), mode.first); }, 10);
+                std::cout << std::setw(8) << (std::to_string(kernelSize) + "x" + std::to_string(kernelSize)) << std::setw(8) << stride << std::setw(12) << mode.second;
+                std::cout << std::fixed << std::setprecision(3) << std::setw(14) << paddedTime << std::setw(14) << inPlaceTime;
+                std::cout << std::scientific << std::setprecision(2) << std::setw(12) << maxError({expected}, {actual}) << std::defaultfloat << "\n";
+            }
+        }
+    }
+}
+
+/**
+* One epoch of the kernel fitting loops of valid_convolution (quadratic cost) and max_pooling on the fixed image:
+* the engine convolutions against the patch matrix built once before the loop.
+*/
+void benchmarkKernelFitting(const Matrix &image)
+{
+    Matrix kernel = Matrix::Random(3, 3);
+    Matrix target = convolution(image, Matrix::Random(3, 3));
+    Matrix output, expected, actual;
+    PatchMatrix patches(image, 3, 3);
+    double buildTime = benchmark([&]() { patches = PatchMatrix(image, 3, 3); }, 3);
+    const Matrix targetGradient = patches.kernelGradient(target);
+
+    std::cout << "\n" << std::setw(28) << "3x3 kernel fitting" << std::setw(14) << "engine ms" << std::setw(14) << "patches ms" << std::setw(12) << "max error" << "\n";
+    auto report = [](const std::string &name, double engineTime, double patchesTime, double error) {
+        std::cout << std::setw(28) << name << std::fixed << std::setprecision(3) << std::setw(14) << engineTime << std::setw(14) << patchesTime;
+        std::cout << std::scientific << std::setprecision(2) << std::setw(12) << error << std::defaultfloat << "\n";
+    };
+    std::cout << std::setw(28) << "build (once)" << std::fixed << std::setprecision(3) << std::setw(28) << buildTime << std::defaultfloat << "\n";
+
+    double engineTime = benchmark([&]() { expected = convolution(image, kernel); }, 10);
+    double patchesTime = benchmark([&]() { actual = patches.convolution(kernel); }, 10);
+    report("forward", engineTime, patchesTime, maxError({expected}, {actual}) / expected.cwiseAbs().maxCoeff());
+
+    Matrix dC = convolution(image, kernel) - target;
+    engineTime = benchmark([&]() { expected = convolution(image, dC); }, 10);
+    patchesTime = benchmark([&]() { actual = patches.kernelGradient(dC); }, 10);
+    report("gradient", engineTime, patchesTime, maxError({expected}, {actual}) / expected.cwiseAbs().maxCoeff());
+
+    patchesTime = benchmark([&]() { actual = patches.quadraticGradient(kernel, targetGradient); }, 10);
+    report("quadratic cost gradient", engineTime, patchesTime, maxError({expected}, {actual}) / expected.cwiseAbs().maxCoeff());
+
+    const PooledConvolution pooled = maxPoolingConvolution(image, kernel, 2, 2);
+    Matrix pooledGradient = Matrix::Random(pooled.output.rows(), pooled.output.cols());
+    engineTime = benchmark([&]() { expected = convolution(image, maxPoolingGradient(pooledGradient, pooled)); }, 10);
+    patchesTime = benchmark([&]() { actual = patches.kernelGradient(pooledGradient, pooled); }, 10);
+    report("max pooling 2/2 gradient", engineTime, patchesTime, maxError({expected}, {actual}) / expected.cwiseAbs().maxCoeff());
+}
+
+/**
+* Fitting the 3x3 filter of the chapter nine examples on the image: full image gradient descent with the former
+* learning rate against patch minibatches (16 patches of 32x32 outputs) with SGD and Adam. The work is counted in full
+* image passes (forward + gradient), until the MSE falls below 1e-4 of the mean square of the target.
+*/
+void benchmarkPatchTraining(const Matrix &image)
+{
+    Matrix groundTruthFilter(3, 3);
+    groundTruthFilter << -1, 0, 1, -1, 0, 1, -1, 0, 1;
+    const Matrix target = convolution(image, groundTruthFilter);
+    const Matrix initialKernel = 0.05 * Matrix::Random(3, 3);
+    const double goal = 1e-4 * target.squaredNorm() / target.size();
+    auto mse = [&](const Matrix &kernel) { return (convolution(image, kernel) - target).squaredNorm() / target.size(); };
+
+    std::cout << "\n" << std::setw(22) << "3x3 filter fitting" << std::setw(16) << "learning rate" << std::setw(14) << "image passes";
+    std::cout << std::setw(14) << "final MSE" << std::setw(12) << "time ms" << "\n";
+    auto report = [&](const std::string &name, double learningRate, double passes, double cost, double time) {
+        std::cout << std::setw(22) << name << std::scientific << std::setprecision(1) << std::setw(16) << learningRate;
+        std::cout << std::fixed << std::setprecision(1) << std::setw(14) << passes << std::scientific << std::setprecision(2) << std::setw(14) << cost;
+        std::cout << std::fixed << std::setprecision(1) << std::setw(12) << time << (cost > goal ? "  (not reached)" : "") << std::defaultfloat << "\n";
+    };
+
+    // full image gradient descent, as the examples did before the patch trainer: the gradient sums over every pixel,
+    // hence the tiny learning rate
+    const double fullLearningRate = 1e-11;
+    const int maxEpochs = 2000;
+    Matrix kernel = initialKernel;
+    int epochs = 0;
+    double cost = mse(kernel);
+    auto start = std::chrono::steady_clock::now();
+    while (epochs < maxEpochs && cost > goal)
+    {
+        Matrix dC = convolution(image, kernel) - target;
+        cost = dC.squaredNorm() / dC.size();
+        kernel -= fullLearningRate * convolution(image, dC);
+        ++epochs;
+    }
+    report("full image GD", fullLearningRate, epochs, cost, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+    for (const auto &optimizer : {std::make_pair(std::string("patch SGD"), 1e-5), std::make_pair(std::string("patch Adam"), 1e-2)})
+    {
+        PatchKernelTrainer trainer({image}, {target}, initialKernel, 32, 16, optimizer.second);
+        if (optimizer.first == "patch Adam")
+            trainer.hookOptimizer(adamOptimizer());
+        double time = 0.0;
+        cost = mse(trainer.getKernel());
+        // the cost on the whole image is checked every 50 steps, outside the timing and the pass count
+        while (trainer.getSteps() < 10000 && cost > goal)
+        {
+            start = std::chrono::steady_clock::now();
+            for (int s = 0; s < 50; ++s)
+                trainer.step();
+            time += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            cost = trainer.cost();
+        }
+        report(optimizer.first, optimizer.second, trainer.getImagePasses(), cost, time);
+    }
+}
+
+/**
+* A chain of stages described once for both the tiled executor and the passes over the whole image.
+*/
+struct ChainStage
+{
+    char type; // 'c'onvolution, 'r'elu or 'p'ooling
+    Matrix kernel;
+    ConvolutionParameters params;
+    int pooling;
+    int stride;
+};
+
+TiledExecutor tiledChain(const std::vector<ChainStage> &chain, int tileSize)
+{
+    TiledExecutor result(tileSize, tileSize);
+    for (const auto &stage : chain)
+    {
+        if (stage.type == 'c')
+            result.convolution(stage.kernel, stage.params);
+        else if (stage.type == 'r')
+            result.relu();
+        else
+            result.maxPooling(stage.pooling, stage.stride);
+    }
+    return result;
+}
+
+Matrix wholeImageChain(const std::vector<ChainStage> &chain, Matrix image)
+{
+    for (const auto &stage : chain)
+    {
+        if (stage.type == 'c')
+            image = convolution(image, stage.kernel, stage.params);
+        else if (stage.type == 'r')
+            image = image.cwiseMax(0.0);
+        else
+            image = slidingMaxPooling(image, stage.pooling, stage.stride).output;
+    }
+    return image;
+}
+
+/**
+* Tiled conv/ReLU/pool chains against the passes over the whole image, by tile size: the error shows the stitching
+* (0 as the tiles compute the same sums), the halo the extra input read, and the buffers of a worker the memory
+* against the whole image passes. Then a gigapixel sized image, the example image repeated, is streamed through the
+* first chain without ever being built, with a checksum of the output.
+*/
+void benchmarkTiling(const Matrix &image)
+{
+    const Matrix kernel3 = Matrix::Random(3, 3);
+    const Matrix kernel5 = Matrix::Random(5, 5);
+    const std::vector<std::pair<std::string, std::vector<ChainStage>>> chains = {
+        {"same 3x3 relu pool 2 x2", {{'c', kernel3, ConvolutionParameters(1), 0, 0}, {'r', Matrix(), ConvolutionParameters(), 0, 0}, {'p', Matrix(), ConvolutionParameters(), 2, 2},
+                                     {'c', kernel3, ConvolutionParameters(1), 0, 0}, {'r', Matrix(), ConvolutionParameters(), 0, 0}, {'p', Matrix(), ConvolutionParameters(), 2, 2}}},
+        {"5x5 s2 d1 relu pool 3/2", {{'c', kernel5, ConvolutionParameters(2, 2, 1), 0, 0}, {'r', Matrix(), ConvolutionParameters(), 0, 0}, {'p', Matrix(), ConvolutionParameters(), 3, 2}}},
+        {"3x3 pool 3/1 3x3", {{'c', kernel3, ConvolutionParameters(), 0, 0}, {'p', Matrix(), ConvolutionParameters(), 3, 1}, {'c', kernel3, ConvolutionParameters(1), 0, 0}}}};
+
+    std::cout << "\n" << std::setw(24) << "chain" << std::setw(8) << "tile" << std::setw(8) << "tiles" << std::setw(10) << "halo %";
+    std::cout << std::setw(14) << "buffers KB" << std::setw(12) << "whole KB" << std::setw(12) << "tiled ms" << std::setw(12) << "whole ms" << std::setw(12) << "max error" << "\n";
+    for (const auto &chain : chains)
+    {
+        Matrix expected;
+        double wholeTime = benchmark([&]() { expected = wholeImageChain(chain.second, image); }, 5);
+        // the whole image passes hold an input and an output at a time, at most
+        long wholeBytes = 0;
+        Matrix stage = image;
+        for (const auto &s : chain.second)
+        {
+            Matrix next = wholeImageChain({s}, stage);
+            wholeBytes = std::max<long>(wholeBytes, (stage.size() + next.size()) * sizeof(double));
+            stage = next;
+        }
+        for (int tileSize : {37, 128, 512})
+        {
+            const TiledExecutor executor = tiledChain(chain.second, tileSize);
+            TilingStatistics statistics;
+            Matrix actual;
+            double tiledTime = benchmark([&]() { actual = executor.run(image, &statistics); }, 5);
+            std::cout << std::setw(24) << chain.first << std::setw(8) << tileSize << std::setw(8) << statistics.tiles;
+            std::cout << std::fixed << std::setprecision(1) << std::setw(10) << 100.0 * (static_cast<double>(statistics.inputPixels) / image.size() - 1.0);
+            std::cout << std::setw(14) << statistics.bufferBytes / 1024.0 << std::setw(12) << wholeBytes / 1024.0;
+            std::cout << std::setprecision(3) << std::setw(12) << tiledTime << std::setw(12) << wholeTime;
+            std::cout << std::scientific << std::setprecision(2) << std::setw(12) << maxError({expected}, {actual}) << std::defaultfloat << "\n";
+        }
+    }
+
+    const long rows = 16384, cols = 16384;
+    const TiledExecutor executor = tiledChain(chains.front().second, 256);
+    const std::pair<long, long> size = executor.outputSize(rows, cols);
+    std::mutex mutex;
+    double checksum = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    TilingStatistics statistics = executor.run(
+        rows, cols,
+        [&](long row, long col, Eigen::Ref<Matrix> block) {
+            for (long j = 0; j < block.cols(); ++j)
+                for (long i = 0; i < block.rows(); ++i)
+                    block(i, j) = image((row + i) % image.rows(), (col + j) % image.cols());
+        },
+        [&](long, long, const Matrix &tile) {
+            const double sum = tile.sum();
+            std::lock_guard<std::mutex> lock(mutex);
+            checksum += sum;
+        });
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "\nStreamed " << rows << "x" << cols << " -> " << size.first << "x" << size.second << " (" << chains.front().first << ") in ";
+    std::cout << std::fixed << std::setprecision(2) << seconds << " s, " << std::setprecision(1) << rows * cols / seconds / 1e6 << " Mpixels/s, ";
+    std::cout << statistics.tiles << " tiles on " << statistics.workers << " workers, " << statistics.workers * statistics.bufferBytes / 1048576.0;
+    std::cout << " MB of tile buffers instead of " << (rows * cols + (rows * cols) / 4) * sizeof(double) / 1048576.0 << " MB, checksum ";
+    std::cout << std::scientific << std::setprecision(6) << checksum << std::defaultfloat << "\n";
+}
+
+/**
+* Low rank filters as two 1D passes. The last case is a "trained" kernel: a binomial filter plus noise, which is
+* full rank, run exactly and with its rank 1 approximation (separate with a loose tolerance), as done at inference.
+*/
+void benchmarkSeparable(const Matrix &image)
+{
+    Matrix sobel(3, 3);
+    sobel << -1, 0, 1, -2, 0, 2, -1, 0, 1;
+    Vector binomial(5);
+    binomial << 1, 4, 6, 4, 1;
+    Matrix gaussian = binomial * binomial.transpose() / 256.0;
+    Matrix box = Matrix::Ones(11, 11) / 121.0;
+    Matrix trained = gaussian + 1e-3 * Matrix::Random(5, 5);
+
+    std::cout << "\n" << std::setw(10) << "filter" << std::setw(8) << "rank" << std::setw(12) << "direct ms" << std::setw(14) << "separable ms";
+    std::cout << std::setw(22) << "automatic" << std::setw(14) << "max error" << "\n";
+    auto run = [&image](const std::string &name, const Matrix &kernel, const SeparableKernel &separated) {
+        ConvolutionParameters params(kernel.rows() / 2);
+        Matrix expected, actual;
+        double directTime = benchmark([&]() { expected = convolution(image, kernel, params, ConvolutionAlgorithm::Direct); }, 10);
+        double separableTime = benchmark([&]() { actual = separableConvolution(image, separated, params); }, 10);
+        auto automatic = selectAlgorithm(image, {kernel}, params);
+        std::cout << std::setw(10) << name << std::setw(8) << separated.rank() << std::fixed << std::setprecision(2) << std::setw(12) << directTime;
+        std::cout << std::setw(14) << separableTime << std::setw(22) << algorithmName(automatic);
+        std::cout << std::scientific << std::setprecision(2) << std::setw(14) << maxError({expected}, {actual}) << std::defaultfloat << "\n";
+    };
+    run("sobel", sobel, separate(sobel));
+    run("binomial", gaussian, separate(gaussian));
+    run("box", box, separate(box));
+    run("trained", trained, separate(trained));
+    run("trained~1", trained, separate(trained, 1e-2));
+}
+
+int main(int, char **)
+{
+    std::cout << "Worker threads: " << numberOfWorkers() << "\n";
+    if (!checkCorrectness())
+        return 1;
+    benchmarkSizes();
+    winogradErrorBounds();
+
+    const char *imagepath = "../data/convolution_example.png";
+    cv::Mat image = cv::imread(imagepath, cv::IMREAD_GRAYSCALE);
+    if (image.empty())
+    {
+        std::cout << "\nCould not read " << imagepath << ", skipping the image benchmark\n";
+        return 0;
+    }
+    Matrix X;
+    cv::cv2eigen(image, X);
+    benchmarkImage(X);
+    benchmarkDirect(X, peakGflops());
+    benchmarkLargeKernels(X);
+    benchmarkSeparable(X);
+    benchmarkFused(X);
+    benchmarkSlidingPooling(X);
+    benchmarkTiling(X);
+    benchmarkDilation(X);
+    benchmarkBorders(X);
+    benchmarkKernelFitting(X);
+    benchmarkPatchTraining(X);
+    return 0;
+}
@@ -0,0 +1,175 @@
+#ifndef SEPARABLE_CONVOLUTION_H_
+#define SEPARABLE_CONVOLUTION_H_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "convolution_parameters.hpp"
+#include "parallel.hpp"
+
+namespace ann
+{
+
+// residual entries below this fraction of the kernel norm are considered zero
+const double separableTolerance = 1e-10;
+
+/**
+* Kernel written as a sum of outer products: kernel = sum_i columns[i] * rows[i]^T.
+*/
+struct SeparableKernel
+{
+    std::vector<Vector> columns;
+    std::vector<Vector> rows;
+
+    int rank() const
+    {
+        return columns.size();
+    }
+
+    /**
+    * Multiply-adds per output pixel of the two 1D passes.
+    */
+    long cost() const
+    {
+        return rank() > 0 ? rank() * (columns.front().size() + rows.front().size()) : 0;
+    }
+
+    Matrix toMatrix() const
+    {
+        Matrix result = Matrix::Zero(columns.front().size(), rows.front().size());
+        for (int i = 0; i < rank(); ++i)
+            result += columns[i] * rows[i].transpose();
+        return result;
+    }
+};
+
+/**
+* Splits the kernel by Gaussian elimination with full pivoting: each term is the column times the row through the
+* largest remaining entry, divided by it, and is subtracted before the next one. Every residual entry is then a 2x2
+* minor over the pivot, so one term tells whether the kernel is rank 1 and a low rank filter (Sobel, box, binomial)
+* is exact after rank terms, with no SVD. Terms stop when the residual is below tolerance * the kernel norm, or
+* after maxRank terms; a looser tolerance gives a low rank approximation of a trained kernel for inference.
+*/
+inline SeparableKernel separate(const Matrix &kernel, double tolerance = separableTolerance, int maxRank = -1)
+{
+    const int fullRank = std::min(kernel.rows(), kernel.cols());
+    const int limit = maxRank > 0 ? std::min(maxRank, fullRank) : fullRank;
+    const double threshold = tolerance * kernel.norm();
+    Matrix residual = kernel;
+    SeparableKernel result;
+    while (result.rank() < limit)
+    {
+        Eigen::Index pivotRow, pivotCol;
+        const double largest = residual.cwiseAbs().maxCoeff(&pivotRow, &pivotCol);
+        if (largest <= threshold || largest == 0.0)
+            break;
+        const double pivot = residual(pivotRow, pivotCol);
+        const double scale = std::sqrt(largest);
+        Vector column = residual.col(pivotCol) * (pivot > 0.0 ? 1.0 / scale : -1.0 / scale);
+        Vector row = residual.row(pivotRow).transpose() / scale;
+        residual -= column * row.transpose();
+        result.columns.push_back(std::move(column));
+        result.rows.push_back(std::move(row));
+    }
+    if (result.rank() == 0)
+    {
+        result.columns.push_back(Vector::Zero(kernel.rows()));
+        result.rows.push_back(Vector::Zero(kernel.cols()));
+    }
+    return result;
+}
+
+/**
+* True when every kernel has a rank low enough for its two pass cost to beat the 2D kernel. The elimination stops
+* one term past that rank, so a full rank 3x3 kernel costs two rank 1 updates and the check fits the hot path.
+*/
+inline bool isWorthSeparating(const std::vector<Matrix> &kernels)
+{
+    for (const auto &kernel : kernels)
+    {
+        const long worthRank = (kernel.size() - 1) / (kernel.rows() + kernel.cols());
+        if (worthRank < 1)
+            return false;
+        if (separate(kernel, separableTolerance, worthRank + 1).rank() > worthRank)
+            return false;
+    }
+    return true;
+}
+
+/**
+* Convolution with a separated kernel: for each rank 1 term, a vertical pass with the column vector followed by
+* a horizontal pass with the row vector. Both passes are column axpys, so they vectorize along the
+* contiguous column-major storage. Cost per pixel goes from rows x cols to rank x (rows + cols).
+*/
+inline Matrix separableConvolution(const Matrix &input, const SeparableKernel &kernel, const ConvolutionParameters &params = ConvolutionParameters())
+{
+    const int kernelRows = kernel.columns.front().size();
+    const int kernelCols = kernel.rows.front().size();
+    params.validate(input.rows(), input.cols(), kernelRows, kernelCols);
+
+    Matrix padded;
+    if (params.hasPadding())
+    {
+        padded = Matrix::Zero(input.rows() + 2 * params.rowPadding, input.cols() + 2 * params.colPadding);
+        padded.block(params.rowPadding, params.colPadding, input.rows(), input.cols()) = input;
+    }
+    const Matrix &source = params.hasPadding() ? padded : input;
+
+    const int step = params.dilation + 1;
+    const int outputRows = params.outputRows(input.rows(), kernelRows);
+    const int outputCols = params.outputCols(input.cols(), kernelCols);
+    Matrix vertical(outputRows, source.cols());
+    Matrix result = Matrix::Zero(outputRows, outputCols);
+
+    using StridedMap = Eigen::Map<const Vector, 0, Eigen::InnerStride<>>;
+    for (int term = 0; term < kernel.rank(); ++term)
+    {
+        const Vector &column = kernel.columns[term];
+        const Vector &row = kernel.rows[term];
+
+        // one column at a time, so the kh (kw) terms accumulate in L1 instead of streaming the whole image per term
+        parallelFor(0, source.cols(), [&](long begin, long end) {
+            for (long j = begin; j < end; ++j)
+            {
+                auto out = vertical.col(j);
+                const double *src = source.col(j).data();
+                if (params.rowStride == 1)
+                {
+                    out = column(0) * Eigen::Map<const Vector>(src, outputRows);
+                    for (int a = 1; a < kernelRows; ++a)
+                        out += column(a) * Eigen::Map<const Vector>(src + a * step, outputRows);
+                }
+                else
+                {
+                    out = column(0) * StridedMap(src, outputRows, Eigen::InnerStride<>(params.rowStride));
+                    for (int a = 1; a < kernelRows; ++a)
+                        out += column(a) * StridedMap(src + a * step, outputRows, Eigen::InnerStride<>(params.rowStride));
+                }
+            }
+        });
+
+        parallelFor(0, outputCols, [&](long begin, long end) {
+            for (long j = begin; j < end; ++j)
+            {
+                auto out = result.col(j);
+                for (int b = 0; b < kernelCols; ++b)
+                    out += row(b) * vertical.col(j * params.colStride + b * step);
+            }
+        });
+    }
+    return result;
+}
+
+inline std::vector<Matrix> separableConvolution(const Matrix &input, const std::vector<Matrix> &kernels, const ConvolutionParameters &params = ConvolutionParameters())
+{
+    std::vector<Matrix> result;
+    result.reserve(kernels.size());
+    for (const auto &kernel : kernels)
+        result.push_back(separableConvolution(input, separate(kernel), params));
+    return result;
+}
+
+} // namespace ann
+
+#endif
@@ -5,13 +5,19 @@
 #include <algorithm>
 
 #include "matrix_definitions.hpp"
+#include "convolution.hpp"
+#include "patch_trainer.hpp"
+#include "training_monitor.hpp"
 
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/core/eigen.hpp>
 
-void show(const cv::Mat &source, const cv::Mat &groundTruth, const cv::Mat &convoluted)
+/**
+* Source, ground truth and current output side by side
+*/
+cv::Mat snapshot(const cv::Mat &source, const cv::Mat &groundTruth, const cv::Mat &convoluted)
 {
     int maxHeight = std::max(std::max(source.rows, groundTruth.rows), convoluted.rows);
     int width = source.cols + groundTruth.cols + convoluted.cols;
@@ -22,82 +28,50 @@ void show(const cv::Mat &source, const cv::Mat &groundTruth, const cv::Mat &conv
     groundTruth.copyTo(groundTruth_roi);
     cv::Mat convoluted_roi = toShow(cv::Rect(source.cols + groundTruth.cols, 0, convoluted.cols, convoluted.rows));
     convoluted.copyTo(convoluted_roi);
-    cv::namedWindow("", cv::WindowFlags::WINDOW_AUTOSIZE);
-    cv::imshow("", toShow);
+    return toShow;
 } 
 
-Matrix maxPooling(const Matrix & input, const int pooling, int strides)
+Matrix convolution(const Matrix & input, const Matrix & filter)
 {
-    int rows = (input.rows() - pooling) / strides + 1;
-    int cols = (input.cols() - pooling) / strides + 1;
-    Matrix result = Matrix::Zero(rows, cols);
-    for(int i = 0; i < rows; i = i + 1)
-    {
-        for(int j = 0; j < cols; j = j + 1)
-        {
-            double maxValue = input.block(strides*i, strides*j, pooling, pooling).maxCoeff();
-            result(i, j) = maxValue;
-        }
-    }
-    return result;
+    return ann::convolution(input, filter);
 }
 
-Matrix gradientPooling(const Matrix &dC, const Matrix &convoluted, const int pooling, int strides)
+void toImage(const Matrix &matrix, cv::Mat &dest)
 {
-    int rows = (convoluted.rows() - pooling) / strides + 1;
-    int cols = (convoluted.cols() - pooling) / strides + 1;
-    Matrix result = Matrix::Zero(convoluted.rows(), convoluted.cols());
-    for(int i = 0; i < rows; i = i + 1)
-    {
-        for(int j = 0; j < cols; j = j + 1)
-        {
-            Matrix::Index maxRow, maxCol;
-            convoluted.block(strides*i, strides*j, pooling, pooling).maxCoeff(&maxRow, &maxCol);
-            result(strides*i + maxRow, strides*j + maxCol) = result(strides*i + maxRow, strides*j + maxCol) + dC(i, j);
-        }
-    }
-    return result;
-}
-
-Matrix convolution(const Matrix & input, const Matrix & filter)
-{
-    int filterRows = filter.rows();
-    int filterCols = filter.cols();
-    int rows = input.rows() - filterRows + 1;
-    int cols = input.cols() - filterCols + 1;
-    Matrix result = Matrix::Zero(rows, cols);
-    for(int i = 0; i < rows; ++i)
-    {
-        for(int j = 0; j < cols; ++j)
-        {
-            double sum = input.block(i, j, filterRows, filterCols).cwiseProduct(filter).sum();
-            result(i, j) = sum;
-        }
-    }
-    return result;
+    cv::Mat temp;
+    cv::eigen2cv(matrix, temp);
+    temp.convertTo(dest, CV_8UC1);
 }
 
 Matrix imageConvolution(const Matrix &input, cv::Mat &dest, const Matrix & filter)
 {
     Matrix convoluted = convolution(input, filter);
-    cv::Mat temp;
-    cv::eigen2cv(convoluted, temp);
-    temp.convertTo(dest, CV_8UC1);
+    toImage(convoluted, dest);
     return convoluted;
 }
 
-std::tuple<Matrix, Matrix> imageConvolution(const Matrix &input, cv::Mat &dest, const Matrix & filter, const int poolingSize, const int poolingStrider)
+/**
+* Convolution and max pooling in one fused pass, the switches of the result locate the maxima for the backward pass
+*/
+ann::PooledConvolution imageConvolution(const Matrix &input, cv::Mat &dest, const Matrix & filter, const int poolingSize, const int poolingStrider)
 {
-    const Matrix convoluted = convolution(input, filter);
-    const Matrix maxPoolingMatrix = maxPooling(convoluted, poolingSize, poolingStrider);
-    cv::Mat temp;
-    cv::eigen2cv(maxPoolingMatrix, temp);
-    temp.convertTo(dest, CV_8UC1);
-    return std::make_tuple(convoluted, maxPoolingMatrix);
+    ann::PooledConvolution pooled = ann::maxPoolingConvolution(input, filter, poolingSize, poolingStrider);
+    toImage(pooled.output, dest);
+    return pooled;
 }
 
-int main(int, char **)
+int main(int argc, char **argv)
 {
+    ann::TrainingOptions options;
+    try
+    {
+        options = ann::TrainingOptions::parse(argc, argv);
+    }
+    catch (std::invalid_argument const &e)
+    {
+        std::cerr << e.what() << "\n";
+        return -1;
+    }
     srand(0);
     const char * imagepath = "../data/convolution_example.png";
     cv::Mat image = cv::imread(imagepath, cv::IMREAD_GRAYSCALE);
@@ -107,26 +81,36 @@ int main(int, char **)
         -1, 0, 1, 
         -1, 0, 1, 
         -1, 0, 1;
-    double learningRate = 0.00000000001;
     Matrix X;
     cv::cv2eigen(image, X);
     const int poolingSize = 2;
     const int poolingStrider = 1;
-    const auto [stdIgnore, groundTruthMatrix] = imageConvolution(X, groundTruthImage, groundTruthFilter, poolingSize, poolingStrider);
+    const Matrix groundTruthMatrix = imageConvolution(X, groundTruthImage, groundTruthFilter, poolingSize, poolingStrider).output;
     Matrix K = 0.05 * Matrix::Random(3, 3);
-    int key = 0;
+    // X never changes: lowered once, every epoch only reads the patches of the window maxima
+    const ann::PatchMatrix patches(X, K.rows(), K.cols());
+    // the pooled outputs are not a convolution of patches, so the gradient stays on the whole image, but averaged over
+    // the outputs and applied by Adam: a step in kernel units, whatever the size and the scale of the image
+    const double learningRate = 0.01;
+    ann::KernelOptimizer optimizer = ann::adamOptimizer();
+    ann::TrainingMonitor monitor(options);
     int epoch = 0;
-    while(key != 27)
+    bool stop = false;
+    while(!stop)
     {
-        auto [convoluted, output] = imageConvolution(X, outputImage, K, poolingSize, poolingStrider);
-        Matrix dC = output - groundTruthMatrix;
+        const ann::PooledConvolution pooled = ann::maxPoolingConvolution(X, K, poolingSize, poolingStrider);
+        Matrix dC = pooled.output - groundTruthMatrix;
         double mse = dC.cwiseProduct(dC).sum() / (dC.rows() * dC.cols()); 
         std::cout << "Epoch:\t" << epoch << "\tMSE:\t" << mse << "\n";
-        Matrix dZ = gradientPooling(dC, convoluted, poolingSize, poolingStrider);
-        Matrix dK = convolution(X, dZ);
-        K = K - learningRate * dK;  
-        show(image, groundTruthImage, outputImage);
-        key = cv::waitKey(10);
+        Matrix dK = patches.kernelGradient(dC, pooled) / static_cast<double>(dC.size());
+        K += optimizer(learningRate, dK, epoch);
+        // the output image is only converted when the visualizer is ready for a new frame
+        if (monitor.frameDue())
+        {
+            toImage(pooled.output, outputImage);
+            monitor.push(snapshot(image, groundTruthImage, outputImage), epoch);
+        }
+        stop = monitor.shouldStop(epoch, mse);
         epoch++;
     }
     std::cout << "K = \n" << K << "\n\n";
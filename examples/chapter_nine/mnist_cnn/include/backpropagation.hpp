@@ -0,0 +1,176 @@
+#ifndef BACKPROPAGATION_H_
+#define BACKPROPAGATION_H_
+
+#include <iostream>
+
+#include "dataset.hpp"
+#include "mlp_core.hpp"
+
+namespace ann
+{
+std::random_device rd;
+std::mt19937 prn(rd());
+std::uniform_real_distribution<> uniformRand(0.0, 1.0);
+
+/**
+* Minibatch backpropagation over any stack of NetworkLayer: every layer computes its own parameter gradients
+* and the gradient of its input, so dense, convolutional and pooling layers are trained by the same loop.
+*/
+template <typename COST_FUNCTION>
+class Backpropagation
+{
+
+  private:
+    MultilayerPerceptron &net;
+    Dataset &trainingDataset;
+    double learningRate;
+    int maxEpochs;
+    int batchsize;
+
+    std::function<Matrix(double learningRate, const Matrix &, int layerIndex, int epoch)> weightOptmizer;
+    std::function<Matrix(double learningRate, const Matrix &, int layerIndex, int epoch)> biasOptmizer;
+
+    COST_FUNCTION costFunction;
+
+  public:
+    Backpropagation(MultilayerPerceptron &net, Dataset &trainingDataset, double learningRate, int maxEpochs, int batchsize = -1) :
+        net(net), trainingDataset(trainingDataset), learningRate(learningRate), maxEpochs(maxEpochs),
+        batchsize(batchsize) {
+            weightOptmizer = [](double learningRate, const Matrix & dW, int, int) {
+                return - learningRate * dW;
+            };
+            biasOptmizer = [](double learningRate, const Matrix & dB, int, int) {
+                return - learningRate * dB;
+            };
+            if(this->batchsize < 1)
+                this->batchsize = trainingDataset.size();
+        }
+    virtual ~Backpropagation() {}
+
+    void hookOptimizer(std::function<Matrix(double learningRate, const Matrix & dW, int layerIndex, int epoch)> fnc)
+    {
+        this->weightOptmizer = fnc;
+        this->biasOptmizer = fnc;
+    }
+
+    /**
+    * Separate optimizers for weights and biases, for optimizers keeping a state per parameter (momentum, Adam).
+    */
+    void hookOptimizer(std::function<Matrix(double learningRate, const Matrix & dW, int layerIndex, int epoch)> weightFnc,
+        std::function<Matrix(double learningRate, const Matrix & dB, int layerIndex, int epoch)> biasFnc)
+    {
+        this->weightOptmizer = weightFnc;
+        this->biasOptmizer = biasFnc;
+    }
+
+    /**
+    * Returns the input, the z and the dropout mask of every layer and the output of the network.
+    */
+    std::tuple<std::vector<Matrix>, std::vector<Matrix>, std::vector<Matrix>, Matrix> forward(const Matrix &x)
+    {
+        auto &layers = net.getLayers();
+        std::vector<Matrix> xPerLayer, zPerLayer, maskPerLayer;
+        xPerLayer.reserve(layers.size());
+        zPerLayer.reserve(layers.size());
+        maskPerLayer.reserve(layers.size());
+
+        Matrix input = x;
+        std::for_each(layers.begin(), layers.end(), [&](const std::unique_ptr<NetworkLayer> &layer) {
+
+            auto [z, y] = layer->output(input);
+            double keepProb = layer->getDropoutFactor();
+            Matrix dropoutMask;
+            if(keepProb < 1.0) {
+                dropoutMask = y.unaryExpr([&keepProb](double){
+                    double rand = uniformRand(prn);
+                    return (rand <= keepProb)?1.0:0.0;
+                });
+                y = y.cwiseProduct(dropoutMask);
+            }
+            xPerLayer.push_back(std::move(input));
+            zPerLayer.push_back(std::move(z));
+            maskPerLayer.push_back(std::move(dropoutMask));
+            input = std::move(y);
+        });
+
+        return std::make_tuple(xPerLayer, zPerLayer, maskPerLayer, input);
+    }
+
+    std::tuple<std::vector<Matrix>, std::vector<Matrix>>
+    backward(const std::vector<Matrix> &xPerLayer, const std::vector<Matrix> &zPerLayer, const std::vector<Matrix> &maskPerLayer, const Matrix &y, const Matrix &expected) {
+        return backpropagate(xPerLayer, zPerLayer, maskPerLayer, costFunction.derivative(expected, y));
+    }
+
+    std::tuple<std::vector<Matrix>, std::vector<Matrix>>
+    backward(const std::vector<Matrix> &xPerLayer, const std::vector<Matrix> &zPerLayer, const std::vector<Matrix> &maskPerLayer, const Matrix &y, const LabelVector &labels) {
+        return backpropagate(xPerLayer, zPerLayer, maskPerLayer, costFunction.derivative(labels, y));
+    }
+
+    std::tuple<std::vector<Matrix>, std::vector<Matrix>>
+    backpropagate(const std::vector<Matrix> &xPerLayer, const std::vector<Matrix> &zPerLayer, const std::vector<Matrix> &maskPerLayer, Matrix dC) {
+        auto &layers = net.getLayers();
+        std::vector<Matrix> dWperLayer(layers.size()), dBperLayer(layers.size());
+
+        for(int layerIndex = layers.size() - 1; layerIndex >= 0; --layerIndex) {
+            const NetworkLayer &layer = *layers[layerIndex];
+            if(maskPerLayer[layerIndex].size() > 0)
+                dC = dC.cwiseProduct(maskPerLayer[layerIndex]);
+            dC = layer.backward(xPerLayer[layerIndex], zPerLayer[layerIndex], dC, dWperLayer[layerIndex], dBperLayer[layerIndex], layerIndex > 0);
+        }
+        return std::make_tuple(dWperLayer, dBperLayer);
+    }
+
+    void update(const std::vector<Matrix> &dWperLayer, const std::vector<Matrix> &dBperLayer, int epoch)
+    {
+        auto &layers = net.getLayers();
+        for(size_t layerIndex = 0; layerIndex < layers.size(); ++layerIndex) {
+            const NetworkLayer &layer = *layers[layerIndex];
+            if(!layer.isTrainable())
+                continue;
+            auto &weight = layer.getWeightMatrix();
+            auto &bias = layer.getBiases();
+
+            weight += weightOptmizer(learningRate, dWperLayer[layerIndex], layerIndex, epoch);
+            bias += biasOptmizer(learningRate, dBperLayer[layerIndex], layerIndex, epoch);
+        }
+    }
+
+    /**
+    * Trains for maxEpochs epochs of shuffled minibatches and returns the training cost of every epoch,
+    * averaged over its minibatches (no extra pass over the dataset).
+    */
+    Vector train()
+    {
+        Vector result = Vector::Zero(maxEpochs);
+        int epoch = 0;
+        while (epoch++ < maxEpochs)
+        {
+            int datasetSize = trainingDataset.size();
+            if(this->batchsize < datasetSize)
+                ann::shuffledataset(trainingDataset, prn);
+            double epochCost = 0;
+            for(int index = 0; index < datasetSize; index += this->batchsize)
+            {
+                int end = std::min(index + this->batchsize, datasetSize);
+                auto minibatch = trainingDataset.slice(index, end);
+
+                auto [x, z, masks, y] = forward(minibatch.X);
+                if(minibatch.hasLabels()) {
+                    epochCost += costFunction(minibatch.labels, y) * minibatch.size();
+                    auto [dW, dB] = backward(x, z, masks, y, minibatch.labels);
+                    update(dW, dB, epoch);
+                } else {
+                    epochCost += costFunction(minibatch.T, y) * minibatch.size();
+                    auto [dW, dB] = backward(x, z, masks, y, minibatch.T);
+                    update(dW, dB, epoch);
+                }
+            }
+            result(epoch - 1) = epochCost / datasetSize;
+            std::cout << epoch << "\t" << result(epoch - 1) << "\n";
+        }
+        return result;
+    }
+};
+
+} //namespace ann
+#endif
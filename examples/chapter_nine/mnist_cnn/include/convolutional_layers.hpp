@@ -0,0 +1,274 @@
+#ifndef CONVOLUTIONAL_LAYERS_H_
+#define CONVOLUTIONAL_LAYERS_H_
+
+#include "mlp_core.hpp"
+#include "multichannel_convolution.hpp"
+
+namespace ann
+{
+
+/**
+* Shape of the HWC images flowing between the convolutional layers.
+*/
+struct ImageShape
+{
+  int rows;
+  int cols;
+  int channels;
+
+  int size() const
+  {
+    return rows * cols * channels;
+  }
+};
+
+/**
+* Valid convolution with a bank of filters, a bias per output channel and an element-wise activation
+* (ReLU, logistic, tanh). The filters are stored in the weight matrix as one column per output channel,
+* each column being a (kernelRows, kernelCols, input channels) HWC kernel: the same memory as the
+* (C_out, kernelRows, kernelCols, C_in) filter bank of multichannel_convolution.hpp, so the optimizers
+* see an ordinary matrix. The whole batch goes through the NHWC convolution engine without any copy.
+*/
+class Conv2DLayer : public NetworkLayer
+{
+
+private:
+  std::unique_ptr<ActivationFunction> activationFunction;
+  ImageShape inputShape;
+  int kernelRows;
+  int kernelCols;
+
+  Tensor4d filterBank() const;
+
+public:
+  Conv2DLayer(ImageShape inputShape, std::unique_ptr<ActivationFunction> activationFunction, const Tensor4d &initialFilters, Vector initialBiases);
+  virtual ~Conv2DLayer() {}
+  Conv2DLayer(Conv2DLayer const &o) :
+      NetworkLayer(o.weights, o.biases), activationFunction(o.activationFunction->clone()), inputShape(o.inputShape), kernelRows(o.kernelRows), kernelCols(o.kernelCols) {}
+
+  virtual std::unique_ptr<NetworkLayer> clone() const
+  {
+    return std::unique_ptr<NetworkLayer>(new Conv2DLayer(*this));
+  }
+
+  virtual std::tuple<Matrix, Matrix> output(const Matrix &input) const;
+  virtual Matrix backward(const Matrix &input, const Matrix &z, const Matrix &dY, Matrix &dW, Matrix &dB, bool propagate = true) const;
+
+  ImageShape getOutputShape() const
+  {
+    return {inputShape.rows - kernelRows + 1, inputShape.cols - kernelCols + 1, static_cast<int>(this->weights.cols())};
+  }
+  virtual int getNumberOfNeurons() const
+  {
+    return getOutputShape().size();
+  }
+  virtual int getNumberOfInputNeurons() const
+  {
+    return inputShape.size();
+  }
+};
+
+/**
+* Depthwise-separable convolution: a valid depthwise convolution, one kernelRows x kernelCols kernel per input channel,
+* then a 1x1 pointwise convolution to C_out channels with a bias per output channel and an element-wise activation.
+* Per output pixel it costs kernelRows * kernelCols * C_in + C_in * C_out products where a Conv2DLayer with the same
+* shapes costs kernelRows * kernelCols * C_in * C_out. The weight matrix is C_in x (kernelRows * kernelCols + C_out):
+* the first columns are the depthwise kernels, one column per tap like the (kernelRows, kernelCols, C_in) tensor, the
+* last ones the transposed pointwise weights, so the optimizers see an ordinary matrix. z is the output before the
+* activation; backward recomputes the depthwise output, cheaper than keeping it.
+*/
+class DepthwiseSeparableConv2DLayer : public NetworkLayer
+{
+
+private:
+  std::unique_ptr<ActivationFunction> activationFunction;
+  ImageShape inputShape;
+  int kernelRows;
+  int kernelCols;
+
+  Tensor3d depthwiseKernels() const;
+  Matrix depthwiseOutput(const Matrix &input) const;
+
+public:
+  DepthwiseSeparableConv2DLayer(ImageShape inputShape, std::unique_ptr<ActivationFunction> activationFunction, const Tensor3d &initialKernels, const Matrix &initialPointwise, Vector initialBiases);
+  virtual ~DepthwiseSeparableConv2DLayer() {}
+  DepthwiseSeparableConv2DLayer(DepthwiseSeparableConv2DLayer const &o) :
+      NetworkLayer(o.weights, o.biases), activationFunction(o.activationFunction->clone()), inputShape(o.inputShape), kernelRows(o.kernelRows), kernelCols(o.kernelCols) {}
+
+  virtual std::unique_ptr<NetworkLayer> clone() const
+  {
+    return std::unique_ptr<NetworkLayer>(new DepthwiseSeparableConv2DLayer(*this));
+  }
+
+  virtual std::tuple<Matrix, Matrix> output(const Matrix &input) const;
+  virtual Matrix backward(const Matrix &input, const Matrix &z, const Matrix &dY, Matrix &dW, Matrix &dB, bool propagate = true) const;
+
+  ImageShape getOutputShape() const
+  {
+    return {inputShape.rows - kernelRows + 1, inputShape.cols - kernelCols + 1, static_cast<int>(this->biases.size())};
+  }
+  virtual int getNumberOfNeurons() const
+  {
+    return getOutputShape().size();
+  }
+  virtual int getNumberOfInputNeurons() const
+  {
+    return inputShape.size();
+  }
+};
+
+/**
+* Max pooling of every channel over pooling x pooling windows moved by stride pixels.
+* z holds the index in the input column of the maximum of every output, backward scatters the gradient there.
+*/
+class MaxPoolLayer : public NetworkLayer
+{
+
+private:
+  ImageShape inputShape;
+  int pooling;
+  int stride;
+
+public:
+  MaxPoolLayer(ImageShape inputShape, int pooling, int stride);
+  virtual ~MaxPoolLayer() {}
+
+  virtual std::unique_ptr<NetworkLayer> clone() const
+  {
+    return std::unique_ptr<NetworkLayer>(new MaxPoolLayer(*this));
+  }
+
+  virtual std::tuple<Matrix, Matrix> output(const Matrix &input) const;
+  virtual Matrix backward(const Matrix &input, const Matrix &z, const Matrix &dY, Matrix &dW, Matrix &dB, bool propagate = true) const;
+
+  ImageShape getOutputShape() const
+  {
+    return {(inputShape.rows - pooling) / stride + 1, (inputShape.cols - pooling) / stride + 1, inputShape.channels};
+  }
+  virtual int getNumberOfNeurons() const
+  {
+    return getOutputShape().size();
+  }
+  virtual int getNumberOfInputNeurons() const
+  {
+    return inputShape.size();
+  }
+};
+
+/**
+* Average pooling of every channel over pooling x pooling windows moved by stride pixels. The forward pass builds the
+* summed-area table of every image, so any window is four lookups; the backward pass spreads dY / pooling^2 with the
+* four corners of every window in a table of differences and integrates it, the same four operations per output.
+* Nothing is kept for backward: z is empty.
+*/
+class AvgPoolLayer : public NetworkLayer
+{
+
+private:
+  ImageShape inputShape;
+  int pooling;
+  int stride;
+
+public:
+  AvgPoolLayer(ImageShape inputShape, int pooling, int stride);
+  virtual ~AvgPoolLayer() {}
+
+  virtual std::unique_ptr<NetworkLayer> clone() const
+  {
+    return std::unique_ptr<NetworkLayer>(new AvgPoolLayer(*this));
+  }
+
+  virtual std::tuple<Matrix, Matrix> output(const Matrix &input) const;
+  virtual Matrix backward(const Matrix &input, const Matrix &z, const Matrix &dY, Matrix &dW, Matrix &dB, bool propagate = true) const;
+
+  ImageShape getOutputShape() const
+  {
+    return {(inputShape.rows - pooling) / stride + 1, (inputShape.cols - pooling) / stride + 1, inputShape.channels};
+  }
+  virtual int getNumberOfNeurons() const
+  {
+    return getOutputShape().size();
+  }
+  virtual int getNumberOfInputNeurons() const
+  {
+    return inputShape.size();
+  }
+};
+
+/**
+* Mean of every channel over the whole image, a 1x1 image with the channels of the input. The backward pass gives
+* every pixel dY / (rows * cols) of its channel.
+*/
+class GlobalAvgPoolLayer : public NetworkLayer
+{
+
+private:
+  ImageShape inputShape;
+
+public:
+  GlobalAvgPoolLayer(ImageShape inputShape) : inputShape(inputShape) {}
+  virtual ~GlobalAvgPoolLayer() {}
+
+  virtual std::unique_ptr<NetworkLayer> clone() const
+  {
+    return std::unique_ptr<NetworkLayer>(new GlobalAvgPoolLayer(*this));
+  }
+
+  virtual std::tuple<Matrix, Matrix> output(const Matrix &input) const;
+  virtual Matrix backward(const Matrix &input, const Matrix &z, const Matrix &dY, Matrix &dW, Matrix &dB, bool propagate = true) const;
+
+  ImageShape getOutputShape() const
+  {
+    return {1, 1, inputShape.channels};
+  }
+  virtual int getNumberOfNeurons() const
+  {
+    return inputShape.channels;
+  }
+  virtual int getNumberOfInputNeurons() const
+  {
+    return inputShape.size();
+  }
+};
+
+/**
+* Boundary between the convolutional and the dense layers. Images are already flattened in the columns,
+* so the output is the input itself and the gradient passes through unchanged.
+*/
+class FlattenLayer : public NetworkLayer
+{
+
+private:
+  ImageShape inputShape;
+
+public:
+  FlattenLayer(ImageShape inputShape) : inputShape(inputShape) {}
+  virtual ~FlattenLayer() {}
+
+  virtual std::unique_ptr<NetworkLayer> clone() const
+  {
+    return std::unique_ptr<NetworkLayer>(new FlattenLayer(*this));
+  }
+
+  virtual std::tuple<Matrix, Matrix> output(const Matrix &input) const
+  {
+    return std::make_tuple(Matrix(), input);
+  }
+  virtual Matrix backward(const Matrix &, const Matrix &, const Matrix &dY, Matrix &, Matrix &, bool propagate = true) const
+  {
+    return propagate ? dY : Matrix();
+  }
+
+  virtual int getNumberOfNeurons() const
+  {
+    return inputShape.size();
+  }
+  virtual int getNumberOfInputNeurons() const
+  {
+    return inputShape.size();
+  }
+};
+
+} // namespace ann
+
+#endif
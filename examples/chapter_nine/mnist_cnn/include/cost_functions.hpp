@@ -0,0 +1,123 @@
+#ifndef COST_FUNCTIONS_H_
+#define COST_FUNCTIONS_H_
+
+#include "dataset.hpp"
+#include "mlp_core.hpp"
+
+namespace ann
+{
+
+static const double e = 1e-8;
+
+class CostFunction
+{
+
+private:
+    virtual double loss(const double expected, const double output) const = 0;
+
+public:
+
+    virtual double operator()(const Matrix &expected, const Matrix &output) const 
+    {
+        Matrix lossVector = expected.binaryExpr(output, [this](const double expected, const double output) {
+            double result = this->loss(expected, output);
+            return result;
+        });
+
+        double result = lossVector.sum() / expected.cols();
+        return result;
+    }
+
+    virtual double derivate(const double expected, const double output) const = 0;
+
+    Matrix derivative(const Matrix &expected, const Matrix &y) const
+    {
+
+        Matrix result = expected.binaryExpr(y, [this](const double expected, const double output) {
+            return this->derivate(expected, output);
+        });
+
+        return result;
+    }
+
+    /**
+    * Same as above for integer labels: every entry is evaluated for a 0 target 
+    * and only the label row of each column is replaced by the 1 target value.
+    */
+    virtual double operator()(const LabelVector &labels, const Matrix &output) const
+    {
+        Matrix lossVector = output.unaryExpr([this](const double output) {
+            return this->loss(0.0, output);
+        });
+        for(long i = 0; i < labels.size(); ++i)
+            lossVector(labels(i), i) = loss(1.0, output(labels(i), i));
+
+        double result = lossVector.sum() / output.cols();
+        return result;
+    }
+
+    Matrix derivative(const LabelVector &labels, const Matrix &y) const
+    {
+        Matrix result = y.unaryExpr([this](const double output) {
+            return this->derivate(0.0, output);
+        });
+        for(long i = 0; i < labels.size(); ++i)
+            result(labels(i), i) = derivate(1.0, y(labels(i), i));
+
+        return result;
+    }
+};
+
+class QuadraticCostFunction : public CostFunction
+{
+
+    virtual double loss(const double expected, const double output) const
+    {
+        double result = pow(output - expected, 2) * 0.5;
+        return result;
+    }
+
+    virtual double derivate(const double expected, const double output) const
+    {
+        double result = output - expected;
+        return result;
+    }
+};
+
+class CrossEntropyCostFunction : public CostFunction
+{
+private:
+    virtual double loss(const double expected, const double output) const
+    {
+        double result = -(expected * log(output + e) + (1 - expected) * log(1 - output + e));
+        return result;
+    }
+public:
+
+    virtual double derivate(const double expected, const double output) const
+    {
+        double result = -(expected / (output + e)) + ((1 - expected) / (1 - output + e));
+        return result;
+    }
+};
+
+class LogCostFunction : public CostFunction
+{
+private:
+    virtual double loss(const double expected, const double output) const
+    {
+        double result = -expected * log(output + e);
+        return result;
+    }
+public:
+
+    virtual double derivate(const double expected, const double output) const
+    {
+        double result = -expected / (output + e);
+        return result;
+    }
+};
+
+} // namespace ann
+
+#endif
\ No newline at end of file
@@ -0,0 +1,99 @@
+#ifndef DATASET_H_
+#define DATASET_H_
+
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+
+#include "matrix_definitions.hpp"
+
+namespace ann
+{
+
+struct Dataset
+{
+    Matrix X;
+    Matrix T;
+    // integer class labels, used instead of a one-hot T to save memory and argmax scans
+    LabelVector labels;
+    int numberOfClasses = 0;
+
+    std::tuple<Dataset, Dataset> split(int position)
+    {
+        if(position <= 0 || position >= X.cols())
+            throw std::invalid_argument("Invalid position");
+        Dataset first, second;
+        first.X = X.block(0, 0, X.rows(), position);
+        second.X = X.block(0, position, X.rows(), X.cols() - position);
+        if(hasLabels()) {
+            first.labels = labels.head(position);
+            second.labels = labels.tail(labels.size() - position);
+        } else {
+            first.T = T.block(0, 0, T.rows(), position);
+            second.T = T.block(0, position, T.rows(), T.cols() - position);
+        }
+        first.numberOfClasses = second.numberOfClasses = numberOfClasses;
+
+        return std::make_tuple(first, second);
+    }
+
+    long size() const {
+        return X.cols();
+    }
+
+    bool hasLabels() const {
+        return labels.size() > 0;
+    }
+
+    Matrix targets() const {
+        if(!hasLabels())
+            return T;
+        Matrix result = Matrix::Zero(numberOfClasses, labels.size());
+        for(long i = 0; i < labels.size(); ++i)
+            result(labels(i), i) = 1.0;
+        return result;
+    }
+
+    Dataset slice(int begin, int end)
+    {
+        Dataset result;
+        int cols = end - begin;
+        result.X = X.block(0, begin, X.rows(), cols);
+        if(hasLabels())
+            result.labels = labels.segment(begin, cols);
+        else
+            result.T = T.block(0, begin, T.rows(), cols);
+        result.numberOfClasses = numberOfClasses;
+        return result;
+    }
+
+    void normalize(std::function<Vector(Vector)> normalizationFunction)
+    {
+        auto rowwise = this->X.rowwise();
+        std::transform(rowwise.begin(), rowwise.end(), rowwise.begin(), [&normalizationFunction](const auto &row) {
+            return normalizationFunction(row);
+        });
+    }
+
+};
+
+template <class URNG>
+void shuffledataset(Dataset &dataset, URNG &&randomGenerator)
+{
+    Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic> colPermutation(dataset.X.cols());
+    colPermutation.setIdentity();
+    auto &indices = colPermutation.indices();
+    std::shuffle(indices.data(), indices.data() + indices.size(), randomGenerator);
+    dataset.X = dataset.X * colPermutation;
+    if(dataset.hasLabels()) {
+        LabelVector shuffled(dataset.labels.size());
+        for(long i = 0; i < shuffled.size(); ++i)
+            shuffled(i) = dataset.labels(indices(i));
+        dataset.labels = shuffled;
+    } else
+        dataset.T = dataset.T * colPermutation;
+}
+
+} // namespace ann
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef MLP_CORE_H_
+#define MLP_CORE_H_
+
+#include <memory>
+#include <sstream>
+#include <tuple>
+
+#include "activation_functions.hpp"
+
+#include <vector>
+#include <functional>
+
+namespace ann
+{
+
+/**
+* Common interface of the layers of a network. Samples are the columns of the input and output matrices;
+* the images of convolutional layers are flattened HWC (rows, cols, channels) in the column, so a batch of N images
+* is a (rows * cols * channels x N) matrix with the same memory layout as an NHWC tensor.
+* Trainable layers keep their parameters in weights and biases, the others leave them empty.
+*/
+class NetworkLayer
+{
+
+protected:
+  mutable Matrix weights;
+  mutable Vector biases;
+  double dropoutFactor;
+
+public:
+  NetworkLayer(Matrix initialWeights = Matrix(), Vector initialBiases = Vector(), double dropoutFactor = 1.0) :
+      weights(std::move(initialWeights)), biases(std::move(initialBiases)), dropoutFactor(dropoutFactor) {}
+  virtual ~NetworkLayer() {}
+
+  virtual std::unique_ptr<NetworkLayer> clone() const = 0;
+
+  /**
+  * Returns (z, y): y is the output of the layer, z is whatever backward needs besides the input
+  * (the activation input for dense and convolutional layers, the argmax indices for max pooling).
+  */
+  virtual std::tuple<Matrix, Matrix> output(const Matrix &input) const = 0;
+
+  /**
+  * Given dY, the gradient of the cost with respect to the output, fills dW and dB with the gradients of the
+  * parameters averaged over the samples and returns the gradient with respect to the input.
+  * When propagate is false the input gradient is not needed (first layer) and an empty matrix is returned.
+  */
+  virtual Matrix backward(const Matrix &input, const Matrix &z, const Matrix &dY, Matrix &dW, Matrix &dB, bool propagate = true) const = 0;
+
+  virtual int getNumberOfNeurons() const = 0;
+  virtual int getNumberOfInputNeurons() const = 0;
+
+  bool isTrainable() const
+  {
+    return this->weights.size() > 0;
+  }
+  Matrix &getWeightMatrix() const
+  {
+    return this->weights;
+  }
+  Vector &getBiases() const
+  {
+    return this->biases;
+  }
+  double getDropoutFactor() const
+  {
+    return dropoutFactor;
+  }
+};
+
+/**
+* Fully connected layer.
+*/
+class Layer : public NetworkLayer
+{
+
+private:
+  std::unique_ptr<ActivationFunction> activationFunction;
+
+public:
+  Layer(std::unique_ptr<ActivationFunction> activationFunction, Matrix initialWeights, Vector initialBiases, double dropoutFactor = 1.0) :
+      NetworkLayer(std::move(initialWeights), std::move(initialBiases), dropoutFactor), activationFunction(std::move(activationFunction))
+  {
+    if (this->weights.rows() != this->biases.size())
+    {
+      std::stringstream msg;
+      msg << "The dimensions of the weights matrix and biases matrix don't match. ";
+      msg << "The weights matrix has " << this->weights.rows();
+      msg << " rows but the biases size is " << this->biases.size();
+      throw std::invalid_argument(msg.str());
+    }
+  }
+  virtual ~Layer() {}
+  Layer(Layer const &o) : Layer(o.activationFunction->clone(), o.weights, o.biases, o.dropoutFactor) {}
+  Layer &operator=(Layer const &o)
+  {
+    if (this != &o)
+    {
+      activationFunction = o.activationFunction->clone();
+      weights = o.weights;
+      biases = o.biases;
+      dropoutFactor = o.dropoutFactor;
+    }
+    return *this;
+  }
+
+  virtual std::unique_ptr<NetworkLayer> clone() const
+  {
+    return std::unique_ptr<NetworkLayer>(new Layer(*this));
+  }
+
+  virtual std::tuple<Matrix, Matrix> output(const Matrix &input) const;
+  virtual Matrix backward(const Matrix &input, const Matrix &z, const Matrix &dY, Matrix &dW, Matrix &dB, bool propagate = true) const;
+
+  virtual int getNumberOfNeurons() const
+  {
+    return this->weights.rows();
+  }
+  virtual int getNumberOfInputNeurons() const
+  {
+    return this->weights.cols();
+  }
+  const std::unique_ptr<ActivationFunction> &getActivationFunction() const
+  {
+    return this->activationFunction;
+  }
+};
+
+class MultilayerPerceptron
+{
+
+private:
+  std::vector<std::unique_ptr<NetworkLayer>> layers;
+
+public:
+  MultilayerPerceptron() {}
+  virtual ~MultilayerPerceptron() {}
+  MultilayerPerceptron(MultilayerPerceptron &&) = default;
+  MultilayerPerceptron &operator=(MultilayerPerceptron &&) = default;
+  MultilayerPerceptron(MultilayerPerceptron const &o)
+  {
+    for (const auto &layer : o.layers)
+      this->layers.push_back(layer->clone());
+  }
+
+  Matrix output(const Matrix &input) const;
+  void add(const NetworkLayer &layer);
+  const std::vector<std::unique_ptr<NetworkLayer>> &getLayers() const
+  {
+    return layers;
+  }
+};
+
+} // namespace ann
+
+#endif
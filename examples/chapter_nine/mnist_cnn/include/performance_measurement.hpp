@@ -0,0 +1,18 @@
+#ifndef PERFORMANCE_MEASUREMENT_H_
+#define PERFORMANCE_MEASUREMENT_H_
+
+#include "mlp_core.hpp"
+#include "dataset.hpp"
+
+namespace ann
+{
+
+    /**
+    * Fraction of the samples whose largest output is the label. The dataset goes through the network
+    * batchsize samples at a time, so the activations of a whole dataset of images never have to fit in memory.
+    */
+    double accuracy(const MultilayerPerceptron &net, Dataset &dataset, int batchsize = 1000);
+    
+}// namespace ann
+
+#endif
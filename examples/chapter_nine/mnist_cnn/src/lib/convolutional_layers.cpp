@@ -0,0 +1,382 @@
+#include "convolutional_layers.hpp"
+
+namespace ann
+{
+
+Conv2DLayer::Conv2DLayer(ImageShape inputShape, std::unique_ptr<ActivationFunction> activationFunction, const Tensor4d &initialFilters, Vector initialBiases) :
+    NetworkLayer(Eigen::Map<const Matrix>(initialFilters.data(), initialFilters.size() / initialFilters.dimension(0), initialFilters.dimension(0)), std::move(initialBiases)),
+    activationFunction(std::move(activationFunction)), inputShape(inputShape), kernelRows(initialFilters.dimension(1)), kernelCols(initialFilters.dimension(2))
+{
+    validateBank(inputShape.rows, inputShape.cols, inputShape.channels, initialFilters);
+    if (this->weights.cols() != this->biases.size())
+    {
+        std::stringstream msg;
+        msg << "The filter bank has " << this->weights.cols();
+        msg << " filters but the biases size is " << this->biases.size();
+        throw std::invalid_argument(msg.str());
+    }
+}
+
+Tensor4d Conv2DLayer::filterBank() const
+{
+    return Eigen::TensorMap<const Tensor4d>(this->weights.data(), this->weights.cols(), kernelRows, kernelCols, inputShape.channels);
+}
+
+std::tuple<Matrix, Matrix> Conv2DLayer::output(const Matrix &input) const
+{
+    if (input.rows() != getNumberOfInputNeurons())
+    {
+        std::stringstream msg;
+        msg << "Wrong input dimensions. Expected is " << getNumberOfInputNeurons();
+        msg << " but the input size is " << input.rows();
+        throw std::invalid_argument(msg.str());
+    }
+
+    Matrix z(getNumberOfNeurons(), input.cols());
+    batchConvolution(input.data(), input.cols(), inputShape.rows, inputShape.cols, inputShape.channels, filterBank(), z.data());
+    // the output channels of every pixel are contiguous: one column per pixel
+    Eigen::Map<Matrix> pixels(z.data(), this->biases.size(), z.size() / this->biases.size());
+    pixels.colwise() += this->biases;
+
+    Matrix y = (*activationFunction)(z);
+
+    return std::make_tuple(z, y);
+}
+
+Matrix Conv2DLayer::backward(const Matrix &input, const Matrix &z, const Matrix &dY, Matrix &dW, Matrix &dB, bool propagate) const
+{
+    const int outputChannels = this->biases.size();
+    Matrix dZ = dY.binaryExpr(z, [this](double dy, double _z) {
+        return dy * activationFunction->prime(_z);
+    });
+
+    double m = dZ.cols();
+    const Tensor4d dK = batchKernelGradient(input.data(), dZ.data(), input.cols(), inputShape.rows, inputShape.cols, inputShape.channels, kernelRows, kernelCols, outputChannels);
+    dW = Eigen::Map<const Matrix>(dK.data(), this->weights.rows(), outputChannels) / m;
+    dB = Eigen::Map<const Matrix>(dZ.data(), outputChannels, dZ.size() / outputChannels).rowwise().sum() / m;
+
+    if (!propagate)
+        return Matrix();
+    Matrix dX(input.rows(), input.cols());
+    batchInputGradient(dZ.data(), dZ.cols(), inputShape.rows, inputShape.cols, filterBank(), dX.data());
+    return dX;
+}
+
+DepthwiseSeparableConv2DLayer::DepthwiseSeparableConv2DLayer(ImageShape inputShape, std::unique_ptr<ActivationFunction> activationFunction, const Tensor3d &initialKernels,
+                                                             const Matrix &initialPointwise, Vector initialBiases) :
+    NetworkLayer(Matrix(inputShape.channels, initialKernels.dimension(0) * initialKernels.dimension(1) + initialPointwise.rows()), std::move(initialBiases)),
+    activationFunction(std::move(activationFunction)), inputShape(inputShape), kernelRows(initialKernels.dimension(0)), kernelCols(initialKernels.dimension(1))
+{
+    validateDepthwise(inputShape.rows, inputShape.cols, inputShape.channels, initialKernels);
+    if (initialPointwise.cols() != inputShape.channels || initialPointwise.rows() != this->biases.size())
+    {
+        std::stringstream msg;
+        msg << "The pointwise weights are " << initialPointwise.rows() << "x" << initialPointwise.cols();
+        msg << " but the image has " << inputShape.channels << " channels and the biases size is " << this->biases.size();
+        throw std::invalid_argument(msg.str());
+    }
+    const int taps = kernelRows * kernelCols;
+    this->weights.leftCols(taps) = Eigen::Map<const Matrix>(initialKernels.data(), inputShape.channels, taps);
+    this->weights.rightCols(initialPointwise.rows()) = initialPointwise.transpose();
+}
+
+Tensor3d DepthwiseSeparableConv2DLayer::depthwiseKernels() const
+{
+    return Eigen::TensorMap<const Tensor3d>(this->weights.data(), kernelRows, kernelCols, inputShape.channels);
+}
+
+Matrix DepthwiseSeparableConv2DLayer::depthwiseOutput(const Matrix &input) const
+{
+    const ImageShape outputShape = getOutputShape();
+    Matrix result(outputShape.rows * outputShape.cols * inputShape.channels, input.cols());
+    batchDepthwiseConvolution(input.data(), input.cols(), inputShape.rows, inputShape.cols, inputShape.channels, depthwiseKernels(), result.data());
+    return result;
+}
+
+std::tuple<Matrix, Matrix> DepthwiseSeparableConv2DLayer::output(const Matrix &input) const
+{
+    if (input.rows() != getNumberOfInputNeurons())
+    {
+        std::stringstream msg;
+        msg << "Wrong input dimensions. Expected is " << getNumberOfInputNeurons();
+        msg << " but the input size is " << input.rows();
+        throw std::invalid_argument(msg.str());
+    }
+
+    const Matrix depthwise = depthwiseOutput(input);
+    const int outputChannels = this->biases.size();
+    Matrix z(getNumberOfNeurons(), input.cols());
+    // every pixel of the batch is a column of channels: the pointwise convolution is a single GEMM
+    Eigen::Map<Matrix> pixels(z.data(), outputChannels, z.size() / outputChannels);
+    pixels.noalias() = this->weights.rightCols(outputChannels).transpose() * Eigen::Map<const Matrix>(depthwise.data(), inputShape.channels, pixels.cols());
+    pixels.colwise() += this->biases;
+
+    Matrix y = (*activationFunction)(z);
+
+    return std::make_tuple(z, y);
+}
+
+Matrix DepthwiseSeparableConv2DLayer::backward(const Matrix &input, const Matrix &z, const Matrix &dY, Matrix &dW, Matrix &dB, bool propagate) const
+{
+    const int outputChannels = this->biases.size();
+    const int taps = kernelRows * kernelCols;
+    Matrix dZ = dY.binaryExpr(z, [this](double dy, double _z) {
+        return dy * activationFunction->prime(_z);
+    });
+
+    double m = dZ.cols();
+    const Matrix depthwise = depthwiseOutput(input);
+    Eigen::Map<const Matrix> pixelGradient(dZ.data(), outputChannels, dZ.size() / outputChannels);
+    Eigen::Map<const Matrix> pixels(depthwise.data(), inputShape.channels, pixelGradient.cols());
+    dW.resize(this->weights.rows(), this->weights.cols());
+    dW.rightCols(outputChannels).noalias() = pixels * pixelGradient.transpose() / m;
+    dB = pixelGradient.rowwise().sum() / m;
+
+    // gradient with respect to the depthwise output, then through the depthwise convolution
+    Matrix dD(depthwise.rows(), depthwise.cols());
+    Eigen::Map<Matrix>(dD.data(), inputShape.channels, pixels.cols()).noalias() = this->weights.rightCols(outputChannels) * pixelGradient;
+    const Tensor3d dK = batchDepthwiseKernelGradient(input.data(), dD.data(), input.cols(), inputShape.rows, inputShape.cols, inputShape.channels, kernelRows, kernelCols);
+    dW.leftCols(taps) = Eigen::Map<const Matrix>(dK.data(), inputShape.channels, taps) / m;
+
+    if (!propagate)
+        return Matrix();
+    Matrix dX(input.rows(), input.cols());
+    batchDepthwiseInputGradient(dD.data(), dD.cols(), inputShape.rows, inputShape.cols, depthwiseKernels(), dX.data());
+    return dX;
+}
+
+MaxPoolLayer::MaxPoolLayer(ImageShape inputShape, int pooling, int stride) : inputShape(inputShape), pooling(pooling), stride(stride)
+{
+    if (pooling < 1 || stride < 1 || pooling > inputShape.rows || pooling > inputShape.cols)
+    {
+        std::stringstream msg;
+        msg << "Invalid " << pooling << "x" << pooling << " pooling with stride " << stride;
+        msg << " for a " << inputShape.rows << "x" << inputShape.cols << " image.";
+        throw std::invalid_argument(msg.str());
+    }
+}
+
+std::tuple<Matrix, Matrix> MaxPoolLayer::output(const Matrix &input) const
+{
+    if (input.rows() != getNumberOfInputNeurons())
+    {
+        std::stringstream msg;
+        msg << "Wrong input dimensions. Expected is " << getNumberOfInputNeurons();
+        msg << " but the input size is " << input.rows();
+        throw std::invalid_argument(msg.str());
+    }
+
+    const ImageShape outputShape = getOutputShape();
+    const int channels = inputShape.channels;
+    Matrix z(outputShape.size(), input.cols()), y(outputShape.size(), input.cols());
+    parallelFor(0, input.cols(), [&](long begin, long end) {
+        for (long n = begin; n < end; ++n)
+        {
+            const double *source = input.col(n).data();
+            for (int i = 0; i < outputShape.rows; ++i)
+            {
+                for (int j = 0; j < outputShape.cols; ++j)
+                {
+                    // the channels of a pixel are contiguous, so every window pixel is compared for all of them at once
+                    double *maximum = y.col(n).data() + (i * outputShape.cols + j) * channels;
+                    double *argmax = z.col(n).data() + (i * outputShape.cols + j) * channels;
+                    const long corner = (static_cast<long>(i) * stride * inputShape.cols + j * stride) * channels;
+                    for (int c = 0; c < channels; ++c)
+                    {
+                        maximum[c] = source[corner + c];
+                        argmax[c] = corner + c;
+                    }
+                    for (int a = 0; a < pooling; ++a)
+                    {
+                        for (int b = 0; b < pooling; ++b)
+                        {
+                            const long pixel = corner + (static_cast<long>(a) * inputShape.cols + b) * channels;
+                            for (int c = 0; c < channels; ++c)
+                            {
+                                const bool greater = source[pixel + c] > maximum[c];
+                                maximum[c] = greater ? source[pixel + c] : maximum[c];
+                                argmax[c] = greater ? pixel + c : argmax[c];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    return std::make_tuple(z, y);
+}
+
+Matrix MaxPoolLayer::backward(const Matrix &input, const Matrix &z, const Matrix &dY, Matrix &, Matrix &, bool propagate) const
+{
+    if (!propagate)
+        return Matrix();
+    Matrix dX = Matrix::Zero(input.rows(), input.cols());
+    parallelFor(0, dY.cols(), [&](long begin, long end) {
+        for (long n = begin; n < end; ++n)
+            for (long k = 0; k < dY.rows(); ++k)
+                dX(static_cast<long>(z(k, n)), n) += dY(k, n);
+    });
+    return dX;
+}
+
+/**
+* Common check of the input size of the pooling layers.
+*/
+static void checkInput(const Matrix &input, int expected)
+{
+    if (input.rows() != expected)
+    {
+        std::stringstream msg;
+        msg << "Wrong input dimensions. Expected is " << expected;
+        msg << " but the input size is " << input.rows();
+        throw std::invalid_argument(msg.str());
+    }
+}
+
+AvgPoolLayer::AvgPoolLayer(ImageShape inputShape, int pooling, int stride) : inputShape(inputShape), pooling(pooling), stride(stride)
+{
+    if (pooling < 1 || stride < 1 || pooling > inputShape.rows || pooling > inputShape.cols)
+    {
+        std::stringstream msg;
+        msg << "Invalid " << pooling << "x" << pooling << " pooling with stride " << stride;
+        msg << " for a " << inputShape.rows << "x" << inputShape.cols << " image.";
+        throw std::invalid_argument(msg.str());
+    }
+}
+
+std::tuple<Matrix, Matrix> AvgPoolLayer::output(const Matrix &input) const
+{
+    checkInput(input, getNumberOfInputNeurons());
+
+    const ImageShape outputShape = getOutputShape();
+    const int channels = inputShape.channels;
+    // the table has a zero first row and column: table(i, j) is the sum of the pixels above and left of (i, j)
+    const long tableCols = inputShape.cols + 1;
+    const double scale = 1.0 / (pooling * pooling);
+    Matrix y(outputShape.size(), input.cols());
+    parallelFor(0, input.cols(), [&](long begin, long end) {
+        std::vector<double> table((inputShape.rows + 1) * tableCols * channels, 0.0);
+        auto at = [&](long i, long j) { return table.data() + (i * tableCols + j) * channels; };
+        for (long n = begin; n < end; ++n)
+        {
+            const double *source = input.col(n).data();
+            for (int i = 0; i < inputShape.rows; ++i)
+            {
+                for (int j = 0; j < inputShape.cols; ++j)
+                {
+                    const double *pixel = source + (static_cast<long>(i) * inputShape.cols + j) * channels;
+                    const double *up = at(i, j + 1), *left = at(i + 1, j), *diagonal = at(i, j);
+                    double *sum = at(i + 1, j + 1);
+                    for (int c = 0; c < channels; ++c)
+                        sum[c] = pixel[c] + up[c] + left[c] - diagonal[c];
+                }
+            }
+            for (int i = 0; i < outputShape.rows; ++i)
+            {
+                for (int j = 0; j < outputShape.cols; ++j)
+                {
+                    const long top = i * stride, left = j * stride;
+                    const double *a = at(top, left), *b = at(top, left + pooling), *c = at(top + pooling, left), *d = at(top + pooling, left + pooling);
+                    double *mean = y.col(n).data() + (static_cast<long>(i) * outputShape.cols + j) * channels;
+                    for (int k = 0; k < channels; ++k)
+                        mean[k] = (d[k] - b[k] - c[k] + a[k]) * scale;
+                }
+            }
+        }
+    });
+
+    return std::make_tuple(Matrix(), y);
+}
+
+Matrix AvgPoolLayer::backward(const Matrix &input, const Matrix &, const Matrix &dY, Matrix &, Matrix &, bool propagate) const
+{
+    if (!propagate)
+        return Matrix();
+    const ImageShape outputShape = getOutputShape();
+    const int channels = inputShape.channels;
+    const long tableCols = inputShape.cols + 1;
+    const double scale = 1.0 / (pooling * pooling);
+    Matrix dX(input.rows(), input.cols());
+    parallelFor(0, dY.cols(), [&](long begin, long end) {
+        std::vector<double> differences((inputShape.rows + 1) * tableCols * channels);
+        auto at = [&](long i, long j) { return differences.data() + (i * tableCols + j) * channels; };
+        for (long n = begin; n < end; ++n)
+        {
+            std::fill(differences.begin(), differences.end(), 0.0);
+            for (int i = 0; i < outputShape.rows; ++i)
+            {
+                for (int j = 0; j < outputShape.cols; ++j)
+                {
+                    const long top = i * stride, left = j * stride;
+                    double *a = at(top, left), *b = at(top, left + pooling), *c = at(top + pooling, left), *d = at(top + pooling, left + pooling);
+                    const double *gradient = dY.col(n).data() + (static_cast<long>(i) * outputShape.cols + j) * channels;
+                    for (int k = 0; k < channels; ++k)
+                    {
+                        const double value = gradient[k] * scale;
+                        a[k] += value;
+                        b[k] -= value;
+                        c[k] -= value;
+                        d[k] += value;
+                    }
+                }
+            }
+            // integrating the differences gives every pixel the sum over the windows holding it
+            double *target = dX.col(n).data();
+            for (int i = 0; i < inputShape.rows; ++i)
+            {
+                for (int j = 0; j < inputShape.cols; ++j)
+                {
+                    double *sum = at(i, j);
+                    if (i > 0)
+                    {
+                        const double *up = at(i - 1, j);
+                        for (int k = 0; k < channels; ++k)
+                            sum[k] += up[k];
+                    }
+                    if (j > 0)
+                    {
+                        const double *left = at(i, j - 1);
+                        for (int k = 0; k < channels; ++k)
+                            sum[k] += left[k];
+                    }
+                    if (i > 0 && j > 0)
+                    {
+                        const double *diagonal = at(i - 1, j - 1);
+                        for (int k = 0; k < channels; ++k)
+                            sum[k] -= diagonal[k];
+                    }
+                    std::copy(sum, sum + channels, target + (static_cast<long>(i) * inputShape.cols + j) * channels);
+                }
+            }
+        }
+    });
+    return dX;
+}
+
+std::tuple<Matrix, Matrix> GlobalAvgPoolLayer::output(const Matrix &input) const
+{
+    checkInput(input, getNumberOfInputNeurons());
+    const int channels = inputShape.channels;
+    Matrix y(channels, input.cols());
+    for (long n = 0; n < input.cols(); ++n)
+    {
+        Eigen::Map<const Matrix> pixels(input.col(n).data(), channels, input.rows() / channels);
+        y.col(n) = pixels.rowwise().mean();
+    }
+    return std::make_tuple(Matrix(), y);
+}
+
+Matrix GlobalAvgPoolLayer::backward(const Matrix &input, const Matrix &, const Matrix &dY, Matrix &, Matrix &, bool propagate) const
+{
+    if (!propagate)
+        return Matrix();
+    const int channels = inputShape.channels;
+    const long pixels = input.rows() / channels;
+    Matrix dX(input.rows(), input.cols());
+    for (long n = 0; n < input.cols(); ++n)
+        Eigen::Map<Matrix>(dX.col(n).data(), channels, pixels) = (dY.col(n) / static_cast<double>(pixels)).replicate(1, pixels);
+    return dX;
+}
+
+} // namespace ann
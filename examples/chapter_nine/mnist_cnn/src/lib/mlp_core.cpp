@@ -0,0 +1,77 @@
+#include "mlp_core.hpp"
+
+namespace ann
+{
+
+std::tuple<Matrix, Matrix> Layer::output(const Matrix &input) const
+{
+    if (this->weights.cols() != input.rows())
+    {
+        std::stringstream msg;
+        msg << "Wrong input dimensions. Expected is " << this->weights.cols();
+        msg << " but the input size is " << input.rows();
+        throw std::invalid_argument(msg.str());
+    }
+
+    Matrix prod = this->weights * input;
+    Matrix z = prod.colwise() + this->biases;
+
+    Matrix y = (*activationFunction)(z);
+
+    return std::make_tuple(z, y);
+}
+
+Matrix Layer::backward(const Matrix &input, const Matrix &z, const Matrix &dY, Matrix &dW, Matrix &dB, bool propagate) const
+{
+    Matrix dZ = Matrix::Zero(dY.rows(), dY.cols());
+    auto zColwise = z.colwise();
+    auto dYcolwise = dY.colwise();
+    auto dZcolwise = dZ.colwise();
+    std::transform(zColwise.begin(), zColwise.end(), dYcolwise.begin(), dZcolwise.begin(),
+        [this](const Matrix &_z, const Matrix &_dY) {
+            auto gPrime = activationFunction->prime(_z);
+            Vector result = gPrime * _dY;
+            return result;
+        });
+
+    double m = dZ.cols();
+    dW = dZ * input.transpose() / m;
+    dB = dZ.rowwise().sum() / m;
+
+    if (!propagate)
+        return Matrix();
+    return this->weights.transpose() * dZ;
+}
+
+Matrix MultilayerPerceptron::output(const Matrix &input) const
+{
+    Matrix currentInput = input;
+
+    std::for_each(layers.begin(), layers.end(), [&currentInput](const std::unique_ptr<NetworkLayer> &layer) {
+        std::tie(std::ignore, currentInput) = layer->output(currentInput);
+        double keepProb = layer->getDropoutFactor();
+        if (keepProb < 1.0)
+            currentInput = keepProb * currentInput;
+    });
+
+    return currentInput;
+}
+
+void MultilayerPerceptron::add(const NetworkLayer &layer)
+{
+    if (!this->layers.empty())
+    {
+        const NetworkLayer &last = *this->layers.back();
+        if (last.getNumberOfNeurons() != layer.getNumberOfInputNeurons())
+        {
+            std::stringstream msg;
+            msg << "The new layer's doesn't fit to the network setup. ";
+            msg << "The last layer in the network has " << last.getNumberOfNeurons();
+            msg << " neurons but the new layer is configured for " << layer.getNumberOfInputNeurons();
+            msg << " input neurons.";
+            throw std::invalid_argument(msg.str());
+        }
+    }
+    this->layers.push_back(layer.clone());
+}
+} // namespace ann
@@ -0,0 +1,24 @@
+#include "performance_measurement.hpp"
+
+namespace ann
+{
+
+    double accuracy(const MultilayerPerceptron &net, Dataset &dataset, int batchsize)
+    {
+        long hits = 0;
+        for(int index = 0; index < dataset.size(); index += batchsize)
+        {
+            int end = std::min<long>(index + batchsize, dataset.size());
+            auto batch = dataset.slice(index, end);
+            auto output = net.output(batch.X);
+            for(long i = 0; i < output.cols(); ++i) {
+                Matrix::Index label;
+                output.col(i).maxCoeff(&label);
+                if(label == batch.labels(i))
+                    hits++;
+            }
+        }
+        return static_cast<double>(hits) / dataset.size();
+    }
+    
+}// namespace ann
@@ -0,0 +1,196 @@
+#include <iostream>
+#include <fstream>
+#include <exception>
+#include <string>
+#include <chrono>
+
+#include "cost_functions.hpp"
+#include "performance_measurement.hpp"
+#include "backpropagation.hpp"
+#include "convolutional_layers.hpp"
+
+uint32_t readUnsignedInt32(std::ifstream &stream, size_t position)
+{
+    stream.seekg(position, std::ios::beg);
+    uint32_t temp;
+    stream.read(reinterpret_cast<char *>(&temp), sizeof(temp));
+    uint32_t result = ((temp << 8) & 0xFF00FF00) | ((temp >> 8) & 0xFF00FF);
+    return (result << 16) | (result >> 16);
+}
+
+Matrix loadInput(const std::string &imagesFilePath)
+{
+    std::ifstream imagesStream(imagesFilePath, std::ios::in | std::ios::binary);
+
+    if (!imagesStream.is_open())
+        throw std::invalid_argument("failed to open the images file " + imagesFilePath + ".");
+
+    uint32_t magicNumber = readUnsignedInt32(imagesStream, 0);
+
+    if (magicNumber != 2051)
+        throw std::invalid_argument("failed to read magic number in images file.");
+
+    uint32_t numberOfInstances = readUnsignedInt32(imagesStream, 4);
+    uint32_t numberOfRows = readUnsignedInt32(imagesStream, 8);
+    uint32_t numberOfCols = readUnsignedInt32(imagesStream, 12);
+    std::cout << "This file has " << numberOfInstances << " images of " << numberOfRows << "x" << numberOfCols << ".\n";
+
+    const size_t size = numberOfRows * numberOfCols;
+
+    Matrix result(size, numberOfInstances);
+
+    std::unique_ptr<unsigned char[]> buffer(new unsigned char[size]);
+
+    for (unsigned instance = 0; instance < numberOfInstances; ++instance)
+    {
+        imagesStream.read(reinterpret_cast<char *>(buffer.get()), size);
+        // the images are stored row by row, which is HWC for a single channel
+        std::transform(buffer.get(), buffer.get() + size, result.col(instance).data(), [](unsigned char pixel) {
+            return pixel / 255.0;
+        });
+    }
+
+    return result;
+}
+
+LabelVector loadTarget(const std::string &labelsFilePath)
+{
+    std::ifstream labelsStream(labelsFilePath, std::ios::in | std::ios::binary);
+
+    if (!labelsStream.is_open())
+        throw std::invalid_argument("failed to open the labels file.");
+
+    uint32_t magicNumber = readUnsignedInt32(labelsStream, 0);
+
+    if (magicNumber != 2049)
+        throw std::invalid_argument("failed to read magic number in labels file.");
+
+    uint32_t numberOfInstances = readUnsignedInt32(labelsStream, 4);
+
+    LabelVector result(numberOfInstances);
+    labelsStream.read(reinterpret_cast<char *>(result.data()), numberOfInstances);
+
+    return result;
+}
+
+ann::Dataset loadMNISTDataset(const std::string &imagesFilePath, const std::string &labelsFilePath)
+{
+    ann::Dataset result;
+    result.X = loadInput(imagesFilePath);
+    result.labels = loadTarget(labelsFilePath);
+    result.numberOfClasses = 10;
+    if (result.labels.size() != result.X.cols())
+        throw std::invalid_argument("the number of images and labels don't match.");
+    return result;
+}
+
+/**
+* conv 5x5 (8 filters) + ReLU -> pooling -> flatten -> dense softmax, He initialization. The pooling is "max" or
+* "average" over 2x2 windows, or "global" average pooling, which leaves one feature per filter. With separable, a
+* depthwise-separable 3x3 convolution to 16 channels + ReLU goes between the convolution and the pooling: 200 products
+* per pixel where a dense 3x3x8x16 bank would take 1152.
+*/
+ann::MultilayerPerceptron initializeNetwork(std::mt19937 &prn, const std::string &pooling, bool separable)
+{
+    const ann::ImageShape imageShape{28, 28, 1};
+    const int numberOfFilters = 8;
+    const int kernelSize = 5;
+
+    ann::MultilayerPerceptron result;
+    std::normal_distribution<> convDistribution(0.0, std::sqrt(2.0 / (kernelSize * kernelSize * imageShape.channels)));
+    Tensor4d filters(numberOfFilters, kernelSize, kernelSize, imageShape.channels);
+    for (long i = 0; i < filters.size(); ++i)
+        filters.data()[i] = convDistribution(prn);
+    ann::Conv2DLayer conv(imageShape, std::unique_ptr<ann::ActivationFunction>(new ann::ReLUActivationFunction()), filters, Vector::Zero(numberOfFilters));
+    result.add(conv);
+
+    ann::ImageShape featureShape = conv.getOutputShape();
+    if (separable)
+    {
+        const int separableKernel = 3;
+        const int separableFilters = 16;
+        std::normal_distribution<> depthwiseDistribution(0.0, std::sqrt(2.0 / (separableKernel * separableKernel)));
+        Tensor3d kernels(separableKernel, separableKernel, featureShape.channels);
+        for (long i = 0; i < kernels.size(); ++i)
+            kernels.data()[i] = depthwiseDistribution(prn);
+        std::normal_distribution<> pointwiseDistribution(0.0, std::sqrt(2.0 / featureShape.channels));
+        Matrix pointwise = Matrix::NullaryExpr(separableFilters, featureShape.channels, [&]() { return pointwiseDistribution(prn); });
+        ann::DepthwiseSeparableConv2DLayer layer(featureShape, std::unique_ptr<ann::ActivationFunction>(new ann::ReLUActivationFunction()), kernels, pointwise, Vector::Zero(separableFilters));
+        featureShape = layer.getOutputShape();
+        result.add(layer);
+    }
+
+    ann::ImageShape pooledShape;
+    if (pooling == "max")
+    {
+        ann::MaxPoolLayer layer(featureShape, 2, 2);
+        pooledShape = layer.getOutputShape();
+        result.add(layer);
+    }
+    else if (pooling == "average")
+    {
+        ann::AvgPoolLayer layer(featureShape, 2, 2);
+        pooledShape = layer.getOutputShape();
+        result.add(layer);
+    }
+    else if (pooling == "global")
+    {
+        ann::GlobalAvgPoolLayer layer(featureShape);
+        pooledShape = layer.getOutputShape();
+        result.add(layer);
+    }
+    else
+        throw std::invalid_argument("Unknown pooling " + pooling + ", expected max, average or global.");
+
+    ann::FlattenLayer flatten(pooledShape);
+    result.add(flatten);
+
+    const int inputs = flatten.getNumberOfNeurons();
+    std::normal_distribution<> denseDistribution(0.0, std::sqrt(2.0 / inputs));
+    Matrix wOut = Matrix::NullaryExpr(10, inputs, [&]() { return denseDistribution(prn); });
+    ann::Layer outputLayer(std::unique_ptr<ann::ActivationFunction>(new ann::SoftmaxActivationFunction()), wOut, Vector::Zero(10));
+    result.add(outputLayer);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    const std::string pooling = argc > 1 ? argv[1] : "max";
+    const bool separable = argc > 2 && std::string(argv[2]) == "separable";
+    if (argc > 3 || (argc > 2 && !separable) || (pooling != "max" && pooling != "average" && pooling != "global"))
+    {
+        std::cerr << "Usage: " << argv[0] << " [max|average|global] [separable]\n";
+        return -1;
+    }
+    try
+    {
+        std::cout << "Loading data...\n";
+        auto training = loadMNISTDataset("../data/mnist/train-images-idx3-ubyte", "../data/mnist/train-labels-idx1-ubyte");
+        auto test = loadMNISTDataset("../data/mnist/t10k-images-idx3-ubyte", "../data/mnist/t10k-labels-idx1-ubyte");
+
+        std::mt19937 prn(7);
+        ann::MultilayerPerceptron net = initializeNetwork(prn, pooling, separable);
+
+        const double learningRate = 0.05;
+        const int maxEpochs = 3;
+        const int batchsize = 32;
+        ann::Backpropagation<ann::LogCostFunction> backpropagation(net, training, learningRate, maxEpochs, batchsize);
+
+        std::cout << "epoch\ttraining cost\n";
+        auto start = std::chrono::steady_clock::now();
+        backpropagation.train();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Training time: " << elapsed.count() << " s (" << elapsed.count() / maxEpochs << " s per epoch)\n";
+
+        std::cout << "Training accuracy: " << ann::accuracy(net, training) << "\n";
+        std::cout << "Test accuracy: " << ann::accuracy(net, test) << "\n";
+    }
+    catch (std::exception const &e)
+    {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        std::cerr << "Only the MNIST labels are shipped in data/mnist, download the images (train-images-idx3-ubyte and t10k-images-idx3-ubyte) there.\n";
+        return -1;
+    }
+
+    return 0;
+}
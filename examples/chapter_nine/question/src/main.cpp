@@ -63,27 +63,41 @@ double quadraticCost(const Matrix & output, const Matrix & expectedOutput)
 }
 
 /**
-* This function is a stub. Implement it to return the quadratic cost gradient
+* Gradient of the quadratic cost with respect to the output
 */ 
 Matrix quadraticCostGradient(const Matrix & output, const Matrix & expectedOutput) 
 {
-    return Matrix::Zero(output.rows(), output.cols());
+    Matrix result = (output - expectedOutput) / (output.rows() * output.cols());
+    return result;
 }
 
 /**
-* This function is a stub. Implement it to return the ReLU output gradient
+* Gradient of the ReLU output: max pooling only passes the gradient of each window to its maximum
 */ 
 Matrix gradientR(const Matrix &dC, const Matrix &R, const int pooling, int strides)
 {
-    return Matrix::Zero(R.rows(), R.cols());
+    Matrix result = Matrix::Zero(R.rows(), R.cols());
+    for(int i = 0; i < dC.rows(); ++i)
+    {
+        for(int j = 0; j < dC.cols(); ++j)
+        {
+            Matrix::Index maxRow, maxCol;
+            R.block(strides*i, strides*j, pooling, pooling).maxCoeff(&maxRow, &maxCol);
+            result(strides*i + maxRow, strides*j + maxCol) += dC(i, j);
+        }
+    }
+    return result;
 }
 
 /**
-* This function is a stub. Implement it to return the convolution output gradient 
+* Gradient of the convolution output: ReLU lets the gradient through where its input is positive
 */ 
 Matrix gradientCONV(const Matrix &dR, const Matrix &CONV)
 {
-    return Matrix::Zero(CONV.rows(), CONV.cols());
+    Matrix result = dR.binaryExpr(CONV, [](double gradient, double coeff){
+        return coeff > 0.0 ? gradient : 0.0;
+    });
+    return result;
 }
 
 /**
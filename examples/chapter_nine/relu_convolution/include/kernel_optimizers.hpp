@@ -0,0 +1,43 @@
+#ifndef KERNEL_OPTIMIZERS_H_
+#define KERNEL_OPTIMIZERS_H_
+
+#include <cmath>
+#include <functional>
+
+#include "matrix_definitions.hpp"
+
+namespace ann
+{
+
+/**
+* Update applied to the kernel for the averaged gradient dK of a step, as the hookOptimizer functions of Backpropagation.
+*/
+using KernelOptimizer = std::function<Matrix(double learningRate, const Matrix &dK, long step)>;
+
+inline KernelOptimizer sgdOptimizer()
+{
+    return [](double learningRate, const Matrix &dK, long) -> Matrix { return -learningRate * dK; };
+}
+
+/**
+* Adam: the step is divided by the running RMS of the gradient, so the learning rate is in kernel units
+* whatever the scale of the pixels.
+*/
+inline KernelOptimizer adamOptimizer(double beta1 = 0.9, double beta2 = 0.999, double epsilon = 1e-8)
+{
+    return [beta1, beta2, epsilon, m = Matrix(), v = Matrix()](double learningRate, const Matrix &dK, long step) mutable -> Matrix {
+        if (m.size() == 0)
+        {
+            m = Matrix::Zero(dK.rows(), dK.cols());
+            v = Matrix::Zero(dK.rows(), dK.cols());
+        }
+        m = beta1 * m + (1.0 - beta1) * dK;
+        v = beta2 * v + (1.0 - beta2) * dK.cwiseAbs2();
+        const double alpha = learningRate * std::sqrt(1.0 - std::pow(beta2, step + 1)) / (1.0 - std::pow(beta1, step + 1));
+        return m.binaryExpr(v, [alpha, epsilon](double _m, double _v) { return -alpha * _m / (std::sqrt(_v) + epsilon); });
+    };
+}
+
+} // namespace ann
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef PATCH_TRAINER_H_
+#define PATCH_TRAINER_H_
+
+#include <functional>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "convolution.hpp"
+#include "kernel_optimizers.hpp"
+
+namespace ann
+{
+
+/**
+* Fits a kernel so that the convolution of the images matches the targets, by minibatch gradient descent on random
+* patches instead of the whole images. Every step draws batchSize patches of patchSize x patchSize outputs (fewer when
+* the output is smaller) from random images and positions; the input window of a patch includes the halo read by the
+* kernel, so a patch gives exactly the outputs of the full convolution. The windows are lowered by im2col into one
+* patch matrix, the forward pass is a GEMV and the gradient a transposed GEMV, and the cost is the mean over the
+* outputs of 1/2 (output - target)^2: the gradient doesn't scale with the image size and plain learning rates work.
+* With setReLU the model is relu(convolution), the gradient only flowing through the positive outputs.
+*/
+class PatchKernelTrainer
+{
+
+private:
+    std::vector<Matrix> images;
+    std::vector<Matrix> targets;
+    Matrix kernel;
+    ConvolutionParameters params;
+    int patchSize;
+    int batchSize;
+    double learningRate;
+    KernelOptimizer optimizer;
+    std::mt19937 prn;
+    long steps = 0;
+    double multiplyAdds = 0.0;
+    bool relu = false;
+
+public:
+    PatchKernelTrainer(std::vector<Matrix> images, std::vector<Matrix> targets, Matrix initialKernel, int patchSize, int batchSize, double learningRate,
+                       const ConvolutionParameters &params = ConvolutionParameters(), unsigned seed = 0) :
+        images(std::move(images)), targets(std::move(targets)), kernel(std::move(initialKernel)), params(params), patchSize(patchSize),
+        batchSize(batchSize), learningRate(learningRate), optimizer(sgdOptimizer()), prn(seed)
+    {
+        if (this->images.empty() || this->images.size() != this->targets.size())
+            throw std::invalid_argument("One target is required for each image.");
+        if (params.hasPadding())
+            throw std::invalid_argument("Patch training samples valid windows, padding is not supported.");
+        if (patchSize < 1 || batchSize < 1)
+            throw std::invalid_argument("The patch size and the batch size must be positive.");
+        for (size_t n = 0; n < this->images.size(); ++n)
+        {
+            const Matrix &image = this->images[n];
+            params.validate(image.rows(), image.cols(), kernel.rows(), kernel.cols());
+            if (this->targets[n].rows() != params.outputRows(image.rows(), kernel.rows()) || this->targets[n].cols() != params.outputCols(image.cols(), kernel.cols()))
+            {
+                std::stringstream msg;
+                msg << "The target " << n << " is " << this->targets[n].rows() << "x" << this->targets[n].cols();
+                msg << " but the convolution of its image is " << params.outputRows(image.rows(), kernel.rows()) << "x" << params.outputCols(image.cols(), kernel.cols());
+                throw std::invalid_argument(msg.str());
+            }
+        }
+    }
+
+    void hookOptimizer(KernelOptimizer fnc)
+    {
+        optimizer = std::move(fnc);
+    }
+
+    void setReLU(bool enabled)
+    {
+        relu = enabled;
+    }
+
+    /**
+    * Output of the model for an image: its convolution with the current kernel, through the ReLU if enabled.
+    */
+    Matrix output(const Matrix &image) const
+    {
+        Matrix result = convolution(image, kernel, params);
+        return relu ? Matrix(result.cwiseMax(0.0)) : result;
+    }
+
+    /**
+    * One minibatch update, returns the mean squared error of the batch before the update.
+    */
+    double step()
+    {
+        const int kernelRows = kernel.rows();
+        const int kernelCols = kernel.cols();
+        const int taps = kernelRows * kernelCols;
+        std::uniform_int_distribution<size_t> imageDistribution(0, images.size() - 1);
+        const ConvolutionParameters windowParams(0, 0, params.rowStride, params.colStride, params.dilation);
+
+        struct Sample
+        {
+            size_t image;
+            int row, col, rows, cols;
+        };
+        std::vector<Sample> samples(batchSize);
+        long outputs = 0;
+        for (auto &sample : samples)
+        {
+            sample.image = imageDistribution(prn);
+            const Matrix &target = targets[sample.image];
+            sample.rows = std::min<int>(patchSize, target.rows());
+            sample.cols = std::min<int>(patchSize, target.cols());
+            sample.row = std::uniform_int_distribution<int>(0, target.rows() - sample.rows)(prn);
+            sample.col = std::uniform_int_distribution<int>(0, target.cols() - sample.cols)(prn);
+            outputs += static_cast<long>(sample.rows) * sample.cols;
+        }
+
+        Matrix patches(outputs, taps), lowered;
+        Vector expected(outputs);
+        long offset = 0;
+        for (const auto &sample : samples)
+        {
+            // the outputs of the patch read this window of the image, halo included
+            const Matrix window = images[sample.image].block(sample.row * params.rowStride, sample.col * params.colStride,
+                                                             (sample.rows - 1) * params.rowStride + params.dilatedSize(kernelRows),
+                                                             (sample.cols - 1) * params.colStride + params.dilatedSize(kernelCols));
+            im2col(window, kernelRows, kernelCols, windowParams, 0, sample.cols, lowered);
+            patches.middleRows(offset, lowered.rows()) = lowered;
+            Eigen::Map<Matrix>(expected.data() + offset, sample.rows, sample.cols) = targets[sample.image].block(sample.row, sample.col, sample.rows, sample.cols);
+            offset += lowered.rows();
+        }
+
+        const Vector z = patches * Eigen::Map<const Vector>(kernel.data(), taps);
+        const Vector error = (relu ? Vector(z.cwiseMax(0.0)) : z) - expected;
+        // the ReLU output is positive exactly where the convolution is, elsewhere the gradient is 0
+        const Vector dC = relu ? Vector((z.array() > 0.0).select(error, 0.0)) : error;
+        Matrix dK(kernelRows, kernelCols);
+        Eigen::Map<Vector>(dK.data(), taps).noalias() = patches.transpose() * dC / static_cast<double>(outputs);
+        kernel += optimizer(learningRate, dK, steps);
+        ++steps;
+        multiplyAdds += 2.0 * outputs * taps;
+        return error.squaredNorm() / outputs;
+    }
+
+    /**
+    * Mean squared error of the current kernel on all the images.
+    */
+    double cost() const
+    {
+        double sum = 0.0;
+        long outputs = 0;
+        for (size_t n = 0; n < images.size(); ++n)
+        {
+            const Matrix dC = output(images[n]) - targets[n];
+            sum += dC.squaredNorm();
+            outputs += dC.size();
+        }
+        return sum / outputs;
+    }
+
+    const Matrix &getKernel() const
+    {
+        return kernel;
+    }
+    long getSteps() const
+    {
+        return steps;
+    }
+    /**
+    * Work of the steps so far in full passes over the images, a full gradient descent epoch (forward + gradient) being 1.
+    */
+    double getImagePasses() const
+    {
+        double fullEpoch = 0.0;
+        for (const auto &target : targets)
+            fullEpoch += 2.0 * target.size() * kernel.size();
+        return multiplyAdds / fullEpoch;
+    }
+};
+
+} // namespace ann
+
+#endif
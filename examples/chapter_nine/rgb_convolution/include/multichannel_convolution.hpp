@@ -0,0 +1,582 @@
+#ifndef MULTICHANNEL_CONVOLUTION_H_
+#define MULTICHANNEL_CONVOLUTION_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <unsupported/Eigen/CXX11/Tensor>
+
+#include "matrix_definitions.hpp"
+#include "parallel.hpp"
+
+// images are packed HWC (rows, cols, channels), the channels of a pixel are contiguous
+using Tensor3d = Eigen::Tensor<double, 3, Eigen::RowMajor>;
+// filter banks are (output channels, rows, cols, input channels); batches of images are NHWC
+using Tensor4d = Eigen::Tensor<double, 4, Eigen::RowMajor>;
+
+namespace ann
+{
+
+using RowMajorMatrix = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+using ConstStridedMap = Eigen::Map<const Matrix, 0, Eigen::OuterStride<>>;
+using ConstStridedRowMajorMap = Eigen::Map<const RowMajorMatrix, 0, Eigen::OuterStride<>>;
+using StridedRowMajorMap = Eigen::Map<RowMajorMatrix, 0, Eigen::OuterStride<>>;
+
+/**
+* In HWC the cols x channels values of an image row are contiguous, so the kernelCols pixels read by output pixel j
+* are one run of kernelCols * channels values starting at j * channels. Viewing the row as a matrix with that many rows
+* and an outer stride of channels gives every (overlapping) patch row as a column, without copying anything.
+*/
+inline ConstStridedMap patchRows(const double *row, int channels, int kernelCols, int outputCols)
+{
+    return ConstStridedMap(row, kernelCols * channels, outputCols, Eigen::OuterStride<>(channels));
+}
+
+/**
+* Row a of every filter of the bank: (output channels x kernelCols * input channels), contiguous rows.
+*/
+inline ConstStridedRowMajorMap filterRow(const Tensor4d &filters, int a)
+{
+    const int rowSize = filters.dimension(2) * filters.dimension(3);
+    return ConstStridedRowMajorMap(filters.data() + a * rowSize, filters.dimension(0), rowSize, Eigen::OuterStride<>(filters.dimension(1) * rowSize));
+}
+
+inline void validateBank(int rows, int cols, int channels, const Tensor4d &filters)
+{
+    if (filters.dimension(3) != channels || filters.dimension(1) > rows || filters.dimension(2) > cols)
+    {
+        std::stringstream ss;
+        ss << "A " << filters.dimension(0) << "x" << filters.dimension(1) << "x" << filters.dimension(2) << "x" << filters.dimension(3);
+        ss << " filter bank does not fit a " << rows << "x" << cols << "x" << channels << " image.";
+        throw std::invalid_argument(ss.str());
+    }
+}
+
+/**
+* Strided view of an HWC image: row i holds the cols x channels values starting at data + i * stride, like the rows of
+* a cv::Mat or of a region of interest. Pixel is the type of the values, unsigned char for 8-bit images.
+*/
+template <typename Pixel>
+struct ImageView
+{
+    Pixel *data;
+    int rows;
+    int cols;
+    int channels;
+    long stride;
+
+    Pixel *row(long i) const
+    {
+        return data + i * stride;
+    }
+};
+
+inline ImageView<const double> imageView(const Tensor3d &image)
+{
+    return {image.data(), static_cast<int>(image.dimension(0)), static_cast<int>(image.dimension(1)), static_cast<int>(image.dimension(2)), image.dimension(1) * image.dimension(2)};
+}
+
+inline ImageView<double> imageView(Tensor3d &image)
+{
+    return {image.data(), static_cast<int>(image.dimension(0)), static_cast<int>(image.dimension(1)), static_cast<int>(image.dimension(2)), image.dimension(1) * image.dimension(2)};
+}
+
+/**
+* Value stored in an output pixel: rounded and saturated for integer pixels, like cv::Mat::convertTo.
+*/
+template <typename Pixel>
+inline Pixel saturatePixel(double value)
+{
+    if constexpr (std::is_integral<Pixel>::value)
+        return static_cast<Pixel>(std::min<double>(std::numeric_limits<Pixel>::max(), std::max<double>(std::numeric_limits<Pixel>::lowest(), std::nearbyint(value))));
+    else
+        return static_cast<Pixel>(value);
+}
+
+/**
+* Valid convolution of an HWC image with a bank of C_out filters of C_in channels, (C_out, kernelRows, kernelCols, C_in),
+* into an HWC image of C_out channels. Each output row, (outputCols x C_out) row-major in HWC, is the sum of kernelRows
+* products patchRows^T (outputCols x kernelCols * C_in) * filterRow^T (kernelCols * C_in x C_out): the reduction over the
+* kernel columns and the channels is a contiguous run of each patch, and the GEMM vectorizes it for all the output
+* channels at once. Output rows are split among the hardware threads.
+* Both images are strided views, so a cv::Mat is read and written in place. Double rows are read directly, other pixel
+* types (8-bit images) are widened a row at a time into a ring of kernelRows rows, every input row once per thread.
+* Double output rows are written by the GEMM, other types are rounded from a row buffer.
+*/
+template <typename InputPixel, typename OutputPixel>
+inline void convolution(const ImageView<InputPixel> &input, const Tensor4d &filters, const ImageView<OutputPixel> &output)
+{
+    validateBank(input.rows, input.cols, input.channels, filters);
+    const int outputChannels = filters.dimension(0);
+    const int kernelRows = filters.dimension(1);
+    const int kernelCols = filters.dimension(2);
+    const int outputCols = input.cols - kernelCols + 1;
+    if (output.rows != input.rows - kernelRows + 1 || output.cols != outputCols || output.channels != outputChannels)
+    {
+        std::stringstream ss;
+        ss << "The output is " << output.rows << "x" << output.cols << "x" << output.channels;
+        ss << " but the convolution is " << input.rows - kernelRows + 1 << "x" << outputCols << "x" << outputChannels << ".";
+        throw std::invalid_argument(ss.str());
+    }
+    constexpr bool doubleInput = std::is_same<std::remove_const_t<InputPixel>, double>::value;
+    constexpr bool doubleOutput = std::is_same<OutputPixel, double>::value;
+    const long rowSize = static_cast<long>(input.cols) * input.channels;
+
+    parallelFor(0, output.rows, [&](long begin, long end) {
+        RowMajorMatrix ring(doubleInput ? 0 : kernelRows, rowSize);
+        std::vector<long> ringRows(kernelRows, -1);
+        RowMajorMatrix buffer(doubleOutput ? 0 : outputCols, outputChannels);
+        auto inputRow = [&](long r) -> const double * {
+            if constexpr (doubleInput)
+                return input.row(r);
+            else
+            {
+                const int slot = r % kernelRows;
+                if (ringRows[slot] != r)
+                {
+                    std::copy(input.row(r), input.row(r) + rowSize, ring.row(slot).data());
+                    ringRows[slot] = r;
+                }
+                return ring.row(slot).data();
+            }
+        };
+        for (long i = begin; i < end; ++i)
+        {
+            double *rowOutput;
+            if constexpr (doubleOutput)
+                rowOutput = output.row(i);
+            else
+                rowOutput = buffer.data();
+            Eigen::Map<RowMajorMatrix> out(rowOutput, outputCols, outputChannels);
+            out.noalias() = patchRows(inputRow(i), input.channels, kernelCols, outputCols).transpose() * filterRow(filters, 0).transpose();
+            for (int a = 1; a < kernelRows; ++a)
+                out.noalias() += patchRows(inputRow(i + a), input.channels, kernelCols, outputCols).transpose() * filterRow(filters, a).transpose();
+            if constexpr (!doubleOutput)
+                std::transform(buffer.data(), buffer.data() + buffer.size(), output.row(i), saturatePixel<OutputPixel>);
+        }
+    });
+}
+
+/**
+* Convolves an HWC image with a bank of filters, (C_out, kernelRows, kernelCols, C_in), into a new HWC image of C_out channels.
+*/
+inline Tensor3d convolution(const Tensor3d &input, const Tensor4d &filters)
+{
+    validateBank(input.dimension(0), input.dimension(1), input.dimension(2), filters);
+    Tensor3d result(input.dimension(0) - filters.dimension(1) + 1, input.dimension(1) - filters.dimension(2) + 1, filters.dimension(0));
+    convolution(imageView(input), filters, imageView(result));
+    return result;
+}
+
+/**
+* Number of rows of the "wide" output of one image: output pixel (i, j) is row i * cols + j. The rows with j >= outputCols
+* in between belong to patches wrapping around two image rows and are discarded, in exchange every tap row of the bank
+* is a single (length x kernelCols * C_in) * (kernelCols * C_in x C_out) GEMM over the whole image instead of one per output row.
+*/
+inline long wideLength(int cols, int outputRows, int outputCols)
+{
+    return static_cast<long>(outputRows - 1) * cols + outputCols;
+}
+
+/**
+* Valid convolution of one HWC image through the wide output, wide is a scratch buffer reused between images.
+*/
+inline void multichannelImage(const double *input, int rows, int cols, int channels, const Tensor4d &filters, RowMajorMatrix &wide, double *output)
+{
+    const int outputChannels = filters.dimension(0);
+    const int kernelRows = filters.dimension(1);
+    const int kernelCols = filters.dimension(2);
+    const int outputRows = rows - kernelRows + 1;
+    const int outputCols = cols - kernelCols + 1;
+    const long length = wideLength(cols, outputRows, outputCols);
+    wide.resize(length, outputChannels);
+    wide.noalias() = patchRows(input, channels, kernelCols, length).transpose() * filterRow(filters, 0).transpose();
+    for (int a = 1; a < kernelRows; ++a)
+        wide.noalias() += patchRows(input + a * cols * channels, channels, kernelCols, length).transpose() * filterRow(filters, a).transpose();
+    for (int i = 0; i < outputRows; ++i)
+        Eigen::Map<RowMajorMatrix>(output + i * outputCols * outputChannels, outputCols, outputChannels) = wide.middleRows(i * cols, outputCols);
+}
+
+/**
+* Convolves a batch of consecutive HWC images (NHWC), one image per task. Used for batches of small images, where
+* per row products would be too small to keep the GEMM busy.
+*/
+inline void batchConvolution(const double *input, long images, int rows, int cols, int channels, const Tensor4d &filters, double *output)
+{
+    validateBank(rows, cols, channels, filters);
+    const long inputSize = static_cast<long>(rows) * cols * channels;
+    const long outputSize = static_cast<long>(rows - filters.dimension(1) + 1) * (cols - filters.dimension(2) + 1) * filters.dimension(0);
+    parallelFor(0, images, [&](long begin, long end) {
+        RowMajorMatrix wide;
+        for (long image = begin; image < end; ++image)
+            multichannelImage(input + image * inputSize, rows, cols, channels, filters, wide, output + image * outputSize);
+    });
+}
+
+/**
+* Batched version over an NHWC tensor.
+*/
+inline Tensor4d convolution(const Tensor4d &input, const Tensor4d &filters)
+{
+    const int images = input.dimension(0);
+    const int rows = input.dimension(1);
+    const int cols = input.dimension(2);
+    const int channels = input.dimension(3);
+    validateBank(rows, cols, channels, filters);
+
+    Tensor4d result(images, rows - filters.dimension(1) + 1, cols - filters.dimension(2) + 1, filters.dimension(0));
+    batchConvolution(input.data(), images, rows, cols, channels, filters, result.data());
+    return result;
+}
+
+/**
+* Gradient of the cost with respect to the filters given dC, the gradient with respect to the output of convolution(input, filters):
+* dK[o, a, b, c] = sum_ij dC[i, j, o] * input[i + a, j + b, c]. Row a of the bank accumulates (C_out x outputCols) * patchRows^T
+* over the output rows; every thread sums its own rows and the partial gradients are added at the end.
+*/
+inline Tensor4d kernelGradient(const Tensor3d &input, const Tensor3d &dC, int kernelRows, int kernelCols)
+{
+    const int cols = input.dimension(1);
+    const int channels = input.dimension(2);
+    const int outputRows = dC.dimension(0);
+    const int outputCols = dC.dimension(1);
+    const int outputChannels = dC.dimension(2);
+    if (outputRows != input.dimension(0) - kernelRows + 1 || outputCols != cols - kernelCols + 1)
+        throw std::invalid_argument("The gradient does not match the output of the convolution.");
+
+    const int rowSize = kernelCols * channels;
+    const int workers = std::min<long>(numberOfWorkers(), outputRows);
+    std::vector<Tensor4d> partials(workers, Tensor4d(outputChannels, kernelRows, kernelCols, channels));
+    const long chunk = (outputRows + workers - 1) / workers;
+    parallelFor(0, workers, [&](long begin, long end) {
+        for (long worker = begin; worker < end; ++worker)
+        {
+            Tensor4d &partial = partials[worker];
+            partial.setZero();
+            for (long i = worker * chunk; i < std::min<long>(outputRows, (worker + 1) * chunk); ++i)
+            {
+                Eigen::Map<const Matrix> gradient(dC.data() + i * outputCols * outputChannels, outputChannels, outputCols);
+                for (int a = 0; a < kernelRows; ++a)
+                {
+                    StridedRowMajorMap dK(partial.data() + a * rowSize, outputChannels, rowSize, Eigen::OuterStride<>(kernelRows * rowSize));
+                    dK.noalias() += gradient * patchRows(input.data() + (i + a) * cols * channels, channels, kernelCols, outputCols).transpose();
+                }
+            }
+        }
+    });
+
+    Tensor4d result = partials.front();
+    for (int worker = 1; worker < workers; ++worker)
+        result += partials[worker];
+    return result;
+}
+
+/**
+* Copies the gradient of one image, (outputRows, outputCols, C_out) HWC, into the columns of the wide layout (C_out x length).
+* The discarded columns are never written, so they stay at zero from the allocation.
+*/
+inline void toWide(const double *dC, int cols, int outputRows, int outputCols, int outputChannels, Matrix &wide)
+{
+    for (int i = 0; i < outputRows; ++i)
+        wide.middleCols(i * cols, outputCols) = Eigen::Map<const Matrix>(dC + i * outputCols * outputChannels, outputChannels, outputCols);
+}
+
+/**
+* Kernel gradient summed over a batch of NHWC images: with the gradient in the wide layout, tap row a of the bank is one
+* (C_out x length) * (length x kernelCols * C_in) GEMM per image. Images are split among the threads, each one with its own partial sum.
+*/
+inline Tensor4d batchKernelGradient(const double *input, const double *dC, long images, int rows, int cols, int channels, int kernelRows, int kernelCols, int outputChannels)
+{
+    const int outputRows = rows - kernelRows + 1;
+    const int outputCols = cols - kernelCols + 1;
+    const long length = wideLength(cols, outputRows, outputCols);
+    const long inputSize = static_cast<long>(rows) * cols * channels;
+    const long outputSize = static_cast<long>(outputRows) * outputCols * outputChannels;
+    const int rowSize = kernelCols * channels;
+    const int workers = std::min<long>(numberOfWorkers(), images);
+    std::vector<Tensor4d> partials(workers, Tensor4d(outputChannels, kernelRows, kernelCols, channels));
+    const long chunk = (images + workers - 1) / workers;
+    parallelFor(0, workers, [&](long begin, long end) {
+        Matrix wide = Matrix::Zero(outputChannels, length);
+        for (long worker = begin; worker < end; ++worker)
+        {
+            Tensor4d &partial = partials[worker];
+            partial.setZero();
+            for (long image = worker * chunk; image < std::min(images, (worker + 1) * chunk); ++image)
+            {
+                toWide(dC + image * outputSize, cols, outputRows, outputCols, outputChannels, wide);
+                const double *source = input + image * inputSize;
+                for (int a = 0; a < kernelRows; ++a)
+                {
+                    StridedRowMajorMap dK(partial.data() + a * rowSize, outputChannels, rowSize, Eigen::OuterStride<>(kernelRows * rowSize));
+                    dK.noalias() += wide * patchRows(source + a * cols * channels, channels, kernelCols, length).transpose();
+                }
+            }
+        }
+    });
+
+    Tensor4d result = partials.front();
+    for (int worker = 1; worker < workers; ++worker)
+        result += partials[worker];
+    return result;
+}
+
+/**
+* Batched version of kernelGradient over NHWC tensors.
+*/
+inline Tensor4d kernelGradient(const Tensor4d &input, const Tensor4d &dC, int kernelRows, int kernelCols)
+{
+    const int rows = input.dimension(1);
+    const int cols = input.dimension(2);
+    if (dC.dimension(0) != input.dimension(0) || dC.dimension(1) != rows - kernelRows + 1 || dC.dimension(2) != cols - kernelCols + 1)
+        throw std::invalid_argument("The gradient does not match the output of the convolution.");
+    return batchKernelGradient(input.data(), dC.data(), input.dimension(0), rows, cols, input.dimension(3), kernelRows, kernelCols, dC.dimension(3));
+}
+
+/**
+* Gradient of the cost with respect to the input of convolution(input, filters), for a batch of NHWC images of rows x cols:
+* dX[i + a, j + b, c] += sum_o dC[i, j, o] * filters[o, a, b, c]. The whole bank, seen as a (C_out x kernelRows * kernelCols * C_in)
+* row-major matrix, is multiplied by the wide gradient in a single GEMM per image; the C_in values of every tap are then
+* added back to the pixels they were read from (col2im), one contiguous (C_in x length) block per tap.
+*/
+inline void batchInputGradient(const double *dC, long images, int rows, int cols, const Tensor4d &filters, double *dX)
+{
+    const int outputChannels = filters.dimension(0);
+    const int kernelRows = filters.dimension(1);
+    const int kernelCols = filters.dimension(2);
+    const int channels = filters.dimension(3);
+    const int outputRows = rows - kernelRows + 1;
+    const int outputCols = cols - kernelCols + 1;
+    const long length = wideLength(cols, outputRows, outputCols);
+    const long inputSize = static_cast<long>(rows) * cols * channels;
+    const long outputSize = static_cast<long>(outputRows) * outputCols * outputChannels;
+    Eigen::Map<const RowMajorMatrix> bank(filters.data(), outputChannels, kernelRows * kernelCols * channels);
+    parallelFor(0, images, [&](long begin, long end) {
+        Matrix wide = Matrix::Zero(outputChannels, length);
+        RowMajorMatrix taps(length, bank.cols());
+        for (long image = begin; image < end; ++image)
+        {
+            toWide(dC + image * outputSize, cols, outputRows, outputCols, outputChannels, wide);
+            taps.noalias() = wide.transpose() * bank;
+            double *gradient = dX + image * inputSize;
+            std::fill(gradient, gradient + inputSize, 0.0);
+            for (int a = 0; a < kernelRows; ++a)
+                for (int b = 0; b < kernelCols; ++b)
+                    Eigen::Map<Matrix>(gradient + (a * cols + b) * channels, channels, length) += taps.middleCols((a * kernelCols + b) * channels, channels).transpose();
+        }
+    });
+}
+
+/**
+* Single image version of batchInputGradient.
+*/
+inline Tensor3d inputGradient(const Tensor3d &dC, const Tensor4d &filters)
+{
+    if (dC.dimension(2) != filters.dimension(0))
+        throw std::invalid_argument("The gradient does not match the output of the convolution.");
+    const int rows = dC.dimension(0) + filters.dimension(1) - 1;
+    const int cols = dC.dimension(1) + filters.dimension(2) - 1;
+    Tensor3d result(rows, cols, filters.dimension(3));
+    batchInputGradient(dC.data(), 1, rows, cols, filters, result.data());
+    return result;
+}
+
+/**
+* Depthwise kernels are (kernelRows, kernelCols, channels), one kernel per channel: the channels of a tap are
+* contiguous like those of an HWC pixel, so tap (a, b) is column a * kernelCols + b of a (channels x taps) matrix.
+*/
+inline void validateDepthwise(int rows, int cols, int channels, const Tensor3d &kernels)
+{
+    if (kernels.dimension(2) != channels || kernels.dimension(0) > rows || kernels.dimension(1) > cols)
+    {
+        std::stringstream ss;
+        ss << "A " << kernels.dimension(0) << "x" << kernels.dimension(1) << "x" << kernels.dimension(2);
+        ss << " depthwise kernel does not fit a " << rows << "x" << cols << "x" << channels << " image.";
+        throw std::invalid_argument(ss.str());
+    }
+}
+
+/**
+* Taps of the depthwise kernels repeated for the outputCols pixels of an output row, (outputCols * channels x taps):
+* in HWC a row of output pixels times a tap is then one contiguous element-wise product of outputCols * channels values.
+*/
+inline Matrix depthwiseRuns(const Tensor3d &kernels, int outputCols)
+{
+    return Eigen::Map<const Matrix>(kernels.data(), kernels.dimension(2), kernels.dimension(0) * kernels.dimension(1)).replicate(outputCols, 1);
+}
+
+/**
+* Valid depthwise convolution of one HWC image: every channel is convolved with its own kernel, no sum over the
+* channels. An output row is the sum over the taps of the run of input pixels under the tap times the tap repeated by
+* depthwiseRuns: kernelRows * kernelCols products per output value instead of kernelRows * kernelCols * C_in.
+*/
+inline void depthwiseImage(const double *input, int rows, int cols, int channels, int kernelRows, const Matrix &runs, double *output)
+{
+    const int kernelCols = runs.cols() / kernelRows;
+    const long run = runs.rows();
+    for (int i = 0; i <= rows - kernelRows; ++i)
+    {
+        Eigen::Map<Eigen::ArrayXd> row(output + i * run, run);
+        row.setZero();
+        for (int tap = 0; tap < runs.cols(); ++tap)
+            row += Eigen::Map<const Eigen::ArrayXd>(input + (static_cast<long>(i + tap / kernelCols) * cols + tap % kernelCols) * channels, run) * runs.col(tap).array();
+    }
+}
+
+/**
+* Depthwise convolution of a batch of consecutive HWC images (NHWC), one image per task.
+*/
+inline void batchDepthwiseConvolution(const double *input, long images, int rows, int cols, int channels, const Tensor3d &kernels, double *output)
+{
+    validateDepthwise(rows, cols, channels, kernels);
+    const int outputCols = cols - kernels.dimension(1) + 1;
+    const long inputSize = static_cast<long>(rows) * cols * channels;
+    const long outputSize = static_cast<long>(rows - kernels.dimension(0) + 1) * outputCols * channels;
+    const Matrix runs = depthwiseRuns(kernels, outputCols);
+    parallelFor(0, images, [&](long begin, long end) {
+        for (long image = begin; image < end; ++image)
+            depthwiseImage(input + image * inputSize, rows, cols, channels, kernels.dimension(0), runs, output + image * outputSize);
+    });
+}
+
+/**
+* Convolves every channel of an HWC image with its kernel of (kernelRows, kernelCols, channels) into a new HWC image.
+*/
+inline Tensor3d depthwiseConvolution(const Tensor3d &input, const Tensor3d &kernels)
+{
+    Tensor3d result(input.dimension(0) - kernels.dimension(0) + 1, input.dimension(1) - kernels.dimension(1) + 1, input.dimension(2));
+    batchDepthwiseConvolution(input.data(), 1, input.dimension(0), input.dimension(1), input.dimension(2), kernels, result.data());
+    return result;
+}
+
+inline void validatePointwise(int channels, const Matrix &weights)
+{
+    if (weights.cols() != channels)
+    {
+        std::stringstream ss;
+        ss << "A " << weights.rows() << "x" << weights.cols() << " pointwise convolution does not fit an image of " << channels << " channels.";
+        throw std::invalid_argument(ss.str());
+    }
+}
+
+/**
+* 1x1 convolution mixing the channels of every pixel with a (C_out x C_in) matrix: the HWC image is a (C_in x pixels)
+* matrix, so the whole image is a single GEMM.
+*/
+inline Tensor3d pointwiseConvolution(const Tensor3d &input, const Matrix &weights)
+{
+    validatePointwise(input.dimension(2), weights);
+    Tensor3d result(input.dimension(0), input.dimension(1), weights.rows());
+    const long pixels = static_cast<long>(input.dimension(0)) * input.dimension(1);
+    Eigen::Map<Matrix>(result.data(), weights.rows(), pixels).noalias() = weights * Eigen::Map<const Matrix>(input.data(), input.dimension(2), pixels);
+    return result;
+}
+
+/**
+* Depthwise-separable convolution: the depthwise convolution followed by the pointwise one. With the same C_out outputs
+* as a dense kernelRows x kernelCols x C_in bank, it costs kernelRows * kernelCols * C_in + C_in * C_out products per
+* pixel instead of kernelRows * kernelCols * C_in * C_out, about kernelRows * kernelCols times less when C_out is large.
+* The two are fused a row at a time: the depthwise row stays in cache for the (C_out x C_in) * (C_in x outputCols) GEMM
+* instead of making a round trip to memory through a whole intermediate image. Output rows are split among the threads.
+*/
+inline Tensor3d separableConvolution(const Tensor3d &input, const Tensor3d &depthwise, const Matrix &pointwise)
+{
+    const int rows = input.dimension(0);
+    const int cols = input.dimension(1);
+    const int channels = input.dimension(2);
+    validateDepthwise(rows, cols, channels, depthwise);
+    validatePointwise(channels, pointwise);
+    const int kernelRows = depthwise.dimension(0);
+    const int outputCols = cols - depthwise.dimension(1) + 1;
+    Tensor3d result(rows - kernelRows + 1, outputCols, pointwise.rows());
+    const Matrix runs = depthwiseRuns(depthwise, outputCols);
+    parallelFor(0, result.dimension(0), [&](long begin, long end) {
+        Matrix row(channels, outputCols);
+        for (long i = begin; i < end; ++i)
+        {
+            depthwiseImage(input.data() + i * cols * channels, kernelRows, cols, channels, kernelRows, runs, row.data());
+            Eigen::Map<Matrix>(result.data() + i * outputCols * pointwise.rows(), pointwise.rows(), outputCols).noalias() = pointwise * row;
+        }
+    });
+    return result;
+}
+
+/**
+* Gradient of the cost with respect to the depthwise kernels given dC, the gradient with respect to the output of the
+* depthwise convolution of a batch of NHWC images: dK[a, b, c] = sum_ij dC[i, j, c] * input[i + a, j + b, c].
+* The products are summed per tap over whole output rows, and the pixels of the rows are folded into their channels at
+* the end. Images are split among the threads, each one with its own partial sum.
+*/
+inline Tensor3d batchDepthwiseKernelGradient(const double *input, const double *dC, long images, int rows, int cols, int channels, int kernelRows, int kernelCols)
+{
+    const int outputRows = rows - kernelRows + 1;
+    const int outputCols = cols - kernelCols + 1;
+    const long run = static_cast<long>(outputCols) * channels;
+    const long inputSize = static_cast<long>(rows) * cols * channels;
+    const long outputSize = outputRows * run;
+    const int workers = std::min<long>(numberOfWorkers(), images);
+    std::vector<Matrix> partials(workers, Matrix::Zero(run, kernelRows * kernelCols));
+    const long chunk = (images + workers - 1) / workers;
+    parallelFor(0, workers, [&](long begin, long end) {
+        for (long worker = begin; worker < end; ++worker)
+        {
+            Matrix &partial = partials[worker];
+            for (long image = worker * chunk; image < std::min(images, (worker + 1) * chunk); ++image)
+            {
+                for (int i = 0; i < outputRows; ++i)
+                {
+                    Eigen::Map<const Eigen::ArrayXd> gradient(dC + image * outputSize + i * run, run);
+                    for (int tap = 0; tap < partial.cols(); ++tap)
+                        partial.col(tap).array() += gradient * Eigen::Map<const Eigen::ArrayXd>(input + image * inputSize + (static_cast<long>(i + tap / kernelCols) * cols + tap % kernelCols) * channels, run);
+                }
+            }
+        }
+    });
+
+    for (int worker = 1; worker < workers; ++worker)
+        partials.front() += partials[worker];
+    Tensor3d result(kernelRows, kernelCols, channels);
+    Eigen::Map<Matrix> sum(result.data(), channels, kernelRows * kernelCols);
+    for (int tap = 0; tap < sum.cols(); ++tap)
+        sum.col(tap) = Eigen::Map<const Matrix>(partials.front().col(tap).data(), channels, outputCols).rowwise().sum();
+    return result;
+}
+
+/**
+* Gradient of the cost with respect to the input of the depthwise convolution of a batch of NHWC images of rows x cols:
+* dX[i + a, j + b, c] += dC[i, j, c] * kernels[a, b, c], every output row times a tap added back to the run of pixels
+* it was read from.
+*/
+inline void batchDepthwiseInputGradient(const double *dC, long images, int rows, int cols, const Tensor3d &kernels, double *dX)
+{
+    const int kernelCols = kernels.dimension(1);
+    const int channels = kernels.dimension(2);
+    const int outputRows = rows - kernels.dimension(0) + 1;
+    const int outputCols = cols - kernelCols + 1;
+    const long run = static_cast<long>(outputCols) * channels;
+    const long inputSize = static_cast<long>(rows) * cols * channels;
+    const long outputSize = outputRows * run;
+    const Matrix runs = depthwiseRuns(kernels, outputCols);
+    parallelFor(0, images, [&](long begin, long end) {
+        for (long image = begin; image < end; ++image)
+        {
+            double *gradient = dX + image * inputSize;
+            std::fill(gradient, gradient + inputSize, 0.0);
+            for (int i = 0; i < outputRows; ++i)
+            {
+                Eigen::Map<const Eigen::ArrayXd> row(dC + image * outputSize + i * run, run);
+                for (int tap = 0; tap < runs.cols(); ++tap)
+                    Eigen::Map<Eigen::ArrayXd>(gradient + (static_cast<long>(i + tap / kernelCols) * cols + tap % kernelCols) * channels, run) += row * runs.col(tap).array();
+            }
+        }
+    });
+}
+
+} // namespace ann
+
+#endif
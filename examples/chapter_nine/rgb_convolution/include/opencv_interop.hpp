@@ -0,0 +1,122 @@
+#ifndef OPENCV_INTEROP_H_
+#define OPENCV_INTEROP_H_
+
+#include <sstream>
+#include <stdexcept>
+
+#include <opencv2/core.hpp>
+
+#include "multichannel_convolution.hpp"
+
+namespace ann
+{
+
+/**
+* OpenCV depth of the pixel types of the views.
+*/
+template <typename Pixel>
+constexpr int pixelDepth();
+template <>
+constexpr int pixelDepth<unsigned char>()
+{
+    return CV_8U;
+}
+template <>
+constexpr int pixelDepth<float>()
+{
+    return CV_32F;
+}
+template <>
+constexpr int pixelDepth<double>()
+{
+    return CV_64F;
+}
+
+template <typename Pixel>
+inline void checkDepth(const cv::Mat &image)
+{
+    if (image.depth() != pixelDepth<Pixel>() || image.step[0] % sizeof(Pixel) != 0)
+    {
+        std::stringstream ss;
+        ss << "A cv::Mat of depth " << image.depth() << " can't be viewed as pixels of depth " << pixelDepth<Pixel>() << ".";
+        throw std::invalid_argument(ss.str());
+    }
+}
+
+/**
+* HWC view of the pixels of a cv::Mat, regions of interest included: the interleaved channels of OpenCV are the HWC
+* layout of the tensors and the step of the rows becomes the stride. Nothing is copied, the view writes into the Mat.
+*/
+template <typename Pixel>
+inline ImageView<Pixel> imageView(cv::Mat &image)
+{
+    checkDepth<Pixel>(image);
+    return {image.ptr<Pixel>(), image.rows, image.cols, image.channels(), static_cast<long>(image.step[0] / sizeof(Pixel))};
+}
+
+template <typename Pixel>
+inline ImageView<const Pixel> imageView(const cv::Mat &image)
+{
+    checkDepth<Pixel>(image);
+    return {image.ptr<Pixel>(), image.rows, image.cols, image.channels(), static_cast<long>(image.step[0] / sizeof(Pixel))};
+}
+
+template <typename Pixel>
+using MatMap = Eigen::Map<Eigen::Matrix<Pixel, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>, 0, Eigen::OuterStride<>>;
+template <typename Pixel>
+using ConstMatMap = Eigen::Map<const Eigen::Matrix<Pixel, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>, 0, Eigen::OuterStride<>>;
+
+/**
+* Eigen view of a cv::Mat as a row-major (rows x cols * channels) matrix, with the step of the rows as outer stride.
+* view.cast<double>() widens an 8-bit image in a single pass.
+*/
+template <typename Pixel>
+inline MatMap<Pixel> matrixView(cv::Mat &image)
+{
+    const ImageView<Pixel> view = imageView<Pixel>(image);
+    return MatMap<Pixel>(view.data, view.rows, view.cols * view.channels, Eigen::OuterStride<>(view.stride));
+}
+
+template <typename Pixel>
+inline ConstMatMap<Pixel> matrixView(const cv::Mat &image)
+{
+    const ImageView<const Pixel> view = imageView<Pixel>(image);
+    return ConstMatMap<Pixel>(view.data, view.rows, view.cols * view.channels, Eigen::OuterStride<>(view.stride));
+}
+
+/**
+* Tensor view of a cv::Mat of doubles, which has to be continuous: TensorMap has no strides.
+*/
+inline Eigen::TensorMap<Tensor3d> tensorView(cv::Mat &image)
+{
+    checkDepth<double>(image);
+    if (!image.isContinuous())
+        throw std::invalid_argument("Only continuous cv::Mat can be viewed as a tensor, use imageView for the others.");
+    return Eigen::TensorMap<Tensor3d>(image.ptr<double>(), image.rows, image.cols, image.channels());
+}
+
+/**
+* The other way: a cv::Mat header over the pixels of a view, sharing them, so that OpenCV functions read or write
+* a tensor in place (convertTo into the header of a tensor of the same size fills the tensor).
+* The headers of const data must only be read.
+*/
+template <typename Pixel>
+inline cv::Mat matHeader(const ImageView<Pixel> &view)
+{
+    using Value = std::remove_const_t<Pixel>;
+    return cv::Mat(view.rows, view.cols, CV_MAKETYPE(pixelDepth<Value>(), view.channels), const_cast<Value *>(view.data), view.stride * sizeof(Value));
+}
+
+inline cv::Mat matHeader(Tensor3d &image)
+{
+    return matHeader(imageView(image));
+}
+
+inline cv::Mat matHeader(const Tensor3d &image)
+{
+    return matHeader(imageView(image));
+}
+
+} // namespace ann
+
+#endif
@@ -0,0 +1,496 @@
+#ifndef TENSOR_LAYOUT_H_
+#define TENSOR_LAYOUT_H_
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "multichannel_convolution.hpp"
+
+namespace ann
+{
+
+/**
+* Memory layouts of an image: HWC, the channels of a pixel contiguous (Tensor3d, OpenCV); CHW, one plane per channel;
+* and nChw8c, the channels cut into blocks of channelBlock, each block an HWC image of channelBlock channels, the last
+* one padded with zeros. A block of a pixel is one SIMD register of 8 doubles (AVX-512) or two (AVX).
+*/
+enum class Layout
+{
+    HWC,
+    CHW,
+    Blocked
+};
+
+const int channelBlock = 8;
+const Layout allLayouts[] = {Layout::HWC, Layout::CHW, Layout::Blocked};
+
+inline const char *layoutName(Layout layout)
+{
+    switch (layout)
+    {
+    case Layout::HWC:
+        return "HWC";
+    case Layout::CHW:
+        return "CHW";
+    case Layout::Blocked:
+        return "nChw8c";
+    }
+    return "unknown";
+}
+
+inline int channelBlocks(int channels)
+{
+    return (channels + channelBlock - 1) / channelBlock;
+}
+
+using ChannelMap = Eigen::Map<Matrix, 0, Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>>;
+using ConstChannelMap = Eigen::Map<const Matrix, 0, Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>>;
+
+/**
+* Image of rows x cols pixels of channels values in an explicit layout. The padding channels of nChw8c are zeros
+* and every function keeps them at zero.
+*/
+struct LayoutTensor
+{
+    Layout layout = Layout::HWC;
+    int rows = 0;
+    int cols = 0;
+    int channels = 0;
+    Vector data;
+
+    LayoutTensor() {}
+    LayoutTensor(Layout layout, int rows, int cols, int channels) :
+        layout(layout), rows(rows), cols(cols), channels(channels), data(Vector::Zero(storedChannels() * pixels())) {}
+
+    long pixels() const
+    {
+        return static_cast<long>(rows) * cols;
+    }
+
+    /**
+    * Gives the tensor that shape, keeping its storage when it already has it: a buffer reused between calls is only
+    * allocated (and zeroed) once.
+    */
+    void reshape(Layout layout, int rows, int cols, int channels)
+    {
+        if (this->layout != layout || this->rows != rows || this->cols != cols || this->channels != channels || data.size() == 0)
+            *this = LayoutTensor(layout, rows, cols, channels);
+    }
+
+    int storedChannels() const
+    {
+        return layout == Layout::Blocked ? channelBlocks(channels) * channelBlock : channels;
+    }
+
+    long index(int i, int j, int c) const
+    {
+        switch (layout)
+        {
+        case Layout::HWC:
+            return (static_cast<long>(i) * cols + j) * channels + c;
+        case Layout::CHW:
+            return (static_cast<long>(c) * rows + i) * cols + j;
+        default:
+            return ((static_cast<long>(c / channelBlock) * rows + i) * cols + j) * channelBlock + c % channelBlock;
+        }
+    }
+
+    double operator()(int i, int j, int c) const
+    {
+        return data[index(i, j, c)];
+    }
+
+    /**
+    * Channels [first, first + count) of every pixel, in row-major pixel order, as the columns of a (pixels x count)
+    * matrix whatever the layout:
+    * HWC is the row-major (pixels x channels) matrix, CHW the column-major one and a block of nChw8c a row-major
+    * (pixels x channelBlock) one, so count channels must not cross a block there.
+    */
+    ConstChannelMap channelColumns(int first, int count) const
+    {
+        const double *base = data.data() + index(0, 0, first);
+        switch (layout)
+        {
+        case Layout::HWC:
+            return ConstChannelMap(base, pixels(), count, Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(1, channels));
+        case Layout::CHW:
+            return ConstChannelMap(base, pixels(), count, Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(pixels(), 1));
+        default:
+            return ConstChannelMap(base, pixels(), count, Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(1, channelBlock));
+        }
+    }
+
+    ChannelMap channelColumns(int first, int count)
+    {
+        ConstChannelMap view = static_cast<const LayoutTensor &>(*this).channelColumns(first, count);
+        return ChannelMap(const_cast<double *>(view.data()), view.rows(), view.cols(), Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(view.outerStride(), view.innerStride()));
+    }
+};
+
+/**
+* Copies image into result in another layout, a block of channels at a time through channelColumns.
+*/
+inline void convertLayout(const LayoutTensor &image, Layout layout, LayoutTensor &result)
+{
+    result.reshape(layout, image.rows, image.cols, image.channels);
+    if (image.layout == layout)
+    {
+        result.data = image.data;
+        return;
+    }
+    for (int first = 0; first < image.channels; first += channelBlock)
+    {
+        const int count = std::min(channelBlock, image.channels - first);
+        const ConstChannelMap from = image.channelColumns(first, count);
+        ChannelMap to = result.channelColumns(first, count);
+        const double *source = from.data();
+        double *destination = to.data();
+        const long fromPixel = from.innerStride(), fromChannel = from.outerStride();
+        const long toPixel = to.innerStride(), toChannel = to.outerStride();
+        // walk the destination in memory order: down the planes of CHW, a run of pixels at a time so that the
+        // source lines stay in cache for all the channels; along the pixels otherwise
+        if (layout == Layout::CHW)
+        {
+            const long run = 256;
+            for (long begin = 0; begin < image.pixels(); begin += run)
+                for (int c = 0; c < count; ++c)
+                    for (long p = begin; p < std::min(image.pixels(), begin + run); ++p)
+                        destination[c * toChannel + p] = source[p * fromPixel + c * fromChannel];
+        }
+        else
+        {
+            for (long p = 0; p < image.pixels(); ++p)
+                for (int c = 0; c < count; ++c)
+                    destination[p * toPixel + c] = source[p * fromPixel + c * fromChannel];
+        }
+    }
+}
+
+inline LayoutTensor convertLayout(const LayoutTensor &image, Layout layout)
+{
+    if (image.layout == layout)
+        return image;
+    LayoutTensor result;
+    convertLayout(image, layout, result);
+    return result;
+}
+
+inline LayoutTensor toLayout(const Tensor3d &image, Layout layout)
+{
+    LayoutTensor hwc(Layout::HWC, image.dimension(0), image.dimension(1), image.dimension(2));
+    std::copy(image.data(), image.data() + image.size(), hwc.data.data());
+    return convertLayout(hwc, layout);
+}
+
+inline Tensor3d toTensor3d(const LayoutTensor &image)
+{
+    const LayoutTensor hwc = convertLayout(image, Layout::HWC);
+    Tensor3d result(image.rows, image.cols, image.channels);
+    std::copy(hwc.data.data(), hwc.data.data() + hwc.data.size(), result.data());
+    return result;
+}
+
+/**
+* Filter bank repacked for nChw8c, (output blocks, kernelRows, kernelCols, input channels padded to a block,
+* channelBlock): the weights of a tap and input channel for the channelBlock outputs of a block are one packet.
+*/
+struct BlockedFilters
+{
+    int outputBlocks;
+    int kernelRows;
+    int kernelCols;
+    int inputChannels;
+    Vector data;
+
+    explicit BlockedFilters(const Tensor4d &filters) :
+        outputBlocks(channelBlocks(filters.dimension(0))), kernelRows(filters.dimension(1)), kernelCols(filters.dimension(2)),
+        inputChannels(channelBlocks(filters.dimension(3)) * channelBlock)
+    {
+        data = Vector::Zero(static_cast<long>(outputBlocks) * kernelRows * kernelCols * inputChannels * channelBlock);
+        for (int o = 0; o < filters.dimension(0); ++o)
+            for (int a = 0; a < kernelRows; ++a)
+                for (int b = 0; b < kernelCols; ++b)
+                    for (int c = 0; c < filters.dimension(3); ++c)
+                        data[tap(o / channelBlock, a, b, c) + o % channelBlock] = filters(o, a, b, c);
+    }
+
+    long tap(int outputBlock, int a, int b, int c) const
+    {
+        return ((static_cast<long>(outputBlock) * kernelRows + a) * kernelCols + b) * inputChannels * channelBlock + c * channelBlock;
+    }
+};
+
+using ChannelPacket = Eigen::Array<double, channelBlock, 1>;
+// output pixels computed together by the nChw8c kernel: enough independent accumulators to hide the FMA latency
+const int blockedPixelRun = 8;
+
+/**
+* Pixels output pixels of one output block from (i, j): every input value is broadcast and multiplied by the packet of
+* the weights of the channelBlock outputs, the Pixels accumulators stay in registers for the whole reduction.
+*/
+template <int Pixels>
+inline void blockedPixels(const LayoutTensor &input, const BlockedFilters &filters, int outputBlock, int i, int j, double *output)
+{
+    ChannelPacket accumulator[Pixels];
+    for (int t = 0; t < Pixels; ++t)
+        accumulator[t].setZero();
+    for (int inputBlock = 0; inputBlock < filters.inputChannels / channelBlock; ++inputBlock)
+    {
+        for (int a = 0; a < filters.kernelRows; ++a)
+        {
+            const double *row = input.data.data() + input.index(i + a, j, inputBlock * channelBlock);
+            for (int b = 0; b < filters.kernelCols; ++b)
+            {
+                const double *weights = filters.data.data() + filters.tap(outputBlock, a, b, inputBlock * channelBlock);
+                for (int c = 0; c < channelBlock; ++c)
+                {
+                    const ChannelPacket weight = Eigen::Map<const ChannelPacket>(weights + c * channelBlock);
+                    for (int t = 0; t < Pixels; ++t)
+                        accumulator[t] += row[(t + b) * channelBlock + c] * weight;
+                }
+            }
+        }
+    }
+    for (int t = 0; t < Pixels; ++t)
+        Eigen::Map<ChannelPacket>(output + t * channelBlock) = accumulator[t];
+}
+
+/**
+* Valid convolution of an image in any layout with a bank of filters, (C_out, kernelRows, kernelCols, C_in), into an
+* image of C_out channels in the same layout, output rows split among the hardware threads:
+* HWC is the GEMM per output row of the Tensor3d convolution, best when the channels are few;
+* CHW adds every tap of every (output, input) channel pair to an output row as a scaled input row, vectorized along
+* the row, which stays in cache but is reloaded once per tap and input channel;
+* nChw8c computes channelBlock outputs at once by packets, blockedPixelRun pixels at a time, every input value loaded once per tap
+* for the whole block. blocked are the filters already packed for nChw8c, packed here when missing.
+* result is reshaped, its storage kept when it already has the shape of the output.
+*/
+inline void convolution(const LayoutTensor &input, const Tensor4d &filters, LayoutTensor &result, const BlockedFilters *blocked = nullptr)
+{
+    validateBank(input.rows, input.cols, input.channels, filters);
+    const int outputChannels = filters.dimension(0);
+    const int kernelRows = filters.dimension(1);
+    const int kernelCols = filters.dimension(2);
+    result.reshape(input.layout, input.rows - kernelRows + 1, input.cols - kernelCols + 1, outputChannels);
+    const int outputCols = result.cols;
+
+    if (input.layout == Layout::HWC)
+    {
+        const ImageView<const double> source{input.data.data(), input.rows, input.cols, input.channels, static_cast<long>(input.cols) * input.channels};
+        const ImageView<double> destination{result.data.data(), result.rows, result.cols, outputChannels, static_cast<long>(outputCols) * outputChannels};
+        convolution(source, filters, destination);
+    }
+    else if (input.layout == Layout::CHW)
+    {
+        parallelFor(0, result.rows, [&](long begin, long end) {
+            for (long i = begin; i < end; ++i)
+            {
+                for (int o = 0; o < outputChannels; ++o)
+                {
+                    Eigen::Map<Eigen::RowVectorXd> out(result.data.data() + result.index(i, 0, o), outputCols);
+                    out.setZero();
+                    for (int c = 0; c < input.channels; ++c)
+                        for (int a = 0; a < kernelRows; ++a)
+                            for (int b = 0; b < kernelCols; ++b)
+                                out += filters(o, a, b, c) * Eigen::Map<const Eigen::RowVectorXd>(input.data.data() + input.index(i + a, b, c), outputCols);
+                }
+            }
+        });
+    }
+    else
+    {
+        std::unique_ptr<BlockedFilters> owned;
+        if (!blocked)
+        {
+            owned.reset(new BlockedFilters(filters));
+            blocked = owned.get();
+        }
+        const BlockedFilters &packed = *blocked;
+        parallelFor(0, result.rows, [&](long begin, long end) {
+            for (long i = begin; i < end; ++i)
+            {
+                for (int outputBlock = 0; outputBlock < packed.outputBlocks; ++outputBlock)
+                {
+                    double *out = result.data.data() + result.index(i, 0, outputBlock * channelBlock);
+                    int j = 0;
+                    for (; j + blockedPixelRun <= outputCols; j += blockedPixelRun)
+                        blockedPixels<blockedPixelRun>(input, packed, outputBlock, i, j, out + j * channelBlock);
+                    for (; j < outputCols; ++j)
+                        blockedPixels<1>(input, packed, outputBlock, i, j, out + j * channelBlock);
+                }
+            }
+        });
+    }
+}
+
+inline LayoutTensor convolution(const LayoutTensor &input, const Tensor4d &filters, const BlockedFilters *blocked = nullptr)
+{
+    LayoutTensor result;
+    convolution(input, filters, result, blocked);
+    return result;
+}
+
+/**
+* A chain of convolutions and ReLUs run in a single layout: the input is converted into it at the start and the
+* result out of it at the end, the graph boundaries, and never in between. plan times every node in every layout
+* on a crop of the input (up to planSize x planSize pixels) and picks the cheapest layout for the whole chain,
+* conversions included; the time of a crop is scaled to the whole image by the number of output pixels.
+*/
+class LayoutGraph
+{
+
+private:
+    struct Node
+    {
+        bool relu;
+        Tensor4d filters;
+        std::shared_ptr<BlockedFilters> blocked;
+    };
+
+    std::vector<Node> nodes;
+
+    template <typename Function>
+    static double bestSeconds(Function fnc, int repetitions = 3)
+    {
+        double best = std::numeric_limits<double>::max();
+        for (int r = 0; r < repetitions; ++r)
+        {
+            auto start = std::chrono::steady_clock::now();
+            fnc();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+
+public:
+    static const int planSize = 64;
+
+    /**
+    * The layout of the graph and the estimated seconds of a whole image run in every layout, conversions included.
+    */
+    struct Plan
+    {
+        Layout layout;
+        double seconds[3];
+    };
+
+    LayoutGraph &convolution(const Tensor4d &filters)
+    {
+        nodes.push_back({false, filters, std::make_shared<BlockedFilters>(filters)});
+        return *this;
+    }
+
+    LayoutGraph &relu()
+    {
+        nodes.push_back({true, Tensor4d(), nullptr});
+        return *this;
+    }
+
+    Plan plan(const LayoutTensor &input, Layout output) const
+    {
+        const int rows = std::min(input.rows, planSize);
+        const int cols = std::min(input.cols, planSize);
+        LayoutTensor crop(input.layout, rows, cols, input.channels);
+        for (int first = 0; first < input.channels; first += channelBlock)
+        {
+            const int count = std::min(channelBlock, input.channels - first);
+            for (int i = 0; i < rows; ++i)
+                crop.channelColumns(first, count).middleRows(static_cast<long>(i) * cols, cols) = input.channelColumns(first, count).middleRows(static_cast<long>(i) * input.cols, cols);
+        }
+
+        Plan result{Layout::HWC, {0.0, 0.0, 0.0}};
+        for (Layout layout : allLayouts)
+        {
+            double &seconds = result.seconds[static_cast<int>(layout)];
+            LayoutTensor image;
+            long pixels = input.pixels();
+            int outputRows = input.rows, outputCols = input.cols;
+            // the buffers are reused as in run: the best time leaves the allocations out
+            const double convertSeconds = bestSeconds([&]() { convertLayout(crop, layout, image); });
+            if (layout != input.layout)
+                seconds += convertSeconds * pixels / crop.pixels();
+            for (const auto &node : nodes)
+            {
+                LayoutTensor next;
+                const double cropSeconds = bestSeconds([&]() {
+                    if (node.relu)
+                    {
+                        next.reshape(image.layout, image.rows, image.cols, image.channels);
+                        next.data = image.data.cwiseMax(0.0);
+                    }
+                    else
+                        ann::convolution(image, node.filters, next, node.blocked.get());
+                });
+                if (!node.relu)
+                {
+                    outputRows -= node.filters.dimension(1) - 1;
+                    outputCols -= node.filters.dimension(2) - 1;
+                }
+                pixels = static_cast<long>(outputRows) * outputCols;
+                seconds += cropSeconds * pixels / std::max(1L, next.pixels());
+                image = std::move(next);
+            }
+            LayoutTensor converted;
+            seconds += bestSeconds([&]() { convertLayout(image, output, converted); }) * pixels / std::max(1L, image.pixels());
+            if (seconds < result.seconds[static_cast<int>(result.layout)])
+                result.layout = layout;
+        }
+        return result;
+    }
+
+    /**
+    * Images of a run, the converted input and the output of every convolution, kept between the runs so that they
+    * are only allocated once: the valid convolutions shrink the image, so buffers shared between nodes of different
+    * sizes would be reallocated every time.
+    */
+    struct Workspace
+    {
+        std::vector<LayoutTensor> buffers;
+    };
+
+    /**
+    * Runs the graph in the layout of plan, converting the input into it and the result into output. The ReLUs run
+    * in place on the output of the node before them.
+    */
+    void run(const LayoutTensor &input, const Plan &plan, Layout output, LayoutTensor &result, Workspace &workspace) const
+    {
+        workspace.buffers.resize(nodes.size() + 1);
+        // the input is read in place when it is already in the layout of the plan, until a node writes a buffer
+        const LayoutTensor *source = &input;
+        LayoutTensor *owned = nullptr;
+        if (input.layout != plan.layout || (!nodes.empty() && nodes.front().relu))
+        {
+            convertLayout(input, plan.layout, workspace.buffers[0]);
+            source = owned = &workspace.buffers[0];
+        }
+        for (size_t k = 0; k < nodes.size(); ++k)
+        {
+            if (nodes[k].relu)
+                owned->data = owned->data.cwiseMax(0.0);
+            else
+            {
+                ann::convolution(*source, nodes[k].filters, workspace.buffers[k + 1], nodes[k].blocked.get());
+                source = owned = &workspace.buffers[k + 1];
+            }
+        }
+        convertLayout(*source, output, result);
+    }
+
+    LayoutTensor run(const LayoutTensor &input, const Plan &plan, Layout output) const
+    {
+        LayoutTensor result;
+        Workspace workspace;
+        run(input, plan, output, result, workspace);
+        return result;
+    }
+};
+
+} // namespace ann
+
+#endif
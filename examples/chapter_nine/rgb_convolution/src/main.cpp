@@ -3,30 +3,36 @@
 #include <exception>
 #include <string>
 #include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <limits>
 
 #include "matrix_definitions.hpp"
+#include "kernel_optimizers.hpp"
+#include "multichannel_convolution.hpp"
+#include "opencv_interop.hpp"
+#include "tensor_layout.hpp"
+#include "training_monitor.hpp"
 
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/highgui/highgui.hpp>
-#include <opencv2/core/eigen.hpp> 
-
-#include <unsupported/Eigen/CXX11/Tensor>
-
-using Tensor3d = Eigen::Tensor<double, 3, Eigen::RowMajor>;
 
+/**
+* Widens the 8-bit pixels in one pass, straight into the tensor through a header over its data.
+*/
 Tensor3d convertToTensor3d(const cv::Mat &image)
 {
-    const int rows = image.rows;
-    const int cols = image.cols;
-    cv::Mat reshaped = image.reshape(1, 3*cols*rows);
-    Matrix temp;
-    cv::cv2eigen(reshaped, temp);
-    Tensor3d result = Eigen::TensorMap<Tensor3d>(temp.data(), rows, cols, 3);
+    Tensor3d result(image.rows, image.cols, image.channels());
+    cv::Mat header = ann::matHeader(result);
+    image.convertTo(header, CV_64F);
     return result;
 }
 
-void show(const cv::Mat &source, const cv::Mat &groundTruth, const cv::Mat &convoluted)
+/**
+* Source, ground truth and current output side by side
+*/
+cv::Mat snapshot(const cv::Mat &source, const cv::Mat &groundTruth, const cv::Mat &convoluted)
 {
     int maxHeight = std::max(std::max(source.rows, groundTruth.rows), convoluted.rows);
     int width = source.cols + groundTruth.cols + convoluted.cols;
@@ -53,108 +59,186 @@ void show(const cv::Mat &source, const cv::Mat &groundTruth, const cv::Mat &conv
     } else
         convoluted_rgb = convoluted;
     convoluted_rgb.copyTo(convoluted_roi);
-    cv::namedWindow("", cv::WindowFlags::WINDOW_AUTOSIZE);
-    cv::imshow("", toShow);
+    return toShow;
+}
+
+/**
+* Rounds the convolution to 8-bit pixels in one pass, reading the tensor through a header.
+*/
+void toImage(const Tensor3d &convoluted, cv::Mat &dest)
+{
+    ann::matHeader(convoluted).convertTo(dest, CV_8U);
 }
 
-Tensor3d convolution(const Tensor3d &input, const Tensor3d &filter)
+/**
+* Convolution read straight from the 8-bit pixels of the image.
+*/
+Tensor3d imageConvolution(const cv::Mat &image, cv::Mat &dest, const Tensor4d &filter)
 {
-    int filterRows = filter.dimension(0);
-    int filterCols = filter.dimension(1);
-    int filterChannels = filter.dimension(2);
-    int rows = input.dimension(0) - filterRows + 1;
-    int cols = input.dimension(1) - filterCols + 1;
-    int channels = input.dimension(2) / filterChannels;
-    Tensor3d result(rows, cols, channels);
-    result.setConstant(0.0);
-    Eigen::array<int, 3> offsets;
-    Eigen::array<int, 3> extents;
-    extents[0] = filterRows;
-    extents[1] = filterCols;
-    extents[2] = filterChannels;
-    for(int i = 0; i < rows; ++i)
+    Tensor3d convoluted(image.rows - filter.dimension(1) + 1, image.cols - filter.dimension(2) + 1, filter.dimension(0));
+    ann::convolution(ann::imageView<unsigned char>(image), filter, ann::imageView(convoluted));
+    toImage(convoluted, dest);
+    return convoluted;
+}
+
+/**
+* Best wall time in milliseconds of repetitions calls of fnc.
+*/
+template <typename Function>
+double benchmark(Function fnc, int repetitions)
+{
+    double best = std::numeric_limits<double>::max();
+    for (int r = 0; r < repetitions; ++r)
     {
-        offsets[0] = i;
-        for(int j = 0; j < cols; ++j)
-        {
-            offsets[1] = j;
-            for(int k = 0; k < channels; ++k)
-            {
-                offsets[2] = k;
-                Eigen::Tensor<double, 0, Eigen::RowMajor> sumProduct = (input.slice(offsets, extents) * filter).sum();
-                double summ = sumProduct(0);
-                result(i, j, k) = summ;
-            }
-        }
+        auto start = std::chrono::steady_clock::now();
+        fnc();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
     }
+    return best;
+}
+
+/**
+* A channels deep input made of the colour channels of a crop of the image.
+*/
+ann::LayoutTensor channelImage(const Tensor3d &image, int rows, int cols, int channels)
+{
+    ann::LayoutTensor result(ann::Layout::HWC, rows, cols, channels);
+    for (int i = 0; i < rows; ++i)
+        for (int j = 0; j < cols; ++j)
+            for (int c = 0; c < channels; ++c)
+                result.data[result.index(i, j, c)] = image(i, j, c % image.dimension(2)) / 255.0 + 0.01 * c;
     return result;
 }
 
-Tensor3d imageConvolution(const Tensor3d &input, cv::Mat &dest, const Tensor3d &filter)
+/**
+* 3x3 convolution throughput (useful GFLOP/s, nChw8c padding not counted) in every layout by number of channels, with
+* the time of the conversion from HWC, then a conv/ReLU chain planned by LayoutGraph against every forced layout.
+* The buffers are reused between the repetitions, so the best times leave the allocations out.
+*/
+int benchmarkLayouts(const Tensor3d &image)
 {
-    Tensor3d convoluted = convolution(input, filter);
-    std::vector<cv::Mat> channels;
-    int rows = convoluted.dimension(0);
-    int cols = convoluted.dimension(1);
-    int numberOfChannels = convoluted.dimension(2);
-    channels.reserve(numberOfChannels);
-
-    for(int k = 0; k < numberOfChannels; ++k)
+    const int rows = std::min<int>(256, image.dimension(0));
+    const int cols = std::min<int>(256, image.dimension(1));
+    std::cout << "Worker threads: " << ann::numberOfWorkers() << ", " << rows << "x" << cols << " pixels, 3x3 kernels\n";
+    std::cout << std::setw(10) << "channels";
+    for (ann::Layout layout : ann::allLayouts)
+        std::cout << std::setw(12) << (std::string(ann::layoutName(layout)) + " ms") << std::setw(10) << "GFLOP/s";
+    std::cout << std::setw(14) << "to CHW ms" << std::setw(14) << "to nChw8c ms" << std::setw(12) << "max error" << "\n";
+    for (auto [inputChannels, outputChannels] : {std::make_pair(3, 1), std::make_pair(3, 8), std::make_pair(8, 8), std::make_pair(16, 16), std::make_pair(32, 32)})
+    {
+        const ann::LayoutTensor input = channelImage(image, rows, cols, inputChannels);
+        Tensor4d filters(outputChannels, 3, 3, inputChannels);
+        filters.setRandom();
+        const double flops = 2.0 * (rows - 2) * (cols - 2) * 9 * inputChannels * outputChannels;
+        const Tensor3d expected = ann::toTensor3d(ann::convolution(input, filters));
+        std::cout << std::setw(10) << (std::to_string(inputChannels) + "->" + std::to_string(outputChannels));
+        double error = 0.0;
+        for (ann::Layout layout : ann::allLayouts)
+        {
+            const ann::LayoutTensor converted = ann::convertLayout(input, layout);
+            const ann::BlockedFilters blocked(filters);
+            ann::LayoutTensor output;
+            const double time = benchmark([&]() { ann::convolution(converted, filters, output, &blocked); }, 5);
+            const Tensor3d actual = ann::toTensor3d(output);
+            Eigen::Tensor<double, 0, Eigen::RowMajor> difference = (actual - expected).abs().maximum();
+            error = std::max(error, difference(0));
+            std::cout << std::fixed << std::setprecision(3) << std::setw(12) << time << std::setprecision(2) << std::setw(10) << flops / time / 1e6;
+        }
+        ann::LayoutTensor planar, blocked;
+        std::cout << std::setprecision(3) << std::setw(14) << benchmark([&]() { ann::convertLayout(input, ann::Layout::CHW, planar); }, 5);
+        std::cout << std::setw(14) << benchmark([&]() { ann::convertLayout(input, ann::Layout::Blocked, blocked); }, 5);
+        std::cout << std::scientific << std::setprecision(2) << std::setw(12) << error << std::defaultfloat << "\n";
+    }
+
+    // an RGB in, RGB out feature extractor: the wide layers dominate, the first and last ones are thin
+    ann::LayoutGraph graph;
+    Tensor4d first(16, 3, 3, 3), middle(16, 3, 3, 16), last(3, 3, 3, 16);
+    first.setRandom();
+    middle.setRandom();
+    last.setRandom();
+    graph.convolution(first).relu().convolution(middle).relu().convolution(middle).relu().convolution(last);
+    const ann::LayoutTensor input = channelImage(image, image.dimension(0), image.dimension(1), 3);
+    const ann::LayoutGraph::Plan plan = graph.plan(input, ann::Layout::HWC);
+    std::cout << "\nconv 3->16, relu, conv 16->16, relu, conv 16->16, relu, conv 16->3 on " << input.rows << "x" << input.cols << " HWC, planned " << ann::layoutName(plan.layout) << "\n";
+    std::cout << std::setw(10) << "layout" << std::setw(16) << "estimated ms" << std::setw(14) << "measured ms" << std::setw(12) << "max error" << "\n";
+    const Tensor3d expected = ann::toTensor3d(graph.run(input, {ann::Layout::HWC, {}}, ann::Layout::HWC));
+    for (ann::Layout layout : ann::allLayouts)
     {
-        Eigen::Tensor<double, 2, Eigen::RowMajor> chip = convoluted.chip(k, 2);
-        Matrix matrix = Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>> (chip.data(), rows, cols);
-        cv::Mat temp, temp2;
-        cv::eigen2cv(matrix, temp);
-        temp.convertTo(temp2, CV_8UC1);
-        channels.push_back(temp);
+        ann::LayoutTensor output;
+        ann::LayoutGraph::Workspace workspace;
+        const double time = benchmark([&]() { graph.run(input, {layout, {}}, ann::Layout::HWC, output, workspace); }, 3);
+        Eigen::Tensor<double, 0, Eigen::RowMajor> error = (ann::toTensor3d(output) - expected).abs().maximum();
+        std::cout << std::setw(10) << ann::layoutName(layout) << std::fixed << std::setprecision(3) << std::setw(16) << 1000.0 * plan.seconds[static_cast<int>(layout)];
+        std::cout << std::setw(14) << time << std::scientific << std::setprecision(2) << std::setw(12) << error(0) << std::defaultfloat << "\n";
     }
-    cv::merge(channels, dest);
-    if(numberOfChannels == 1)
-        dest.convertTo(dest, CV_8UC1);
-    return convoluted;
+    return 0;
 }
 
-int main(int, char **)
+int main(int argc, char **argv)
 {
-
     const char * imagepath = "../data/convolution_example.png";
     const cv::Mat image = cv::imread(imagepath, cv::IMREAD_COLOR);
+    if (argc == 2 && std::string(argv[1]) == "--layouts")
+        return benchmarkLayouts(convertToTensor3d(image));
+
+    ann::TrainingOptions options;
+    try
+    {
+        options = ann::TrainingOptions::parse(argc, argv);
+    }
+    catch (std::invalid_argument const &e)
+    {
+        std::cerr << e.what() << "\n";
+        return -1;
+    }
+
     cv::Mat groundTruth, outputImage;
     Tensor3d inputTensor = convertToTensor3d(image);
 
-    Tensor3d groundTruthFilter(3, 3, 3);
+    Tensor4d groundTruthFilter(1, 3, 3, 3);
     groundTruthFilter.setValues
-        ({
+        ({{
             {{-1.0, -1.0, -1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}},
             {{-1.0, -1.0, -1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}},
             {{-1.0, -1.0, -1.0}, {0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}}
-        });
+        }});
 
-    Tensor3d K(3, 3, 3);
+    Tensor4d K(1, 3, 3, 3);
     K.setRandom();
     K = K * 0.05;
-    const auto groundTruthTensor = imageConvolution(inputTensor, groundTruth, groundTruthFilter);
-    int key = 0;
+    const auto groundTruthTensor = imageConvolution(image, groundTruth, groundTruthFilter);
+    ann::TrainingMonitor monitor(options);
     int epoch = 0;
-    double learningRate = 0.000000000001;
-    while(key != 27)
+    bool stop = false;
+    // the gradient averaged over the outputs and applied by Adam: a step in kernel units, whatever the size and the
+    // scale of the image
+    const double learningRate = 0.01;
+    ann::KernelOptimizer optimizer = ann::adamOptimizer();
+    // every epoch writes its convolution into the same tensor
+    Tensor3d convolutedImageTensor(groundTruthTensor.dimensions());
+    while(!stop)
     {
-        Tensor3d convolutedImageTensor = imageConvolution(inputTensor, outputImage, K);
+        ann::convolution(ann::imageView(inputTensor), K, ann::imageView(convolutedImageTensor));
         
         Tensor3d dC = convolutedImageTensor - groundTruthTensor;
         Eigen::Tensor<double, 0, Eigen::RowMajor> mseTensor = (dC * dC).sum();
         double mse = mseTensor(0) / (dC.dimension(0) * dC.dimension(1) * dC.dimension(2));
 
-        Tensor3d dK = convolution(inputTensor, dC);
+        Tensor4d dK = ann::kernelGradient(inputTensor, dC, 3, 3);
 
-        K = K - learningRate * dK;  
+        Eigen::Map<Matrix>(K.data(), K.size(), 1) += optimizer(learningRate, Eigen::Map<const Matrix>(dK.data(), dK.size(), 1) / static_cast<double>(dC.size()), epoch);
 
         std::cout << "Epoch:\t" << epoch << "\tMSE:\t" << mse << "\n";
-        show(image, groundTruth, outputImage);
+        // the output image is only converted when the visualizer is ready for a new frame
+        if (monitor.frameDue())
+        {
+            toImage(convolutedImageTensor, outputImage);
+            monitor.push(snapshot(image, groundTruth, outputImage), epoch);
+        }
+        stop = monitor.shouldStop(epoch, mse);
         epoch++;
-        key = cv::waitKey(50);
 
     }
-    std::cout << "K = \n" << K << "\n\n";
+    std::cout << "K = \n" << Eigen::TensorMap<Tensor3d>(K.data(), 3, 3, 3) << "\n\n";
     return 0;
 }
\ No newline at end of file
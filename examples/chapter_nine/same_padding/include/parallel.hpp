@@ -0,0 +1,56 @@
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace ann
+{
+
+inline unsigned numberOfWorkers()
+{
+    unsigned result = std::thread::hardware_concurrency();
+    return result > 0 ? result : 1;
+}
+
+/**
+* Whether parallelFor runs inline on the calling thread. The worker threads of an outer pool set it, as they already
+* keep the cores busy with one task each.
+*/
+inline bool &serialThread()
+{
+    thread_local bool serial = false;
+    return serial;
+}
+
+/**
+* Splits [begin, end) into one contiguous chunk per hardware thread and calls fnc(chunkBegin, chunkEnd) on each one.
+* The calling thread processes the last chunk, so a single core machine runs everything inline.
+*/
+inline void parallelFor(long begin, long end, const std::function<void(long, long)> &fnc)
+{
+    const long size = end - begin;
+    if (size <= 0)
+        return;
+    const long workers = serialThread() ? 1 : std::min<long>(numberOfWorkers(), size);
+    const long chunkSize = (size + workers - 1) / workers;
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    long chunkBegin = begin;
+    for (long worker = 0; worker < workers - 1; ++worker)
+    {
+        long chunkEnd = std::min(chunkBegin + chunkSize, end);
+        threads.emplace_back(fnc, chunkBegin, chunkEnd);
+        chunkBegin = chunkEnd;
+    }
+    if (chunkBegin < end)
+        fnc(chunkBegin, end);
+    std::for_each(threads.begin(), threads.end(), [](std::thread &thread) { thread.join(); });
+}
+
+} // namespace ann
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef WINOGRAD_CONVOLUTION_H_
+#define WINOGRAD_CONVOLUTION_H_
+
+#include <algorithm>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "convolution_parameters.hpp"
+#include "parallel.hpp"
+
+namespace ann
+{
+
+// tiles transformed together, one SIMD-friendly fixed size array per tile element
+const int winogradBlockTiles = 8;
+
+/**
+* Winograd minimal filtering F(2, 3): 2 outputs of a 3 taps correlation from 4 inputs with 4 multiplications instead of 6.
+* The transforms only use additions, so they are written out instead of being multiplied as matrices.
+* In and Out are either scalars or Eigen arrays holding the same element of many tiles.
+*/
+struct WinogradF2x3
+{
+    static const int outputSize = 2;
+    static const int tileSize = 4;
+
+    // t = B^T d
+    template <typename In, typename Out>
+    static void transformInput(const In *d, int stride, Out *t, int tStride)
+    {
+        t[0] = d[0] - d[2 * stride];
+        t[tStride] = d[stride] + d[2 * stride];
+        t[2 * tStride] = d[2 * stride] - d[stride];
+        t[3 * tStride] = d[stride] - d[3 * stride];
+    }
+
+    // y = A^T m
+    template <typename In, typename Out>
+    static void transformOutput(const In *m, int stride, Out *y, int yStride)
+    {
+        y[0] = m[0] + m[stride] + m[2 * stride];
+        y[yStride] = m[stride] - m[2 * stride] - m[3 * stride];
+    }
+
+    static Eigen::Matrix<double, 4, 3> G()
+    {
+        Eigen::Matrix<double, 4, 3> result;
+        result << 1.0, 0.0, 0.0,
+            0.5, 0.5, 0.5,
+            0.5, -0.5, 0.5,
+            0.0, 0.0, 1.0;
+        return result;
+    }
+};
+
+/**
+* Winograd F(4, 3): 4 outputs from 6 inputs with 6 multiplications instead of 12,
+* 36 instead of 144 per 4x4 output tile in 2D. The larger constants make it less accurate than F(2, 3).
+*/
+struct WinogradF4x3
+{
+    static const int outputSize = 4;
+    static const int tileSize = 6;
+
+    template <typename In, typename Out>
+    static void transformInput(const In *d, int stride, Out *t, int tStride)
+    {
+        const In &d0 = d[0], &d1 = d[stride], &d2 = d[2 * stride], &d3 = d[3 * stride], &d4 = d[4 * stride], &d5 = d[5 * stride];
+        t[0] = 4.0 * d0 - 5.0 * d2 + d4;
+        t[tStride] = d3 + d4 - 4.0 * (d1 + d2);
+        t[2 * tStride] = d4 - d3 + 4.0 * (d1 - d2);
+        t[3 * tStride] = d4 - d2 + 2.0 * (d3 - d1);
+        t[4 * tStride] = d4 - d2 + 2.0 * (d1 - d3);
+        t[5 * tStride] = 4.0 * d1 - 5.0 * d3 + d5;
+    }
+
+    template <typename In, typename Out>
+    static void transformOutput(const In *m, int stride, Out *y, int yStride)
+    {
+        const In &m0 = m[0], &m1 = m[stride], &m2 = m[2 * stride], &m3 = m[3 * stride], &m4 = m[4 * stride], &m5 = m[5 * stride];
+        y[0] = m0 + m1 + m2 + m3 + m4;
+        y[yStride] = m1 - m2 + 2.0 * (m3 - m4);
+        y[2 * yStride] = m1 + m2 + 4.0 * (m3 + m4);
+        y[3 * yStride] = m1 - m2 + 8.0 * (m3 - m4) + m5;
+    }
+
+    static Eigen::Matrix<double, 6, 3> G()
+    {
+        Eigen::Matrix<double, 6, 3> result;
+        result << 1.0 / 4, 0.0, 0.0,
+            -1.0 / 6, -1.0 / 6, -1.0 / 6,
+            -1.0 / 6, 1.0 / 6, -1.0 / 6,
+            1.0 / 24, 1.0 / 12, 1.0 / 6,
+            1.0 / 24, -1.0 / 12, 1.0 / 6,
+            0.0, 0.0, 1.0;
+        return result;
+    }
+};
+
+/**
+* 3x3 stride 1 convolution with Winograd F(m x m, 3 x 3).
+* The padded input is split into overlapping tiles. Tiles of the same column are transformed in blocks of
+* winogradBlockTiles: every tile element of a block lives in one fixed size array, so the transform additions
+* are vectorized across tiles. The input transform is shared by all the filters of the bank.
+*/
+template <typename Winograd>
+std::vector<Matrix> winogradConvolution(const Matrix &input, const std::vector<Matrix> &kernels, const ConvolutionParameters &params = ConvolutionParameters())
+{
+    const int m = Winograd::outputSize;
+    const int alpha = Winograd::tileSize;
+    const int cells = alpha * alpha;
+    if (!params.isUnitStride() || params.dilation != 0)
+        throw std::invalid_argument("Winograd convolution requires unit strides and no dilation.");
+    params.validate(input.rows(), input.cols(), 3, 3);
+
+    const int outputRows = params.outputRows(input.rows(), 3);
+    const int outputCols = params.outputCols(input.cols(), 3);
+    const int tileCols = (outputCols + m - 1) / m;
+    // tile rows are processed in blocks of winogradBlockTiles, so round them up to whole blocks
+    const int tileRows = ((outputRows + m - 1) / m + winogradBlockTiles - 1) / winogradBlockTiles * winogradBlockTiles;
+
+    // zero padded copy covering whole tiles
+    Matrix padded = Matrix::Zero(tileRows * m + 2, tileCols * m + 2);
+    padded.block(params.rowPadding, params.colPadding, input.rows(), input.cols()) = input;
+
+    const int numberOfFilters = kernels.size();
+    const auto G = Winograd::G();
+    std::vector<Eigen::Matrix<double, alpha, alpha>> transformedKernels;
+    for (const auto &kernel : kernels)
+    {
+        if (kernel.rows() != 3 || kernel.cols() != 3)
+            throw std::invalid_argument("Winograd convolution requires 3x3 filters.");
+        transformedKernels.push_back(G * kernel * G.transpose());
+    }
+
+    std::vector<Matrix> tiled(numberOfFilters, Matrix(tileRows * m, tileCols * m));
+    parallelFor(0, tileCols, [&](long tileBegin, long tileEnd) {
+        // fixed size arrays: every transform step compiles to a few unrolled SIMD instructions
+        using Block = Eigen::Array<double, winogradBlockTiles, 1>;
+        using StridedMap = Eigen::Map<Block, 0, Eigen::InnerStride<>>;
+        using ConstStridedMap = Eigen::Map<const Block, 0, Eigen::InnerStride<>>;
+        Block d[cells], t[cells], v[cells], product[cells], partial[m * alpha], y[m * m];
+
+        for (long tile = tileBegin; tile < tileEnd; ++tile)
+        {
+            for (int blockBegin = 0; blockBegin < tileRows; blockBegin += winogradBlockTiles)
+            {
+                // d[r + c * alpha](i) = element (r, c) of the i-th tile of the block
+                for (int c = 0; c < alpha; ++c)
+                    for (int r = 0; r < alpha; ++r)
+                        d[r + c * alpha] = ConstStridedMap(padded.col(tile * m + c).data() + blockBegin * m + r, Eigen::InnerStride<>(m));
+
+                // v = B^T d B
+                for (int c = 0; c < alpha; ++c)
+                    Winograd::transformInput(&d[c * alpha], 1, &t[c * alpha], 1);
+                for (int r = 0; r < alpha; ++r)
+                    Winograd::transformInput(&t[r], alpha, &v[r], alpha);
+
+                for (int f = 0; f < numberOfFilters; ++f)
+                {
+                    const auto &U = transformedKernels[f];
+                    for (int k = 0; k < cells; ++k)
+                        product[k] = v[k] * U(k);
+
+                    // y = A^T (U .* v) A
+                    for (int c = 0; c < alpha; ++c)
+                        Winograd::transformOutput(&product[c * alpha], 1, &partial[c * m], 1);
+                    for (int p = 0; p < m; ++p)
+                        Winograd::transformOutput(&partial[p], m, &y[p], m);
+
+                    for (int q = 0; q < m; ++q)
+                        for (int p = 0; p < m; ++p)
+                            StridedMap(tiled[f].col(tile * m + q).data() + blockBegin * m + p, Eigen::InnerStride<>(m)) = y[p + q * m];
+                }
+            }
+        }
+    });
+
+    std::vector<Matrix> result;
+    result.reserve(numberOfFilters);
+    for (const auto &output : tiled)
+        result.push_back(output.topLeftCorner(outputRows, outputCols));
+    return result;
+}
+
+} // namespace ann
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef PATCH_MATRIX_H_
+#define PATCH_MATRIX_H_
+
+#include <sstream>
+
+#include "im2col_convolution.hpp"
+#include "fused_convolution.hpp"
+
+namespace ann
+{
+
+/**
+* im2col lowering of an input that doesn't change while a kernel is fitted on it (the training loops of the chapter
+* nine examples): the image is walked once, then every epoch only multiplies the patch matrix. Row k of patches is the
+* window of output pixel k (column-major) and column a + b * kernelRows is tap (a, b), the layout of im2col.
+* The Gram matrix patches^T * patches (taps x taps) is kept too, for the quadratic cost.
+*/
+class PatchMatrix
+{
+
+private:
+    Matrix patches;
+    Matrix gram;
+    int kernelRows;
+    int kernelCols;
+    int outputRows;
+    int outputCols;
+
+    void checkKernel(const Matrix &kernel) const
+    {
+        if (kernel.rows() != kernelRows || kernel.cols() != kernelCols)
+        {
+            std::stringstream msg;
+            msg << "The patch matrix was built for " << kernelRows << "x" << kernelCols << " kernels";
+            msg << " but the kernel is " << kernel.rows() << "x" << kernel.cols();
+            throw std::invalid_argument(msg.str());
+        }
+    }
+
+    void checkOutput(const Matrix &output) const
+    {
+        if (output.rows() != outputRows || output.cols() != outputCols)
+        {
+            std::stringstream msg;
+            msg << "The convolution output is " << outputRows << "x" << outputCols;
+            msg << " but the matrix is " << output.rows() << "x" << output.cols();
+            throw std::invalid_argument(msg.str());
+        }
+    }
+
+public:
+    PatchMatrix(const Matrix &input, int kernelRows, int kernelCols, const ConvolutionParameters &params = ConvolutionParameters()) :
+        kernelRows(kernelRows), kernelCols(kernelCols)
+    {
+        params.validate(input.rows(), input.cols(), kernelRows, kernelCols);
+        outputRows = params.outputRows(input.rows(), kernelRows);
+        outputCols = params.outputCols(input.cols(), kernelCols);
+        im2col(input, kernelRows, kernelCols, params, 0, outputCols, patches);
+        gram.noalias() = patches.transpose() * patches;
+    }
+
+    /**
+    * convolution(input, kernel) as a single GEMV, patches * vec(kernel).
+    */
+    Matrix convolution(const Matrix &kernel) const
+    {
+        checkKernel(kernel);
+        Matrix result(outputRows, outputCols);
+        Eigen::Map<Vector>(result.data(), result.size()).noalias() = patches * Eigen::Map<const Vector>(kernel.data(), kernel.size());
+        return result;
+    }
+
+    /**
+    * Gradient of the cost with respect to the kernel given dC, the gradient with respect to the output:
+    * a single transposed GEMV, patches^T * vec(dC), instead of the convolution of the input with dC.
+    */
+    Matrix kernelGradient(const Matrix &dC) const
+    {
+        checkOutput(dC);
+        Matrix result(kernelRows, kernelCols);
+        Eigen::Map<Vector>(result.data(), result.size()).noalias() = patches.transpose() * Eigen::Map<const Vector>(dC.data(), dC.size());
+        return result;
+    }
+
+    /**
+    * Same as above when the output was max pooled: dC is the gradient with respect to the pooled output and only the
+    * patches of the window maxima, read from the switches, contribute, so the sparse convolution sized gradient of
+    * maxPoolingGradient is never built.
+    */
+    Matrix kernelGradient(const Matrix &dC, const PooledConvolution &forward) const
+    {
+        if (forward.convolutionRows != outputRows || forward.convolutionCols != outputCols)
+            throw std::invalid_argument("The pooled convolution doesn't come from this patch matrix.");
+        const long taps = patches.cols();
+        const long leadingDimension = patches.rows();
+        Matrix result = Matrix::Zero(kernelRows, kernelCols);
+        for (int q = 0; q < dC.cols(); ++q)
+        {
+            for (int p = 0; p < dC.rows(); ++p)
+            {
+                if (forward.relu && forward.output(p, q) <= 0.0)
+                    continue;
+                const int offset = forward.switches(p, q);
+                const long row = p * forward.stride + offset % forward.pooling + static_cast<long>(q * forward.stride + offset / forward.pooling) * outputRows;
+                const double *patch = patches.data() + row;
+                for (long t = 0; t < taps; ++t)
+                    result.data()[t] += dC(p, q) * patch[t * leadingDimension];
+            }
+        }
+        return result;
+    }
+
+    /**
+    * Kernel gradient of the quadratic cost 1/2 ||convolution(kernel) - target||^2, patches^T (patches k - t),
+    * computed as gram * k - patches^T t: targetGradient is kernelGradient(target), computed once for a fixed target,
+    * so an epoch costs taps x taps operations instead of a pass over the image.
+    */
+    Matrix quadraticGradient(const Matrix &kernel, const Matrix &targetGradient) const
+    {
+        checkKernel(kernel);
+        checkKernel(targetGradient);
+        Matrix result(kernelRows, kernelCols);
+        Eigen::Map<Vector>(result.data(), result.size()).noalias() = gram * Eigen::Map<const Vector>(kernel.data(), kernel.size());
+        return result - targetGradient;
+    }
+
+    int getOutputRows() const
+    {
+        return outputRows;
+    }
+    int getOutputCols() const
+    {
+        return outputCols;
+    }
+};
+
+} // namespace ann
+
+#endif
@@ -5,13 +5,19 @@
 #include <algorithm>
 
 #include "matrix_definitions.hpp"
+#include "convolution.hpp"
+#include "patch_trainer.hpp"
+#include "training_monitor.hpp"
 
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/core/eigen.hpp>
 
-void show(const cv::Mat &source, const cv::Mat &groundTruth, const cv::Mat &convoluted)
+/**
+* Source, ground truth and current output side by side
+*/
+cv::Mat snapshot(const cv::Mat &source, const cv::Mat &groundTruth, const cv::Mat &convoluted)
 {
     int maxHeight = std::max(std::max(source.rows, groundTruth.rows), convoluted.rows);
     int width = source.cols + groundTruth.cols + convoluted.cols;
@@ -22,64 +28,40 @@ void show(const cv::Mat &source, const cv::Mat &groundTruth, const cv::Mat &conv
     groundTruth.copyTo(groundTruth_roi);
     cv::Mat convoluted_roi = toShow(cv::Rect(source.cols + groundTruth.cols, 0, convoluted.cols, convoluted.rows));
     convoluted.copyTo(convoluted_roi);
-    cv::namedWindow("", cv::WindowFlags::WINDOW_AUTOSIZE);
-    cv::imshow("", toShow);
+    return toShow;
 }
 
-Matrix dilate(const Matrix &kernel, const int dilatation)
+Matrix convolution(const Matrix & input, const Matrix &kernel, const int strides, const int dilatation)
 {
-    Matrix result;
-    if(dilatation > 0)
-    {
-        int rows = kernel.rows();
-        int cols = kernel.cols();
-        int resultRows = rows + dilatation * (rows - 1);
-        int resultCols = cols + dilatation * (cols - 1);
-        result = Matrix::Zero(resultRows, resultCols);
-        int dilatation_plus_1 = dilatation + 1;
-        for(int i = 0; i < rows; ++i) 
-        {
-            for(int j = 0; j < cols; ++j) 
-            {
-                result(i * dilatation_plus_1, j * dilatation_plus_1) = kernel(i, j);
-            }
-        }
-    } else {
-        result = kernel;
-    }
-    return result;
+    return ann::convolution(input, kernel, ann::ConvolutionParameters(0, strides, dilatation));
 }
 
-Matrix convolution(const Matrix & input, const Matrix &kernel, const int strides, const int dilatation)
+void toImage(const Matrix &matrix, cv::Mat &dest)
 {
-    Matrix filter = dilate(kernel, dilatation);
-    int filterRows = filter.rows();
-    int filterCols = filter.cols();
-    int rows = (input.rows() - filterRows)/strides + 1;
-    int cols = (input.cols() - filterCols)/strides + 1;
-    Matrix result = Matrix::Zero(rows, cols);
-    for(int i = 0; i < rows; ++i)
-    {
-        for(int j = 0; j < cols; ++j)
-        {
-            double sum = input.block(strides*i, strides*j, filterRows, filterCols).cwiseProduct(filter).sum();
-            result(i, j) = sum;
-        }
-    }
-    return result;
+    cv::Mat temp;
+    cv::eigen2cv(matrix, temp);
+    temp.convertTo(dest, CV_8UC1);
 }
 
 Matrix imageConvolution(const Matrix &input, cv::Mat &dest, const Matrix & filter, const int strides)
 {
     Matrix convoluted = convolution(input, filter, strides, 0);
-    cv::Mat temp;
-    cv::eigen2cv(convoluted, temp);
-    temp.convertTo(dest, CV_8UC1);
+    toImage(convoluted, dest);
     return convoluted;
 }
 
-int main(int, char **)
+int main(int argc, char **argv)
 {
+    ann::TrainingOptions options;
+    try
+    {
+        options = ann::TrainingOptions::parse(argc, argv);
+    }
+    catch (std::invalid_argument const &e)
+    {
+        std::cerr << e.what() << "\n";
+        return -1;
+    }
     srand(0);
     const char * imagepath = "../data/convolution_example.png";
     cv::Mat image = cv::imread(imagepath, cv::IMREAD_GRAYSCALE);
@@ -89,27 +71,35 @@ int main(int, char **)
         -1, 0, 1, 
         -1, 0, 1, 
         -1, 0, 1;
-    double learningRate = 0.00000000001;
     Matrix X;
     cv::cv2eigen(image, X);
     const int strides = 2;
     const Matrix groundTruth = imageConvolution(X, groundTruthImage, groundTruthFilter, strides);
-    Matrix K = 0.05 * Matrix::Random(3, 3);
-    int key = 0;
+    // minibatches of 16 random 32x32 patches with Adam: the cost is a mean over the outputs and the step is in kernel
+    // units, so the learning rate no longer depends on the size or the scale of the image
+    const double learningRate = 0.01;
+    const int stepsPerEpoch = 50;
+    ann::PatchKernelTrainer trainer({X}, {groundTruth}, 0.05 * Matrix::Random(3, 3), 32, 16, learningRate, ann::ConvolutionParameters(0, strides));
+    trainer.hookOptimizer(ann::adamOptimizer());
+    ann::TrainingMonitor monitor(options);
     int epoch = 0;
-    while(key != 27)
+    bool stop = false;
+    while(!stop)
     {
-
-        Matrix output = imageConvolution(X, outputImage, K, strides);
-        Matrix dC = output - groundTruth;
-        double mse = dC.cwiseProduct(dC).sum() / (dC.rows() * dC.cols()); 
-        Matrix dK = convolution(X, dC, 1, strides - 1);
+        for (int step = 0; step < stepsPerEpoch; ++step)
+            trainer.step();
+        double mse = trainer.cost();
         std::cout << "Epoch:\t" << epoch << "\tMSE:\t" << mse << "\n";
-        K = K - learningRate * dK;  
-        show(image, groundTruthImage, outputImage);
-        key = cv::waitKey(10);
+        // the output image is only computed when the visualizer is ready for a new frame
+        if (monitor.frameDue())
+        {
+            toImage(trainer.output(X), outputImage);
+            monitor.push(snapshot(image, groundTruthImage, outputImage), epoch);
+        }
+        stop = monitor.shouldStop(epoch, mse);
         epoch++;
     }
+    const Matrix &K = trainer.getKernel();
     std::cout << "K = \n" << K << "\n\n";
     return 0;
 }
\ No newline at end of file
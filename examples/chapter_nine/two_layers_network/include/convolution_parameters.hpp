@@ -0,0 +1,103 @@
+#ifndef CONVOLUTION_PARAMETERS_H_
+#define CONVOLUTION_PARAMETERS_H_
+
+#include <sstream>
+#include <stdexcept>
+
+#include "matrix_definitions.hpp"
+
+namespace ann
+{
+
+/**
+* Geometry of a 2D convolution (cross-correlation, as in the book examples).
+* dilation follows the strided_convolution example: it is the number of zeros inserted between two kernel taps,
+* so 0 means a regular dense kernel. The algorithms never insert those zeros: they read the input dilation + 1 apart,
+* so a dilated kernel costs as much as a dense one with the same number of taps.
+*/
+struct ConvolutionParameters
+{
+    int rowPadding = 0;
+    int colPadding = 0;
+    int rowStride = 1;
+    int colStride = 1;
+    int dilation = 0;
+
+    ConvolutionParameters() {}
+    ConvolutionParameters(int padding, int stride = 1, int dilation = 0) :
+        rowPadding(padding), colPadding(padding), rowStride(stride), colStride(stride), dilation(dilation) {}
+    ConvolutionParameters(int rowPadding, int colPadding, int rowStride, int colStride, int dilation) :
+        rowPadding(rowPadding), colPadding(colPadding), rowStride(rowStride), colStride(colStride), dilation(dilation) {}
+
+    int dilatedSize(int kernelSize) const
+    {
+        return kernelSize + dilation * (kernelSize - 1);
+    }
+
+    int outputRows(int inputRows, int kernelRows) const
+    {
+        return (inputRows + 2 * rowPadding - dilatedSize(kernelRows)) / rowStride + 1;
+    }
+
+    int outputCols(int inputCols, int kernelCols) const
+    {
+        return (inputCols + 2 * colPadding - dilatedSize(kernelCols)) / colStride + 1;
+    }
+
+    bool isUnitStride() const
+    {
+        return rowStride == 1 && colStride == 1;
+    }
+
+    bool hasPadding() const
+    {
+        return rowPadding != 0 || colPadding != 0;
+    }
+
+    void validate(int inputRows, int inputCols, int kernelRows, int kernelCols) const
+    {
+        if (rowStride < 1 || colStride < 1 || dilation < 0 || rowPadding < 0 || colPadding < 0)
+            throw std::invalid_argument("Strides must be positive and padding and dilation must not be negative.");
+        if (kernelRows < 1 || kernelCols < 1)
+            throw std::invalid_argument("The kernel is empty.");
+        if (inputRows + 2 * rowPadding < dilatedSize(kernelRows) || inputCols + 2 * colPadding < dilatedSize(kernelCols))
+        {
+            std::stringstream msg;
+            msg << "The (dilated) kernel " << dilatedSize(kernelRows) << "x" << dilatedSize(kernelCols);
+            msg << " is larger than the padded input " << inputRows + 2 * rowPadding << "x" << inputCols + 2 * colPadding;
+            throw std::invalid_argument(msg.str());
+        }
+    }
+};
+
+/**
+* Schoolbook convolution used as the reference implementation by the benchmarks.
+* The taps are read dilation + 1 apart in the input, so no zero filled dilated kernel is built.
+*/
+inline Matrix referenceConvolution(const Matrix &source, const Matrix &kernel, const ConvolutionParameters &params = ConvolutionParameters())
+{
+    params.validate(source.rows(), source.cols(), kernel.rows(), kernel.cols());
+    Matrix input = Matrix::Zero(source.rows() + 2 * params.rowPadding, source.cols() + 2 * params.colPadding);
+    input.block(params.rowPadding, params.colPadding, source.rows(), source.cols()) = source;
+
+    const int step = params.dilation + 1;
+    int rows = params.outputRows(source.rows(), kernel.rows());
+    int cols = params.outputCols(source.cols(), kernel.cols());
+    Matrix result = Matrix::Zero(rows, cols);
+    for (int i = 0; i < rows; ++i)
+    {
+        for (int j = 0; j < cols; ++j)
+        {
+            double sum = 0.0;
+            for (int b = 0; b < kernel.cols(); ++b)
+                for (int a = 0; a < kernel.rows(); ++a)
+                    sum += input(params.rowStride * i + a * step, params.colStride * j + b * step) * kernel(a, b);
+            result(i, j) = sum;
+        }
+    }
+    return result;
+}
+
+} // namespace ann
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef DIRECT_CONVOLUTION_H_
+#define DIRECT_CONVOLUTION_H_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "convolution_parameters.hpp"
+#include "parallel.hpp"
+
+namespace ann
+{
+
+// one SIMD register of doubles (8 with AVX-512, 4 with AVX, 2 with SSE)
+const int directPacketSize = Eigen::internal::packet_traits<double>::size;
+// independent accumulators per tile: enough to hide the FMA latency without spilling
+const int directRegisters = 4;
+// output rows computed together, all of them held in registers
+const int directTileRows = directRegisters * directPacketSize;
+// output columns per parallel task
+const int directTileCols = 64;
+// largest kernel side selected automatically, above that the im2col GEMM or the FFT take over
+const int directMaxKernelSize = 11;
+
+/**
+* Accumulates one tile of directTileRows outputs of column j in directRegisters packets. KernelRows/KernelCols are
+* compile time sizes for the common 3x3 and 5x5 kernels (fully unrolled loops) or Eigen::Dynamic.
+* Every coefficient is broadcast once and multiplied into all the packets; rowOffsets[a] is where the rows of tap a
+* start in a source column and col is the first source column read by output column j.
+*/
+template <int KernelRows, int KernelCols>
+inline void directTile(const Matrix &source, const Matrix &kernel, const int *rowOffsets, int step, long col, int row, double *out)
+{
+    using Packet = Eigen::Array<double, directPacketSize, 1>;
+    const int kernelRows = KernelRows == Eigen::Dynamic ? kernel.rows() : KernelRows;
+    const int kernelCols = KernelCols == Eigen::Dynamic ? kernel.cols() : KernelCols;
+
+    Packet accumulator[directRegisters];
+    for (int r = 0; r < directRegisters; ++r)
+        accumulator[r].setZero();
+    for (int b = 0; b < kernelCols; ++b)
+    {
+        const double *column = source.col(col + b * step).data() + row;
+        for (int a = 0; a < kernelRows; ++a)
+        {
+            const double weight = kernel(a, b);
+            for (int r = 0; r < directRegisters; ++r)
+                accumulator[r] += weight * Eigen::Map<const Packet>(column + rowOffsets[a] + r * directPacketSize);
+        }
+    }
+    for (int r = 0; r < directRegisters; ++r)
+    {
+        Eigen::Map<Packet> output(out + r * directPacketSize);
+        output = accumulator[r];
+    }
+}
+
+/**
+* Column j of an output with fewer than directTileRows rows.
+*/
+inline void directShortColumn(const Matrix &source, const Matrix &kernel, const int *rowOffsets, int step, long col, int rows, double *out)
+{
+    Eigen::Map<Eigen::ArrayXd> accumulator(out, rows);
+    accumulator.setZero();
+    for (int b = 0; b < kernel.cols(); ++b)
+    {
+        const double *column = source.col(col + b * step).data();
+        for (int a = 0; a < kernel.rows(); ++a)
+            accumulator += kernel(a, b) * Eigen::Map<const Eigen::ArrayXd>(column + rowOffsets[a], rows);
+    }
+}
+
+/**
+* Whole output column of outputRows rows, whose taps start at source column col.
+*/
+template <int KernelRows, int KernelCols>
+inline void directColumn(const Matrix &source, const Matrix &kernel, const int *rowOffsets, int step, long col, int outputRows, double *out)
+{
+    const int fullRows = outputRows / directTileRows * directTileRows;
+    for (int row = 0; row < fullRows; row += directTileRows)
+        directTile<KernelRows, KernelCols>(source, kernel, rowOffsets, step, col, row, out + row);
+    // the remaining rows are a last tile overlapping the previous one, recomputing a few identical values
+    if (fullRows < outputRows && fullRows > 0)
+        directTile<KernelRows, KernelCols>(source, kernel, rowOffsets, step, col, outputRows - directTileRows, out + outputRows - directTileRows);
+    else if (fullRows < outputRows)
+        directShortColumn(source, kernel, rowOffsets, step, col, outputRows, out);
+}
+
+template <int KernelRows, int KernelCols>
+inline void directKernel(const Matrix &source, const Matrix &kernel, const std::vector<int> &rowOffsets, const ConvolutionParameters &params, Matrix &result)
+{
+    const int step = params.dilation + 1;
+    const int outputRows = result.rows();
+    const int outputCols = result.cols();
+    const int numberOfBlocks = (outputCols + directTileCols - 1) / directTileCols;
+    const int *offsets = rowOffsets.data();
+
+    parallelFor(0, numberOfBlocks, [&](long blockBegin, long blockEnd) {
+        for (long block = blockBegin; block < blockEnd; ++block)
+        {
+            const long colBegin = block * directTileCols;
+            const long colEnd = std::min<long>(outputCols, colBegin + directTileCols);
+            // one column at a time: the kernel columns of input it reads stay in L1 and are reused by the next column
+            for (long j = colBegin; j < colEnd; ++j)
+                directColumn<KernelRows, KernelCols>(source, kernel, offsets, step, j * params.colStride, outputRows, result.col(j).data());
+        }
+    });
+}
+
+/**
+* Reorders the rows of every column by phase modulo rowStride: phase p holds the rows p, p + rowStride, ...
+* Output row i of a tap at row offset q reads row i * rowStride + q, which is element i + q / rowStride of
+* phase q % rowStride, so the rows read by a strided tile become contiguous again.
+*/
+inline Matrix splitRowPhases(const Matrix &source, int rowStride)
+{
+    using StridedMap = Eigen::Map<const Matrix, 0, Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>>;
+    const int phaseRows = (source.rows() + rowStride - 1) / rowStride;
+    Matrix result = Matrix::Zero(phaseRows * rowStride, source.cols());
+    for (int phase = 0; phase < rowStride && phase < source.rows(); ++phase)
+    {
+        const int rows = (source.rows() - phase + rowStride - 1) / rowStride;
+        result.middleRows(phase * phaseRows, rows) = StridedMap(source.data() + phase, rows, source.cols(), Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(source.rows(), rowStride));
+    }
+    return result;
+}
+
+/**
+* Where the rows of every tap start in a source column split by phase, for the output row 0 reading source row firstRow.
+*/
+inline std::vector<int> directRowOffsets(int kernelRows, int step, int rowStride, int phaseRows, int firstRow)
+{
+    std::vector<int> result(kernelRows);
+    for (int a = 0; a < kernelRows; ++a)
+        result[a] = (firstRow + a * step) % rowStride * phaseRows + (firstRow + a * step) / rowStride;
+    return result;
+}
+
+/**
+* Matrix read by the direct kernels: the input itself, or a copy stored in storage when it needs zero padding
+* or a split by row phase. rowOffsets receives where the rows of every tap start in a source column.
+*/
+inline const Matrix &directSource(const Matrix &input, int kernelRows, const ConvolutionParameters &params, Matrix &storage, std::vector<int> &rowOffsets)
+{
+    const Matrix *source = &input;
+    if (params.hasPadding())
+    {
+        storage = Matrix::Zero(input.rows() + 2 * params.rowPadding, input.cols() + 2 * params.colPadding);
+        storage.block(params.rowPadding, params.colPadding, input.rows(), input.cols()) = input;
+        source = &storage;
+    }
+    if (params.rowStride > 1)
+    {
+        storage = splitRowPhases(*source, params.rowStride);
+        source = &storage;
+    }
+
+    rowOffsets = directRowOffsets(kernelRows, params.dilation + 1, params.rowStride, source->rows() / params.rowStride, 0);
+    return *source;
+}
+
+/**
+* Direct convolution for small kernels: no im2col copy, the outputs are accumulated in register tiles of
+* directTileRows rows, vectorized along the contiguous (column-major) output rows.
+* Padding is handled on a zero padded copy of the input (borderConvolution avoids it), row strides on a copy split
+* by phase (splitRowPhases); column strides and dilation only change which columns and rows are read.
+*/
+inline std::vector<Matrix> directConvolution(const Matrix &input, const std::vector<Matrix> &kernels, const ConvolutionParameters &params = ConvolutionParameters())
+{
+    const int kernelRows = kernels.front().rows();
+    const int kernelCols = kernels.front().cols();
+    params.validate(input.rows(), input.cols(), kernelRows, kernelCols);
+
+    Matrix storage;
+    std::vector<int> rowOffsets;
+    const Matrix &source = directSource(input, kernelRows, params, storage, rowOffsets);
+
+    std::vector<Matrix> result;
+    result.reserve(kernels.size());
+    for (const auto &kernel : kernels)
+    {
+        if (kernel.rows() != kernelRows || kernel.cols() != kernelCols)
+            throw std::invalid_argument("All the filters of a convolution must have the same size.");
+        Matrix output(params.outputRows(input.rows(), kernelRows), params.outputCols(input.cols(), kernelCols));
+        if (kernelRows == 3 && kernelCols == 3)
+            directKernel<3, 3>(source, kernel, rowOffsets, params, output);
+        else if (kernelRows == 5 && kernelCols == 5)
+            directKernel<5, 5>(source, kernel, rowOffsets, params, output);
+        else
+            directKernel<Eigen::Dynamic, Eigen::Dynamic>(source, kernel, rowOffsets, params, output);
+        result.push_back(std::move(output));
+    }
+    return result;
+}
+
+} // namespace ann
+
+#endif
@@ -5,13 +5,19 @@
 #include <algorithm>
 
 #include "matrix_definitions.hpp"
+#include "convolution.hpp"
+#include "patch_trainer.hpp"
+#include "training_monitor.hpp"
 
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/core/eigen.hpp> 
 
-void show(const cv::Mat &source, const cv::Mat &groundTruth, const cv::Mat &convoluted)
+/**
+* Source, ground truth and current output side by side
+*/
+cv::Mat snapshot(const cv::Mat &source, const cv::Mat &groundTruth, const cv::Mat &convoluted)
 {
     int maxHeight = std::max(std::max(source.rows, groundTruth.rows), convoluted.rows);
     int width = source.cols + groundTruth.cols + convoluted.cols;
@@ -22,8 +28,7 @@ void show(const cv::Mat &source, const cv::Mat &groundTruth, const cv::Mat &conv
     groundTruth.copyTo(groundTruth_roi);
     cv::Mat convoluted_roi = toShow(cv::Rect(source.cols + groundTruth.cols, 0, convoluted.cols, convoluted.rows));
     convoluted.copyTo(convoluted_roi);
-    cv::namedWindow("", cv::WindowFlags::WINDOW_AUTOSIZE);
-    cv::imshow("", toShow);
+    return toShow;
 }
 
 Matrix rotate180(const Matrix &m)
@@ -33,34 +38,30 @@ Matrix rotate180(const Matrix &m)
 
 Matrix convolution(const Matrix &source, const Matrix &filter, const int row_padding, const int cols_padding)
 {
-    int filterRows = filter.rows();
-    int filterCols = filter.cols();
-    int rows = source.rows() - filterRows + 2*row_padding + 1;
-    int cols = source.cols() - filterCols + 2*cols_padding + 1;
-    Matrix input = Matrix::Zero(source.rows() + 2*row_padding, source.cols() + 2*cols_padding);
-    input.block(row_padding, cols_padding, source.rows(), source.cols()) = source;
+    return ann::convolution(source, filter, ann::ConvolutionParameters(row_padding, cols_padding, 1, 1, 0));
+}
 
-    Matrix result = Matrix::Zero(rows, cols);
-    for(int i = 0; i < rows; ++i)
-    {
-        for(int j = 0; j < cols; ++j)
-        {
-            double sum = input.block(i, j, filterRows, filterCols).cwiseProduct(filter).sum();
-            result(i, j) = sum;
-        }
-    }
-    return result;
+void toImage(const Matrix &matrix, cv::Mat &dest)
+{
+    cv::Mat temp;
+    cv::eigen2cv(matrix, temp);
+    temp.convertTo(dest, CV_8UC1);
 }
 
-std::tuple<Matrix, Matrix> imageConvolution(const Matrix input, cv::Mat &dest, const Matrix &filterLayer1, const Matrix &filterLayer2)
+std::tuple<Matrix, Matrix> layerConvolutions(const Matrix &input, const Matrix &filterLayer1, const Matrix &filterLayer2)
 {
     Matrix layer1 = convolution(input, filterLayer1, 0, 0);
     Matrix layer2 = convolution(layer1, filterLayer2, 0, 0);
-    cv::eigen2cv(layer2, dest);
-    dest.convertTo(dest, CV_8UC1);
     return std::make_tuple(layer1, layer2);
 }
 
+std::tuple<Matrix, Matrix> imageConvolution(const Matrix input, cv::Mat &dest, const Matrix &filterLayer1, const Matrix &filterLayer2)
+{
+    auto layers = layerConvolutions(input, filterLayer1, filterLayer2);
+    toImage(std::get<1>(layers), dest);
+    return layers;
+}
+
 class MSEViewer {
 
     private:
@@ -102,8 +103,18 @@ class MSEViewer {
 
 };
 
-int main(int, char **)
+int main(int argc, char **argv)
 {
+    ann::TrainingOptions options;
+    try
+    {
+        options = ann::TrainingOptions::parse(argc, argv);
+    }
+    catch (std::invalid_argument const &e)
+    {
+        std::cerr << e.what() << "\n";
+        return -1;
+    }
     const char * imagepath = "../data/convolution_example.png";
     cv::Mat image = cv::imread(imagepath, cv::IMREAD_GRAYSCALE);
     cv::Mat groundTruth, outputImage;
@@ -125,28 +136,38 @@ int main(int, char **)
     const auto [stdIgnore, groundTruthMatrix] = imageConvolution(inputMatrix, groundTruth, groundTruthFilterLayer1, groundTruthFilterLayer2);
     Matrix K1 = 0.05 * Matrix::Random(5, 5);
     Matrix K2 = 0.05 * Matrix::Random(3, 3);
-    int key = 0;
+    ann::TrainingMonitor monitor(options);
     int epoch = 0;
-    double learningRate = 0.000000000001;
-    while(key != 27)
+    bool stop = false;
+    // gradients averaged over the outputs and applied by Adam, one per kernel: steps in kernel units, whatever the size
+    // and the scale of the image
+    const double learningRate = 0.001;
+    ann::KernelOptimizer optimizerK1 = ann::adamOptimizer();
+    ann::KernelOptimizer optimizerK2 = ann::adamOptimizer();
+    while(!stop)
     {
-        auto [outputLayer1, outputLayer2] = imageConvolution(inputMatrix, outputImage, K1, K2);
+        auto [outputLayer1, outputLayer2] = layerConvolutions(inputMatrix, K1, K2);
         Matrix dCLayer2 = outputLayer2 - groundTruthMatrix;
         double mse = dCLayer2.cwiseProduct(dCLayer2).sum() / dCLayer2.rows() / dCLayer2.cols();
 
+        dCLayer2 /= static_cast<double>(dCLayer2.size());
         Matrix dK2 = convolution(outputLayer1, dCLayer2, 0, 0);
         int row_padding = (outputLayer1.rows() - dCLayer2.rows() + K2.rows() - 1) / 2;
         int col_padding = (outputLayer1.cols() - dCLayer2.cols() + K2.cols() - 1) / 2;
         auto K2_180 = rotate180(K2);
         Matrix dCLayer1 = convolution(dCLayer2, K2_180, row_padding, col_padding);
         Matrix dK1 = convolution(inputMatrix, dCLayer1, 0, 0);
-        K2 = K2 - learningRate * dK2;  
-        K1 = K1 - learningRate * dK1; 
+        K2 += optimizerK2(learningRate, dK2, epoch);
+        K1 += optimizerK1(learningRate, dK1, epoch);
         std::cout << "Epoch:\t" << epoch << "\tMSE:\t" << mse << "\n";
+        // the output image is only converted when the visualizer is ready for a new frame
+        if (monitor.frameDue())
+        {
+            toImage(outputLayer2, outputImage);
+            monitor.push(snapshot(image, groundTruth, outputImage), epoch);
+        }
+        stop = monitor.shouldStop(epoch, mse);
         epoch++;
-        show(image, groundTruth, outputImage);
-        key = cv::waitKey(10);
-
     }
     std::cout << "K1 =\n" << K1*256 << "\n\n";
     std::cout << "K2 =\n" << K2 << "\n\n";
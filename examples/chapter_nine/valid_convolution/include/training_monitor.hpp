@@ -0,0 +1,220 @@
+#ifndef TRAINING_MONITOR_H_
+#define TRAINING_MONITOR_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+namespace ann
+{
+
+/**
+* How a training loop runs: with a window (ESC stops it) or headless, with no display and optionally writing the
+* snapshots as PNG files. Training runs at full speed either way, the snapshots are taken at most framesPerSecond
+* times per second. maxEpochs and targetCost stop the loop, 0 meaning no limit; without a window to press ESC in,
+* headless runs need one of them.
+*/
+struct TrainingOptions
+{
+    bool headless = false;
+    long maxEpochs = 0;
+    double targetCost = 0.0;
+    double framesPerSecond = 20.0;
+    std::string snapshotDirectory;
+
+    /**
+    * Reads --headless, --epochs N, --cost C, --fps F and --snapshots DIR from the command line. The snapshot directory
+    * is created if it does not exist.
+    */
+    static TrainingOptions parse(int argc, char **argv)
+    {
+        const std::string usage = "Usage: [--headless] [--epochs N] [--cost C] [--fps F] [--snapshots DIR]";
+        TrainingOptions result;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string option = argv[i];
+            if (option == "--headless")
+            {
+                result.headless = true;
+                continue;
+            }
+            if (option != "--epochs" && option != "--cost" && option != "--fps" && option != "--snapshots")
+                throw std::invalid_argument("Unknown option " + option + ". " + usage);
+            if (i + 1 >= argc)
+                throw std::invalid_argument("Missing value for " + option + ". " + usage);
+            const std::string value = argv[++i];
+            try
+            {
+                if (option == "--epochs")
+                    result.maxEpochs = std::stol(value);
+                else if (option == "--cost")
+                    result.targetCost = std::stod(value);
+                else if (option == "--fps")
+                    result.framesPerSecond = std::stod(value);
+                else
+                    result.snapshotDirectory = value;
+            }
+            catch (std::logic_error const &)
+            {
+                throw std::invalid_argument("Invalid value " + value + " for " + option + ". " + usage);
+            }
+        }
+        if (result.maxEpochs < 0 || result.targetCost < 0.0 || result.framesPerSecond <= 0.0)
+            throw std::invalid_argument("The limits must not be negative and the frame rate must be positive. " + usage);
+        if (result.headless && result.maxEpochs == 0 && result.targetCost == 0.0)
+            throw std::invalid_argument("A headless run never stops without --epochs or --cost. " + usage);
+        if (!result.snapshotDirectory.empty())
+        {
+            std::error_code error;
+            std::filesystem::create_directories(result.snapshotDirectory, error);
+            if (error || !std::filesystem::is_directory(result.snapshotDirectory))
+                throw std::invalid_argument("Cannot create the snapshot directory " + result.snapshotDirectory + ".");
+        }
+        return result;
+    }
+};
+
+/**
+* Takes the visualization out of the training loop. The loop asks frameDue() and only then builds a snapshot, which
+* push() hands to a visualizer thread owning the window (imshow and waitKey), or writing the PNG files when headless.
+* The thread keeps one pending snapshot: a newer one replaces it, so a slow display drops frames instead of slowing
+* the training down. The last pending snapshot is still presented when the monitor is destroyed.
+*/
+class TrainingMonitor
+{
+
+private:
+    TrainingOptions options;
+    std::chrono::steady_clock::duration frameInterval;
+    std::chrono::steady_clock::time_point nextFrame;
+    std::mutex mutex;
+    std::condition_variable condition;
+    cv::Mat pending;
+    long pendingEpoch = 0;
+    bool finished = false;
+    std::atomic<bool> escapePressed{false};
+    std::atomic<bool> writeFailed{false};
+    std::thread worker;
+
+    bool hasOutput() const
+    {
+        return !options.headless || !options.snapshotDirectory.empty();
+    }
+
+    void present(const cv::Mat &frame, long epoch)
+    {
+        if (options.headless)
+        {
+            std::stringstream path;
+            path << options.snapshotDirectory << "/epoch_" << std::setw(6) << std::setfill('0') << epoch << ".png";
+            if (!cv::imwrite(path.str(), frame))
+            {
+                std::cerr << "Failed to write the snapshot " << path.str() << ", stopping.\n";
+                writeFailed = true;
+            }
+        }
+        else
+            cv::imshow("", frame);
+    }
+
+    void run()
+    {
+        if (!options.headless)
+            cv::namedWindow("", cv::WindowFlags::WINDOW_AUTOSIZE);
+        while (true)
+        {
+            cv::Mat frame;
+            long epoch = 0;
+            bool stop = false;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                // the window needs waitKey calls to stay responsive, even without new frames
+                condition.wait_for(lock, std::chrono::milliseconds(10), [this]() { return !pending.empty() || finished; });
+                std::swap(frame, pending);
+                epoch = pendingEpoch;
+                stop = finished && frame.empty();
+            }
+            if (!frame.empty())
+                present(frame, epoch);
+            if (stop)
+                break;
+            if (!options.headless && cv::waitKey(1) == 27)
+                escapePressed = true;
+        }
+    }
+
+public:
+    explicit TrainingMonitor(TrainingOptions options) :
+        options(std::move(options)), nextFrame(std::chrono::steady_clock::now())
+    {
+        frameInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / this->options.framesPerSecond));
+        if (hasOutput())
+            worker = std::thread(&TrainingMonitor::run, this);
+    }
+
+    ~TrainingMonitor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+        }
+        condition.notify_one();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    TrainingMonitor(const TrainingMonitor &) = delete;
+    TrainingMonitor &operator=(const TrainingMonitor &) = delete;
+
+    /**
+    * True at most once per frame interval, and never when there is nowhere to show the snapshots.
+    */
+    bool frameDue()
+    {
+        if (!hasOutput())
+            return false;
+        const auto now = std::chrono::steady_clock::now();
+        if (now < nextFrame)
+            return false;
+        nextFrame = now + frameInterval;
+        return true;
+    }
+
+    /**
+    * Hands a copy of the snapshot of epoch to the visualizer thread.
+    */
+    void push(const cv::Mat &frame, long epoch)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending = frame.clone();
+            pendingEpoch = epoch;
+        }
+        condition.notify_one();
+    }
+
+    /**
+    * Whether the loop stops after epoch (counted from 0) whose cost is cost: epoch or cost limit reached, ESC pressed
+    * or a snapshot that could not be written.
+    */
+    bool shouldStop(long epoch, double cost) const
+    {
+        return (options.maxEpochs > 0 && epoch + 1 >= options.maxEpochs) || cost <= options.targetCost || escapePressed || writeFailed;
+    }
+};
+
+} // namespace ann
+
+#endif
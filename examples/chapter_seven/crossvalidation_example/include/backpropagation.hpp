@@ -3,6 +3,7 @@
 
 #include "dataset.hpp"
 #include "mlp_core.hpp"
+#include "sampler.hpp"
 
 namespace ann
 {
@@ -20,6 +21,7 @@ class Backpropagation
     double learningRate;
     int maxEpochs;
     int batchsize;
+    bool stratified = false;
 
     std::function<Matrix(const Matrix &)> costPenalization;
 
@@ -58,6 +60,14 @@ class Backpropagation
         this->biasOptmizer = fnc;
     }
 
+    /**
+    * Draws minibatches with the class proportions of the training dataset instead of slicing a shuffled copy of it.
+    */
+    void stratifyMinibatches(bool enabled = true)
+    {
+        this->stratified = enabled;
+    }
+
     std::tuple<std::vector<Matrix>, std::vector<Matrix>, Matrix> forward(Matrix &x)
     {
 
@@ -101,10 +111,20 @@ class Backpropagation
 
     std::tuple<std::vector<Matrix>, std::vector<Matrix>> 
     backward(const std::vector<Matrix> &xPerLayer, const std::vector<Matrix> &zPerLayer, const Matrix &y, const Matrix &expected) {
+        return backpropagate(xPerLayer, zPerLayer, costFunction.derivatex(expected, y));
+    }
+
+    std::tuple<std::vector<Matrix>, std::vector<Matrix>> 
+    backward(const std::vector<Matrix> &xPerLayer, const std::vector<Matrix> &zPerLayer, const Matrix &y, const LabelVector &labels) {
+        return backpropagate(xPerLayer, zPerLayer, costFunction.derivatex(labels, y));
+    }
+
+    std::tuple<std::vector<Matrix>, std::vector<Matrix>> 
+    backpropagate(const std::vector<Matrix> &xPerLayer, const std::vector<Matrix> &zPerLayer, Matrix sigma) {
         auto &layers = net.getLayers();
         std::vector<Matrix> dWperLayer(layers.size()), dBperLayer(layers.size());
         int layerIndex = layers.size() - 1;
-        Matrix delta, sigma = costFunction.derivatex(expected, y);
+        Matrix delta;
 
         std::for_each(layers.rbegin(), layers.rend(), [&](const Layer &layer) {
             
@@ -149,19 +169,36 @@ class Backpropagation
         int msePeriod = 100;
         Matrix result(2, maxEpochs / msePeriod);  
         int epoch = 0;
+        auto step = [this, &epoch](Dataset &minibatch) {
+            auto [x, z, y] = forward(minibatch.X);
+            auto [dW, dB] = minibatch.hasLabels() ? 
+                backward(x, z, y, minibatch.labels) : backward(x, z, y, minibatch.T);
+            update(dW, dB, epoch);
+        };
+        int datasetSize = trainingDataset.size();
+        std::unique_ptr<StratifiedSampler> sampler;
+        if(this->stratified && this->batchsize < datasetSize)
+            sampler.reset(new StratifiedSampler(StratifiedSampler::fromDataset(trainingDataset)));
         while (epoch++ < maxEpochs)
         {
-            int datasetSize = trainingDataset.size();
-            if(this->batchsize < datasetSize)
-                ann::shuffleDataset(trainingDataset, prn);
-            for(int index = 0; index < datasetSize; index += this->batchsize)
+            if(sampler)
             {
-                int end = std::min(index + this->batchsize, datasetSize);
-                auto minibatch = trainingDataset.slice(index, end);
-
-                auto [x, z, y] = forward(minibatch.X);
-                auto [dW, dB] = backward(x, z, y, minibatch.T);
-                update(dW, dB, epoch);
+                for(const Indexes &indexes : sampler->minibatches(this->batchsize, prn))
+                {
+                    auto minibatch = gather(trainingDataset, indexes);
+                    step(minibatch);
+                }
+            }
+            else
+            {
+                if(this->batchsize < datasetSize)
+                    ann::shuffleDataset(trainingDataset, prn);
+                for(int index = 0; index < datasetSize; index += this->batchsize)
+                {
+                    int end = std::min(index + this->batchsize, datasetSize);
+                    auto minibatch = trainingDataset.slice(index, end);
+                    step(minibatch);
+                }
             }
             if(epoch % msePeriod == 1) {
                 auto trainingCost = mse(net, trainingDataset);
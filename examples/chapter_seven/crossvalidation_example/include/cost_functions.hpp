@@ -28,9 +28,26 @@ public:
 
   virtual double derivate(const double expected, const double output) const = 0;
 
+  /**
+  * Same as above for integer labels: every entry is evaluated for a 0 target 
+  * and only the label row of each column is replaced by the 1 target value.
+  */
+  double cost(const LabelVector &labels, const Matrix &output) const
+  {
+    Matrix lossVector = output.unaryExpr([this](const double output) {
+      return this->loss(0.0, output);
+    });
+    for (long i = 0; i < labels.size(); ++i)
+      lossVector(labels(i), i) = loss(1.0, output(labels(i), i));
+    double result = lossVector.sum() / output.cols();
+    return result;
+  }
+
   virtual double cost(const MultilayerPerceptron &net, const Dataset &dataset) const
   {
     auto output = net.output(dataset.X);
+    if (dataset.hasLabels())
+      return cost(dataset.labels, output);
     return cost(dataset.T, output);
   }
 
@@ -53,6 +70,17 @@ public:
 
     return result;
   }
+
+  Matrix derivatex(const LabelVector &labels, const Matrix &y) const
+  {
+    Matrix result = y.unaryExpr([this](const double output) {
+      return this->derivate(0.0, output);
+    });
+    for (long i = 0; i < labels.size(); ++i)
+      result(labels(i), i) = derivate(1.0, y(labels(i), i));
+
+    return result;
+  }
 };
 
 class QuadraticCostFunction : public CostFunction
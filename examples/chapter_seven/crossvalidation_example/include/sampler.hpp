@@ -0,0 +1,155 @@
+#ifndef SAMPLER_H_
+#define SAMPLER_H_
+
+#include <vector>
+
+#include "dataset.hpp"
+
+namespace ann
+{
+
+using Indexes = std::vector<long>;
+
+struct Fold
+{
+    Indexes training;
+    Indexes validation;
+};
+
+/**
+* Copies only the selected instances (columns) of the dataset.
+*/
+inline Dataset gather(const Dataset &dataset, const Indexes &indexes)
+{
+    Dataset result;
+    result.X.resize(dataset.X.rows(), indexes.size());
+    result.T.resize(dataset.T.rows(), dataset.T.cols() > 0 ? indexes.size() : 0);
+    if (dataset.hasLabels())
+        result.labels.resize(indexes.size());
+    result.numberOfClasses = dataset.numberOfClasses;
+    for (size_t i = 0, size = indexes.size(); i < size; ++i)
+    {
+        result.X.col(i) = dataset.X.col(indexes[i]);
+        if (result.T.cols() > 0)
+            result.T.col(i) = dataset.T.col(indexes[i]);
+        if (dataset.hasLabels())
+            result.labels(i) = dataset.labels(indexes[i]);
+    }
+    return result;
+}
+
+/**
+* Stratified folds and minibatches built on index arrays only.
+* Class membership is computed once, all the sampling steps are linear in the number of instances
+* and the data is never reordered: callers gather the instances of the fold or minibatch they need.
+*/
+class StratifiedSampler
+{
+  private:
+    std::vector<Indexes> classIndexes;
+    long numberOfInstances;
+
+    template <class URNG>
+    std::vector<Indexes> deal(const int parts, URNG &&randomGenerator) const
+    {
+        std::vector<Indexes> result(parts);
+        for (auto &part : result)
+            part.reserve(numberOfInstances / parts + classIndexes.size());
+
+        int part = 0;
+        for (auto indexes : classIndexes)
+        {
+            std::shuffle(indexes.begin(), indexes.end(), randomGenerator);
+            for (auto index : indexes)
+            {
+                result[part].push_back(index);
+                part = (part + 1) % parts;
+            }
+        }
+        return result;
+    }
+
+  public:
+    /**
+    * One-hot targets: the class is the row of the maximum of each column.
+    * Single row targets are treated as binary labels thresholded at 0.5.
+    */
+    explicit StratifiedSampler(const Matrix &T) : classIndexes(std::max<long>(T.rows(), 2)), numberOfInstances(T.cols())
+    {
+        for (long col = 0; col < numberOfInstances; ++col)
+        {
+            Matrix::Index label = 0;
+            if (T.rows() == 1)
+                label = T(0, col) > 0.5 ? 1 : 0;
+            else
+                T.col(col).maxCoeff(&label);
+            classIndexes[label].push_back(col);
+        }
+    }
+
+    StratifiedSampler(const LabelVector &labels, const int numberOfClasses) : classIndexes(numberOfClasses), numberOfInstances(labels.size())
+    {
+        for (long i = 0; i < numberOfInstances; ++i)
+        {
+            if (labels(i) >= numberOfClasses)
+                throw std::invalid_argument("Label out of range");
+            classIndexes[labels(i)].push_back(i);
+        }
+    }
+
+    static StratifiedSampler fromDataset(const Dataset &dataset)
+    {
+        if (dataset.hasLabels())
+            return StratifiedSampler(dataset.labels, dataset.numberOfClasses);
+        return StratifiedSampler(dataset.T);
+    }
+
+    /**
+    * k stratified folds: fold i validates on the i-th part and trains on the remaining ones.
+    */
+    template <class URNG>
+    std::vector<Fold> folds(const int k, URNG &&randomGenerator) const
+    {
+        if (k < 2 || k > numberOfInstances)
+            throw std::invalid_argument("Invalid number of folds");
+        auto parts = deal(k, randomGenerator);
+        std::vector<Fold> result(k);
+        for (int i = 0; i < k; ++i)
+        {
+            result[i].validation = parts[i];
+            result[i].training.reserve(numberOfInstances - parts[i].size());
+            for (int j = 0; j < k; ++j)
+                if (j != i)
+                    result[i].training.insert(result[i].training.end(), parts[j].begin(), parts[j].end());
+        }
+        return result;
+    }
+
+    /**
+    * Splits the instances into ceil(size / batchSize) minibatches with the class proportions of the whole dataset.
+    */
+    template <class URNG>
+    std::vector<Indexes> minibatches(const int batchSize, URNG &&randomGenerator) const
+    {
+        if (batchSize < 1)
+            throw std::invalid_argument("Invalid batch size");
+        int parts = (numberOfInstances + batchSize - 1) / batchSize;
+        auto result = deal(parts, randomGenerator);
+        std::shuffle(result.begin(), result.end(), randomGenerator);
+        return result;
+    }
+
+    int numberOfClasses() const
+    {
+        return classIndexes.size();
+    }
+
+    long size() const
+    {
+        return numberOfInstances;
+    }
+};
+
+} // namespace ann
+
+#endif
@@ -7,6 +7,14 @@ namespace ann
     {
         auto output = net.output(dataset.X);
 
+        if(dataset.hasLabels()) {
+            // (y - t)^2 summed over a column is |y|^2 - 2*y[label] + 1 for a one-hot t
+            double sum = output.squaredNorm() + output.cols();
+            for(long i = 0; i < output.cols(); ++i)
+                sum -= 2.0 * output(dataset.labels(i), i);
+            return sum / (2*output.cols());
+        }
+
         auto cost = output.binaryExpr(dataset.T, [](double y, double t){
             return pow(y - t, 2);
         });
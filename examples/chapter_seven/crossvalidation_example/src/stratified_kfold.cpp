@@ -1,11 +1,12 @@
 #include <iostream>
 #include <random>
 #include <limits>
-#include <deque>
 
 #include "csv.h"
 
-#include "dataset.hpp"
+#include "cost_functions.hpp"
+#include "performance_measurement.hpp"
+#include "backpropagation.hpp"
 
 std::random_device rd;
 std::mt19937 prn(rd());
@@ -38,76 +39,57 @@ ann::Dataset loadIrisDataset(const std::string &filepath)
     return result;
 }
 
-ann::Dataset stratify(const ann::Dataset &dataset, const int k)
+ann::MultilayerPerceptron initializeNetwork(const int numberOfHiddenLayers = 1, const int numberOfNeuronsInHiddenLayer = 10)
 {
-    ann::Dataset result;
-    result.X = Matrix::Zero(dataset.X.rows(), dataset.X.cols());
-    result.T = Matrix::Zero(dataset.T.rows(), dataset.T.cols());
-
-    const auto dataSize = dataset.size();
-    std::vector<std::deque<unsigned>> labelIndexes(dataset.T.rows());
+    ann::MultilayerPerceptron result;
+    double initializationRange = 0.05;
 
-    for(unsigned index = 0; index < dataSize; ++index)
+    int numberOfInputNeurons = 4;
+    for (int i = 0; i < numberOfHiddenLayers; i++)
     {
-        const Vector &col = dataset.T.col(index);
-        int labelIndex = std::distance(col.begin(), std::max_element(col.begin(), col.end()));
-        labelIndexes[labelIndex].push_back(index);
+        Matrix w = initializationRange * Matrix::Random(numberOfNeuronsInHiddenLayer, numberOfInputNeurons);
+        ann::Layer layer(std::unique_ptr<ann::ActivationFunction>(new ann::LogisticActivationFunction), w, Vector::Zero(numberOfNeuronsInHiddenLayer));
+        result.add(layer);
+        numberOfInputNeurons = numberOfNeuronsInHiddenLayer;
     }
 
-    std::vector<std::deque<unsigned>> foldIndexes(k);
-
-    int i = 0;
-    for(int labelIndex = 0, size = labelIndexes.size(); labelIndex < size; ++labelIndex)
-    {
-        while (!labelIndexes[labelIndex].empty())
-        {
-            auto index = labelIndexes[labelIndex].front();
-            labelIndexes[labelIndex].pop_front();
-            foldIndexes[i].push_back(index);
-            i = (i + 1) % k;
-        }
-        
-    }
+    Matrix wOut = initializationRange * Matrix::Random(3, numberOfInputNeurons);
+    ann::Layer outputLayer(std::unique_ptr<ann::ActivationFunction>(new ann::LogisticActivationFunction()), wOut, Vector::Zero(3));
+    result.add(outputLayer);
 
-    int resultIndex = 0;
-    for(int i = 0; i < k; ++i)
-    {
-        auto & fold = foldIndexes[i];
-        for(int j = 0, size = fold.size(); j < size; ++j)
-        {
-            auto index = fold[j];
-            result.X.col(resultIndex) = dataset.X.col(index);
-            result.T.col(resultIndex) = dataset.T.col(index);
-            resultIndex++;
-        }
-    }
     return result;
 }
 
 int main()
 {
     auto originDataset = loadIrisDataset("../data/iris.csv");
-    shuffleDataset(originDataset, prn);
     int k = 4;
-    auto dataset = stratify(originDataset, k);
-    int dataSize = dataset.size();
-    int foldSize = dataSize / k;
-    int remains = dataSize % k;
-    int foldEnd = 0;
+    auto sampler = ann::StratifiedSampler::fromDataset(originDataset);
+    auto folds = sampler.folds(k, prn);
     std::cout << "FOLD\tfold-SIZE\tsetosa\tversicolor\tvirginica\n";
     for (int i = 0; i < k; ++i) {
-        int foldBegin = foldEnd;
-        foldEnd = foldBegin + foldSize;
-        if (remains > 0) {
-            foldEnd++;
-            remains--;
-        }
-        auto fold = dataset.slice(foldBegin, foldEnd);
+        auto fold = ann::gather(originDataset, folds[i].validation);
         int setosa = fold.T.row(0).sum();
         int versicolor = fold.T.row(1).sum();
         int virginica = fold.T.row(2).sum();
         std::cout << i << '\t' << fold.size() << "\t" << setosa << "\t" << versicolor;
         std::cout << "\t" << virginica << "\n";
     }
+
+    // every fold also trains on stratified minibatches
+    double learnRate = 1.0;
+    int epochs = 1'000;
+    int batchSize = 16;
+    double finalMSE = .0;
+    for (int i = 0; i < k; ++i) {
+        auto trainDS = ann::gather(originDataset, folds[i].training);
+        auto validDS = ann::gather(originDataset, folds[i].validation);
+        auto net = initializeNetwork();
+        ann::Backpropagation<ann::QuadraticCostFunction> bp(net, trainDS, learnRate, epochs, batchSize);
+        bp.stratifyMinibatches();
+        bp.train();
+        finalMSE += mse(net, validDS);
+    }
+    std::cout << "The estimated generalization MSE is\t" << finalMSE / k << "\n";
     return 0;
 }
\ No newline at end of file
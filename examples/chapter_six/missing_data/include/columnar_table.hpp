@@ -0,0 +1,130 @@
+#ifndef COLUMNAR_TABLE_H_
+#define COLUMNAR_TABLE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "dataset.hpp"
+
+namespace ann
+{
+
+/**
+* One bit per row, set when the row holds a valid value.
+* Missing data is counted with popcount over 64 rows at a time.
+*/
+class ValidityBitmap
+{
+  private:
+    std::vector<uint64_t> words;
+    long length;
+
+  public:
+    ValidityBitmap(long length = 0) : words((length + 63) / 64, 0), length(length) {}
+
+    void set(long index, bool valid)
+    {
+        uint64_t mask = uint64_t(1) << (index % 64);
+        if (valid) words[index / 64] |= mask;
+        else words[index / 64] &= ~mask;
+    }
+
+    bool isValid(long index) const
+    {
+        return (words[index / 64] >> (index % 64)) & 1;
+    }
+
+    long countValid() const
+    {
+        long result = 0;
+        for (auto word : words)
+            result += __builtin_popcountll(word);
+        return result;
+    }
+
+    long countMissing() const
+    {
+        return length - countValid();
+    }
+
+    void setAll()
+    {
+        std::fill(words.begin(), words.end(), ~uint64_t(0));
+        if (length % 64 != 0 && !words.empty())
+            words.back() = (uint64_t(1) << (length % 64)) - 1;
+    }
+
+    long size() const
+    {
+        return length;
+    }
+
+    const std::vector<uint64_t> &getWords() const
+    {
+        return words;
+    }
+};
+
+enum class ImputationStrategy
+{
+    Mean,
+    Median,
+    Mode,
+    Constant
+};
+
+/**
+* A typed column: the parsed values plus their validity bitmap.
+* Missing entries are stored as 0.0 so that plain vectorized reductions skip them.
+*/
+struct Column
+{
+    std::string name;
+    Vector values;
+    ValidityBitmap validity;
+
+    long missing() const
+    {
+        return validity.countMissing();
+    }
+};
+
+class ColumnarTable
+{
+  private:
+    std::vector<Column> columns;
+    long numberOfRows;
+
+  public:
+    ColumnarTable() : numberOfRows(0) {}
+
+    /**
+    * Loads a CSV file whose first line is the header. Cells are parsed in place from the line buffer,
+    * cells equal to missingMarker (or empty) are flagged as missing in the column's bitmap.
+    */
+    static ColumnarTable load(const std::string &filepath, const std::string &missingMarker = "?");
+
+    void impute(int columnIndex, ImputationStrategy strategy, double constant = 0.0);
+    void impute(ImputationStrategy strategy, double constant = 0.0);
+
+    Dataset toDataset(const std::vector<int> &featureColumns, const std::vector<int> &targetColumns) const;
+
+    long rows() const
+    {
+        return numberOfRows;
+    }
+    int numberOfColumns() const
+    {
+        return columns.size();
+    }
+    const Column &column(int index) const
+    {
+        return columns[index];
+    }
+    int columnIndex(const std::string &name) const;
+};
+
+} // namespace ann
+
+#endif
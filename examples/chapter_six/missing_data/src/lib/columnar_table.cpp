@@ -0,0 +1,235 @@
+#include "columnar_table.hpp"
+#include "parallel.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include "csv.h"
+
+namespace ann
+{
+
+namespace
+{
+
+std::vector<double> validValues(const Column &column)
+{
+    std::vector<double> result;
+    result.reserve(column.validity.countValid());
+    for (long i = 0; i < column.values.size(); ++i)
+        if (column.validity.isValid(i))
+            result.push_back(column.values(i));
+    return result;
+}
+
+double median(std::vector<double> values)
+{
+    const size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    double result = values[middle];
+    if (values.size() % 2 == 0)
+    {
+        double lower = *std::max_element(values.begin(), values.begin() + middle);
+        result = (result + lower) / 2.0;
+    }
+    return result;
+}
+
+double mode(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    double result = values.front();
+    long bestCount = 0;
+    for (size_t begin = 0; begin < values.size();)
+    {
+        size_t end = begin;
+        while (end < values.size() && values[end] == values[begin])
+            end++;
+        if (static_cast<long>(end - begin) > bestCount)
+        {
+            bestCount = end - begin;
+            result = values[begin];
+        }
+        begin = end;
+    }
+    return result;
+}
+
+} // namespace
+
+ColumnarTable ColumnarTable::load(const std::string &filepath, const std::string &missingMarker)
+{
+    io::LineReader reader(filepath);
+    ColumnarTable result;
+
+    char *line = reader.next_line();
+    if (!line)
+        throw std::invalid_argument("empty file: " + filepath);
+
+    for (char *cell = line; cell; )
+    {
+        char *next = std::strchr(cell, ',');
+        if (next) *next++ = '\0';
+        Column column;
+        column.name = cell;
+        result.columns.push_back(std::move(column));
+        cell = next;
+    }
+
+    const size_t numberOfColumns = result.columns.size();
+    std::vector<std::vector<double>> buffers(numberOfColumns);
+    std::vector<std::vector<bool>> validBuffers(numberOfColumns);
+
+    while ((line = reader.next_line()))
+    {
+        if (*line == '\0')
+            continue;
+        char *cell = line;
+        for (size_t col = 0; col < numberOfColumns; ++col)
+        {
+            if (!cell)
+            {
+                std::stringstream msg;
+                msg << "Row " << result.numberOfRows + 1 << " has only " << col << " columns but the header has " << numberOfColumns;
+                throw std::invalid_argument(msg.str());
+            }
+            char *next = std::strchr(cell, ',');
+            if (next) *next++ = '\0';
+
+            double value = 0.0;
+            const bool valid = *cell != '\0' && missingMarker != cell;
+            if (valid)
+            {
+                char *parsedEnd;
+                value = std::strtod(cell, &parsedEnd);
+                // only trailing whitespace may follow the number, so "12abc" or "3.5 kg" are rejected, and so are
+                // "nan" or "inf", which strtod accepts but no imputation strategy can use
+                const char *rest = parsedEnd;
+                while (std::isspace(static_cast<unsigned char>(*rest)))
+                    ++rest;
+                if (parsedEnd == cell || *rest != '\0' || !std::isfinite(value))
+                {
+                    std::stringstream msg;
+                    msg << "Invalid value '" << cell << "' in column " << result.columns[col].name;
+                    throw std::invalid_argument(msg.str());
+                }
+            }
+            buffers[col].push_back(value);
+            validBuffers[col].push_back(valid);
+            cell = next;
+        }
+        if (cell)
+        {
+            std::stringstream msg;
+            msg << "Row " << result.numberOfRows + 1 << " has more than " << numberOfColumns << " columns but the header has " << numberOfColumns;
+            throw std::invalid_argument(msg.str());
+        }
+        result.numberOfRows++;
+    }
+
+    parallelFor(0, numberOfColumns, [&result, &buffers, &validBuffers](long begin, long end) {
+        for (long col = begin; col < end; ++col)
+        {
+            Column &column = result.columns[col];
+            const auto &buffer = buffers[col];
+            const auto &validBuffer = validBuffers[col];
+            const long rows = buffer.size();
+            column.values = Eigen::Map<const Vector>(buffer.data(), rows);
+            column.validity = ValidityBitmap(rows);
+            // missing entries are already stored as zeros
+            for (long i = 0; i < rows; ++i)
+                column.validity.set(i, validBuffer[i]);
+        }
+    });
+
+    return result;
+}
+
+void ColumnarTable::impute(int columnIndex, ImputationStrategy strategy, double constant)
+{
+    Column &column = columns[columnIndex];
+    const long validCount = column.validity.countValid();
+    if (validCount == column.values.size())
+        return;
+
+    double fillValue = constant;
+    if (strategy != ImputationStrategy::Constant)
+    {
+        if (validCount == 0)
+            throw std::invalid_argument("Column " + column.name + " has no valid values to impute from");
+        switch (strategy)
+        {
+        case ImputationStrategy::Mean:
+            // missing entries are stored as zeros, so the plain sum only counts valid values
+            fillValue = column.values.sum() / validCount;
+            break;
+        case ImputationStrategy::Median:
+            fillValue = median(validValues(column));
+            break;
+        case ImputationStrategy::Mode:
+            fillValue = mode(validValues(column));
+            break;
+        default:
+            break;
+        }
+    }
+
+    const auto &words = column.validity.getWords();
+    const long rows = column.values.size();
+    for (size_t w = 0, size = words.size(); w < size; ++w)
+    {
+        uint64_t invalid = ~words[w];
+        while (invalid)
+        {
+            long row = w * 64 + __builtin_ctzll(invalid);
+            if (row >= rows) break;
+            column.values(row) = fillValue;
+            invalid &= invalid - 1;
+        }
+    }
+    column.validity.setAll();
+}
+
+void ColumnarTable::impute(ImputationStrategy strategy, double constant)
+{
+    parallelFor(0, columns.size(), [this, strategy, constant](long begin, long end) {
+        for (long col = begin; col < end; ++col)
+            impute(col, strategy, constant);
+    });
+}
+
+Dataset ColumnarTable::toDataset(const std::vector<int> &featureColumns, const std::vector<int> &targetColumns) const
+{
+    auto toMatrix = [this](const std::vector<int> &indexes) {
+        Matrix result(indexes.size(), numberOfRows);
+        for (size_t i = 0; i < indexes.size(); ++i)
+        {
+            const Column &column = columns[indexes[i]];
+            if (column.missing() > 0)
+            {
+                std::stringstream msg;
+                msg << "Column " << column.name << " still has " << column.missing() << " missing values. Call impute() first.";
+                throw std::invalid_argument(msg.str());
+            }
+            result.row(i) = column.values.transpose();
+        }
+        return result;
+    };
+    Dataset result;
+    result.X = toMatrix(featureColumns);
+    result.T = toMatrix(targetColumns);
+    return result;
+}
+
+int ColumnarTable::columnIndex(const std::string &name) const
+{
+    auto it = std::find_if(columns.begin(), columns.end(), [&name](const Column &column) { return column.name == name; });
+    if (it == columns.end())
+        throw std::invalid_argument("Unknown column " + name);
+    return std::distance(columns.begin(), it);
+}
+
+} // namespace ann
@@ -6,5 +6,6 @@
 using Matrix = Eigen::MatrixXd;
 using Vector = Eigen::VectorXd;
 using DiagonalMatrix = Eigen::DiagonalMatrix<double, Eigen::Dynamic>;
+using LabelVector = Eigen::Matrix<unsigned char, Eigen::Dynamic, 1>;
 
 #endif
\ No newline at end of file
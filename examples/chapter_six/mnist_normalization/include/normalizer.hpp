@@ -0,0 +1,219 @@
+#ifndef NORMALIZER_H_
+#define NORMALIZER_H_
+
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+#include "dataset.hpp"
+#include "parallel.hpp"
+
+namespace ann
+{
+
+enum class NormalizationType
+{
+    ZScore,
+    MinMax
+};
+
+/**
+* Per feature (row) statistics fitted in a single pass with Welford's algorithm.
+* Each thread accumulates a slice of the instances and the partial results are merged with Chan's formula,
+* so the normalizer can also be fitted incrementally on a stream of chunks through partialFit.
+*/
+class Normalizer
+{
+  private:
+    long count;
+    Vector minimum;
+    Vector maximum;
+    Vector mean;
+    Vector m2;
+
+    void merge(long otherCount, const Vector &otherMin, const Vector &otherMax, const Vector &otherMean, const Vector &otherM2)
+    {
+        if (otherCount == 0)
+            return;
+        if (count == 0)
+        {
+            count = otherCount;
+            minimum = otherMin;
+            maximum = otherMax;
+            mean = otherMean;
+            m2 = otherM2;
+            return;
+        }
+        const double total = count + otherCount;
+        Vector delta = otherMean - mean;
+        mean += delta * (otherCount / total);
+        m2 += otherM2 + delta.cwiseProduct(delta) * (count * (otherCount / total));
+        minimum = minimum.cwiseMin(otherMin);
+        maximum = maximum.cwiseMax(otherMax);
+        count += otherCount;
+    }
+
+  public:
+    Normalizer() : count(0) {}
+
+    void reset()
+    {
+        count = 0;
+    }
+
+    void partialFit(const Eigen::Ref<const Matrix> &X)
+    {
+        if (count > 0 && X.rows() != mean.size())
+            throw std::invalid_argument("The chunk has a different number of features than the fitted data");
+
+        const long features = X.rows();
+        std::mutex mergeMutex;
+        parallelFor(0, X.cols(), [&](long begin, long end) {
+            Vector localMin = Vector::Constant(features, std::numeric_limits<double>::infinity());
+            Vector localMax = Vector::Constant(features, -std::numeric_limits<double>::infinity());
+            Vector localMean = Vector::Zero(features);
+            Vector localM2 = Vector::Zero(features);
+            Vector delta(features);
+            long localCount = 0;
+            for (long col = begin; col < end; ++col)
+            {
+                auto x = X.col(col);
+                localCount++;
+                delta = x - localMean;
+                localMean += delta / localCount;
+                localM2 += delta.cwiseProduct(x - localMean);
+                localMin = localMin.cwiseMin(x);
+                localMax = localMax.cwiseMax(x);
+            }
+            std::lock_guard<std::mutex> lock(mergeMutex);
+            merge(localCount, localMin, localMax, localMean, localM2);
+        });
+    }
+
+    void fit(const Eigen::Ref<const Matrix> &X)
+    {
+        reset();
+        partialFit(X);
+    }
+
+    /**
+    * Returns (scale, offset) such that the normalized value is scale * x + offset.
+    * Constant features (max == min) are mapped to zero.
+    */
+    std::tuple<Vector, Vector> affine(NormalizationType type) const
+    {
+        if (count == 0)
+            throw std::logic_error("The normalizer must be fitted before use");
+        Vector scale, offset;
+        if (type == NormalizationType::ZScore)
+        {
+            Vector deviation = standardDeviation();
+            scale = deviation.unaryExpr([](double sd) { return sd > 0.0 ? 1.0 / sd : 0.0; });
+            offset = -mean.cwiseProduct(scale);
+        }
+        else
+        {
+            Vector range = maximum - minimum;
+            scale = range.unaryExpr([](double r) { return r > 0.0 ? 1.0 / r : 0.0; });
+            offset = -minimum.cwiseProduct(scale);
+        }
+        return std::make_tuple(scale, offset);
+    }
+
+    void transform(Matrix &X, NormalizationType type) const
+    {
+        if (X.rows() != mean.size())
+            throw std::invalid_argument("The input has a different number of features than the fitted data");
+        Vector scale, offset;
+        std::tie(scale, offset) = affine(type);
+        parallelFor(0, X.cols(), [&X, &scale, &offset](long begin, long end) {
+            auto block = X.middleCols(begin, end - begin).array();
+            block = (block.colwise() * scale.array()).colwise() + offset.array();
+        });
+    }
+
+    void transform(Dataset &dataset, NormalizationType type) const
+    {
+        transform(dataset.X, type);
+    }
+
+    /**
+    * Maps normalized values back to the original scale. Constant features come back to their fitted value.
+    */
+    void inverseTransform(Matrix &X, NormalizationType type) const
+    {
+        if (count == 0)
+            throw std::logic_error("The normalizer must be fitted before use");
+        if (X.rows() != mean.size())
+            throw std::invalid_argument("The input has a different number of features than the fitted data");
+        Vector scale = type == NormalizationType::ZScore ? standardDeviation() : Vector(maximum - minimum);
+        const Vector &offset = type == NormalizationType::ZScore ? mean : minimum;
+        parallelFor(0, X.cols(), [&X, &scale, &offset](long begin, long end) {
+            auto block = X.middleCols(begin, end - begin).array();
+            block = (block.colwise() * scale.array()).colwise() + offset.array();
+        });
+    }
+
+    Vector variance() const
+    {
+        return count > 1 ? Vector(m2 / (count - 1)) : Vector::Zero(m2.size());
+    }
+
+    Vector standardDeviation() const
+    {
+        return variance().cwiseSqrt();
+    }
+
+    long getCount() const
+    {
+        return count;
+    }
+    const Vector &getMinimum() const
+    {
+        return minimum;
+    }
+    const Vector &getMaximum() const
+    {
+        return maximum;
+    }
+    const Vector &getMean() const
+    {
+        return mean;
+    }
+
+    void save(const std::string &filepath) const
+    {
+        std::ofstream stream(filepath);
+        if (!stream.is_open())
+            throw std::invalid_argument("failed to open " + filepath);
+        stream << std::setprecision(17) << count << " " << mean.size() << "\n";
+        for (long i = 0; i < mean.size(); ++i)
+            stream << minimum(i) << " " << maximum(i) << " " << mean(i) << " " << m2(i) << "\n";
+    }
+
+    static Normalizer load(const std::string &filepath)
+    {
+        std::ifstream stream(filepath);
+        if (!stream.is_open())
+            throw std::invalid_argument("failed to open " + filepath);
+        Normalizer result;
+        long features;
+        stream >> result.count >> features;
+        result.minimum.resize(features);
+        result.maximum.resize(features);
+        result.mean.resize(features);
+        result.m2.resize(features);
+        for (long i = 0; i < features; ++i)
+            stream >> result.minimum(i) >> result.maximum(i) >> result.mean(i) >> result.m2(i);
+        if (!stream)
+            throw std::invalid_argument("failed to read normalizer parameters from " + filepath);
+        return result;
+    }
+};
+
+} // namespace ann
+
+#endif
@@ -9,6 +9,7 @@
 #include <opencv2/highgui/highgui.hpp>
 
 #include "dataset.hpp"
+#include "normalizer.hpp"
 
 uint32_t readUnsignedInt32(std::ifstream &stream, size_t position)
 {
@@ -57,7 +58,7 @@ Matrix loadInput(const std::string &imagesFilePath)
     return result;
 }
 
-Matrix loadTarget(const std::string &labelsFilePath)
+LabelVector loadTarget(const std::string &labelsFilePath)
 {
     std::ifstream labelsStream(labelsFilePath, std::ios::in | std::ios::binary);
 
@@ -72,15 +73,8 @@ Matrix loadTarget(const std::string &labelsFilePath)
     uint32_t numberOfInstances = readUnsignedInt32(labelsStream, 4);
     std::cout << "This file has " << numberOfInstances << " labels\n";
 
-    Matrix result = Matrix::Zero(10, numberOfInstances);
-
-    for (unsigned instance = 0; instance < numberOfInstances; ++instance)
-    {
-        char label;
-        labelsStream.read(&label, 1);
-        unsigned index = static_cast<unsigned>(label);
-        result(index, instance) = 1.0;
-    }
+    LabelVector result(numberOfInstances);
+    labelsStream.read(reinterpret_cast<char *>(result.data()), numberOfInstances);
 
     return result;
 }
@@ -100,9 +94,7 @@ void navigate(ann::Dataset &dataset)
         auto data = dataset.X.col(instance).data();
         cv::Mat image(28, 28, CV_64FC1, data), resized;
         cv::resize(image, resized, cv::Size(280, 280));
-        auto labelCol = dataset.T.col(instance);
-        Matrix::Index maxRow;
-        labelCol.maxCoeff(&maxRow);
+        unsigned label = dataset.labels(instance);
 
         std::cout << "======================================\n";
         std::cout << std::hex;
@@ -119,7 +111,7 @@ void navigate(ann::Dataset &dataset)
             std::cout << "\n";
         }
         std::cout << std::dec << "index: " << instance << "\n";
-        std::cout << "label: " << maxRow << "\n";
+        std::cout << "label: " << label << "\n";
 
         cv::Mat toSave = resized;
         toSave.convertTo(toSave, CV_8UC1, 255.0); 
@@ -141,50 +133,60 @@ ann::Dataset loadMNISTDataset(const std::string &imagesFilePath, const std::stri
 {
     ann::Dataset result;
     result.X = loadInput(imagesFilePath);
-    result.T = loadTarget(labelsFilePath);
+    result.labels = loadTarget(labelsFilePath);
+    result.numberOfClasses = 10;
     return result;
 }
 
-Vector fixedNormalization(const Vector &col)
-{
-    return col / 255.0;
-}
-
-Vector zscoreNormalization(const Vector &row)
-{
-    double min = row.minCoeff();
-    double max = row.maxCoeff();
-
-    const auto size = row.size();
-
-    if(max == min)
-        return Vector::Zero(size);
-
-    double mean = row.mean();
-    double standardDeviation = 0.0;
-    for(unsigned i = 0; i < size; ++i)
-        standardDeviation += pow(row(i) - mean, 2);
-    standardDeviation = sqrt(standardDeviation  / (size - 1));
-
-    return row.unaryExpr([&mean, &standardDeviation](double x) { return (x - mean)/standardDeviation; });
-}
-
-Vector minMaxNormalization(const Vector &row)
+/**
+* Normalizes a copy of the first images with every NormalizationType and maps it back, checking that min-max values
+* are in [0, 1] and that the round trip gives back the original pixels.
+*/
+void checkNormalizer(const ann::Normalizer &normalizer, const Eigen::Ref<const Matrix> &X)
 {
-    double min = row.minCoeff();
-    double max = row.maxCoeff();
-
-    return row.unaryExpr([&min, &max](double x) { return (x - min)/(max - min); });
+    for (auto type : {ann::NormalizationType::ZScore, ann::NormalizationType::MinMax})
+    {
+        const char *name = type == ann::NormalizationType::ZScore ? "z-score" : "min-max";
+        Matrix normalized = X;
+        normalizer.transform(normalized, type);
+        if (type == ann::NormalizationType::MinMax && (normalized.minCoeff() < -1e-9 || normalized.maxCoeff() > 1.0 + 1e-9))
+            throw std::logic_error(std::string("The ") + name + " normalized values are out of [0, 1]");
+        Matrix restored = normalized;
+        normalizer.inverseTransform(restored, type);
+        double error = (restored - X).cwiseAbs().maxCoeff();
+        std::cout << name << ": values in [" << normalized.minCoeff() << ", " << normalized.maxCoeff()
+                  << "], round trip error " << error << "\n";
+        if (error > 1e-6)
+            throw std::logic_error(std::string("The ") + name + " normalization does not invert");
+    }
 }
 
-int main(int, char **)
+/**
+* Shows the training images scaled to [0, 1] by the fixed 1/255 of the 8-bit pixels. The per pixel statistics of the
+* training set are fitted in a single pass and checked on the first images; with NORMALIZER_FILE they are also saved
+* there, for a model to normalize its inputs the same way at inference.
+*/
+int main(int argc, char **argv)
 {
+    if (argc > 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [NORMALIZER_FILE]\n";
+        return -1;
+    }
     try
     {
         std::cout << "Loading data...\n";
         auto mnist = loadMNISTDataset("../data/mnist/train-images-idx3-ubyte", "../data/mnist/train-labels-idx1-ubyte");
+        std::cout << "Fitting the normalizer...\n";
+        ann::Normalizer normalizer;
+        const int chunkSize = 10000;
+        for(long begin = 0; begin < mnist.size(); begin += chunkSize)
+            normalizer.partialFit(mnist.X.middleCols(begin, std::min<long>(chunkSize, mnist.size() - begin)));
+        checkNormalizer(normalizer, mnist.X.leftCols(std::min<long>(chunkSize, mnist.size())));
+        if (argc == 2)
+            normalizer.save(argv[1]);
         std::cout << "Normalizing data...\n";
-        mnist.normalize(std::ref(fixedNormalization));
+        mnist.X *= 1.0 / 255.0;
         navigate(mnist);
         std::cout << "exiting...\n";
     }